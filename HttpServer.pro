@@ -1,5 +1,6 @@
 TEMPLATE = subdirs
 
-SUBDIRS += src test
+SUBDIRS += src test tests
 
 test.depends = src
+tests.depends = src
@@ -12,7 +12,9 @@ using QtPromise::QPromiseTimeoutException;
 using QtPromise::QPromise;
 using HttpDataPtr = std::shared_ptr<HttpData>;
 using HttpPromise = QPromise<std::shared_ptr<HttpData>>;
-using HttpFunc = std::function<HttpPromise(std::shared_ptr<HttpData> data)>;
+// Handlers can return an HttpPromise or HttpDataPtr, both convert to HttpResult (see httpResult.h)
+class HttpResult;
+using HttpFunc = std::function<HttpResult(std::shared_ptr<HttpData> data)>;
 using HttpResolveFunc = const QtPromise::QPromiseResolve<std::shared_ptr<HttpData>> &;
 using HttpRejectFunc = const QtPromise::QPromiseReject<std::shared_ptr<HttpData>> &;
 
@@ -0,0 +1,84 @@
+#include "httpArena.h"
+#include "httpObjectPool.h"
+
+#include <algorithm>
+#include <cstdint>
+
+HttpArena::HttpArena(size_t blockSize) : blockSize(blockSize), pos(nullptr), end(nullptr)
+{
+}
+
+HttpArena::~HttpArena()
+{
+    for (Block &block : blocks)
+        delete[] block.data;
+}
+
+std::shared_ptr<HttpArena> HttpArena::create(int blockSize, int poolSize)
+{
+    if (blockSize <= 0)
+        return nullptr;
+
+    // Arenas of another server with a different block size are not reused
+    HttpArena *arena = HttpObjectPool<HttpArena>::take();
+    if (arena && arena->blockSize != (size_t)blockSize)
+    {
+        delete arena;
+        arena = nullptr;
+    }
+
+    if (!arena)
+        arena = new HttpArena(blockSize);
+
+    return std::shared_ptr<HttpArena>(arena, [poolSize](HttpArena *arena) {
+        release(arena, poolSize);
+    });
+}
+
+void HttpArena::release(HttpArena *arena, int poolSize)
+{
+    arena->reset();
+    if (!HttpObjectPool<HttpArena>::put(arena, poolSize))
+        delete arena;
+}
+
+void HttpArena::addBlock(size_t size)
+{
+    Block block = {new char[size], size};
+    blocks.push_back(block);
+    pos = block.data;
+    end = block.data + size;
+}
+
+void *HttpArena::allocate(size_t size, size_t alignment)
+{
+    uintptr_t address = ((uintptr_t)pos + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (!pos || address + size > (uintptr_t)end)
+    {
+        // Allocations larger than a block get a block of their own
+        addBlock(std::max(blockSize, size + alignment));
+        address = ((uintptr_t)pos + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+
+    pos = (char *)(address + size);
+    return (void *)address;
+}
+
+void HttpArena::reset()
+{
+    if (blocks.empty())
+        return;
+
+    // Keep the first block, the rest were only needed for unusually large requests
+    for (size_t i = 1; i < blocks.size(); ++i)
+        delete[] blocks[i].data;
+
+    blocks.resize(1);
+    pos = blocks[0].data;
+    end = blocks[0].data + blocks[0].size;
+}
+
+int HttpArena::blockCount() const
+{
+    return (int)blocks.size();
+}
@@ -0,0 +1,116 @@
+#ifndef HTTP_SERVER_HTTP_ARENA_H
+#define HTTP_SERVER_HTTP_ARENA_H
+
+#include "util.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+// Bump allocator for the small, short-lived allocations made while handling a request
+//
+// Each request gets an arena that it & its response allocate their maps from. Allocating is a pointer bump, freeing is
+// a no-op and all memory is released at once with reset(). Arenas from create() are reset and returned to a per-thread
+// pool once the request & response are done with them, so memory never outlives the request it was allocated for.
+// The first block is kept across resets, so later requests on the thread reuse the same memory.
+class HTTPSERVER_EXPORT HttpArena
+{
+private:
+    struct Block
+    {
+        char *data;
+        size_t size;
+    };
+
+    size_t blockSize;
+    std::vector<Block> blocks;
+    char *pos;
+    char *end;
+
+    void addBlock(size_t size);
+
+    static void release(HttpArena *arena, int poolSize);
+
+public:
+    explicit HttpArena(size_t blockSize = 4 * 1024);
+    ~HttpArena();
+
+    HttpArena(const HttpArena &) = delete;
+    HttpArena &operator=(const HttpArena &) = delete;
+
+    // Takes an arena from the pool of the current thread, a new one is allocated if the pool is empty. Once the last
+    // reference is dropped, the arena is reset and put back unless the pool already holds poolSize arenas. Returns
+    // nullptr if blockSize is 0, which makes requests & responses allocate from the heap
+    static std::shared_ptr<HttpArena> create(int blockSize, int poolSize);
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Frees everything allocated from the arena, nothing allocated from it can be used afterwards
+    void reset();
+
+    int blockCount() const;
+};
+
+// Standard allocator that allocates from an arena, or the heap if the arena is null
+template <typename T>
+class HttpArenaAllocator
+{
+public:
+    using value_type = T;
+
+    HttpArena *arena;
+
+    // Moving a container also moves its allocator, allows switching a container to another arena by assigning a new one
+    using propagate_on_container_move_assignment = std::true_type;
+
+    HttpArenaAllocator(HttpArena *arena = nullptr) noexcept : arena(arena) {}
+
+    template <typename U>
+    HttpArenaAllocator(const HttpArenaAllocator<U> &other) noexcept : arena(other.arena) {}
+
+    T *allocate(size_t n)
+    {
+        if (arena)
+            return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t) noexcept
+    {
+        // Memory from the arena is freed when the arena is reset
+        if (!arena)
+            ::operator delete(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const HttpArenaAllocator<T> &a, const HttpArenaAllocator<U> &b)
+{
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const HttpArenaAllocator<T> &a, const HttpArenaAllocator<U> &b)
+{
+    return a.arena != b.arena;
+}
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>>
+using HttpArenaMap = std::unordered_map<Key, Value, Hash, Equal, HttpArenaAllocator<std::pair<const Key, Value>>>;
+
+// Clears the map and switches it to allocating from the given arena
+// Note: Must be called before the arena the map currently allocates from is reset
+template <typename Map>
+void resetArenaMap(Map &map, HttpArena *arena)
+{
+    map = Map(0, map.hash_function(), map.key_eq(), typename Map::allocator_type(arena));
+}
+
+#endif // HTTP_SERVER_HTTP_ARENA_H
@@ -1,11 +1,27 @@
 #include "httpConnection.h"
 
+namespace
+{
+    bool isReadingBody(const HttpRequest *request)
+    {
+        const HttpRequest::State state = request->state();
+        return state == HttpRequest::State::ReadBody || state == HttpRequest::State::ReadMultiFormBodyData ||
+            state == HttpRequest::State::ReadMultiFormBodyHeaders;
+    }
+}
+
 HttpConnection::HttpConnection(HttpServerConfig *config, HttpRequestHandler *requestHandler, qintptr socketDescriptor,
-    QSslConfiguration *sslConfig, QObject *parent) : QObject(parent), config(config), currentRequest(nullptr),
-    currentResponse(nullptr), requestHandler(requestHandler), sslConfig(sslConfig)
+    QSslConfiguration *sslConfig, HttpResponseCache *responseCache, HttpThreadPool *pool,
+    HttpMemoryBudget *memoryBudget, QObject *parent) : QObject(parent), config(config),
+    requestRate(config->dataRateWindow), responseRate(config->dataRateWindow), currentRequest(nullptr),
+    currentResponse(nullptr), requestHandler(requestHandler), responseCache(responseCache), pool(pool),
+    memoryBudget(memoryBudget), accountedBytes(0), upgradeResponse(nullptr), readScheduled(false), readPaused(false),
+    sslConfig(sslConfig)
 {
     timeoutTimer = new QTimer(this);
     keepAliveMode = false;
+    dataRateTimer = new QTimer(this);
+    dataRateTimer->setInterval(1000);
 
 	// Create TCP or SSL socket
     createSocket(socketDescriptor);
@@ -15,6 +31,10 @@ HttpConnection::HttpConnection(HttpServerConfig *config, HttpRequestHandler *req
     connect(socket, &QTcpSocket::bytesWritten, this, &HttpConnection::bytesWritten);
     connect(socket, &QTcpSocket::disconnected, this, &HttpConnection::socketDisconnected);
     connect(timeoutTimer, &QTimer::timeout, this, &HttpConnection::timeout);
+    connect(dataRateTimer, &QTimer::timeout, this, &HttpConnection::checkDataRates);
+
+    if (memoryBudget)
+        connect(memoryBudget, &HttpMemoryBudget::available, this, &HttpConnection::memoryAvailable);
 }
 
 void HttpConnection::createSocket(qintptr socketDescriptor)
@@ -57,111 +77,434 @@ void HttpConnection::createSocket(qintptr socketDescriptor)
 
 void HttpConnection::read()
 {
+    readRequests();
+    updateMemoryUsage();
+}
+
+void HttpConnection::readRequests()
+{
+    // Data following an upgrade request belongs to the new protocol if the upgrade is accepted
+    if (upgradeResponse)
+        return;
+
+    int requestCount = 0;
+    const qint64 startBytesAvailable = socket->bytesAvailable();
+
     // Looping adds support for HTTP pipelining
 	while (socket->bytesAvailable())
     {
         // Create new request if necessary
         if (!currentRequest)
         {
-            currentRequest = new HttpRequest(config);
-            currentResponse = new HttpResponse(config);
+            // Stop reading while the client is not reading the responses it already asked for
+            if (isBacklogged())
+            {
+                pauseReading();
+                return;
+            }
+
+            // Yield to other connections once the budget for this wakeup is used up, the rest is read later
+            // Note: readyRead is not emitted again for data that is already buffered, so the read must be scheduled
+            const qint64 bytesRead = startBytesAvailable - socket->bytesAvailable();
+            if ((config->maxRequestsPerRead > 0 && requestCount >= config->maxRequestsPerRead) ||
+                (config->maxBytesPerRead > 0 && bytesRead >= config->maxBytesPerRead))
+            {
+                scheduleRead();
+                return;
+            }
+
+            // Each request has an arena of its own, so a connection that always has a request in flight does not keep
+            // growing the memory of the requests before it
+            std::shared_ptr<HttpArena> arena = HttpArena::create(config->requestArenaBlockSize, config->objectPoolSize);
+            currentRequest = HttpRequest::create(config, arena);
+            currentResponse = HttpResponse::create(config, arena);
+
+            // Shed load while the server is over its memory budget, the request is discarded & answered right away
+            if (memoryBudget && memoryBudget->isExceeded())
+            {
+                if (config->verbosity >= HttpServerConfig::Verbose::Warning)
+                {
+                    qWarning().noquote() << QString("Memory budget exceeded (%1 of %2 bytes). Rejecting request "
+                        "from %3").arg(memoryBudget->usage()).arg(memoryBudget->limit()).arg(address.toString());
+                }
+
+                currentResponse->setError(HttpStatus::ServiceUnavailable, "Server is busy, try again later", true);
+                currentResponse->setHeader("Retry-After", 1);
+                currentRequest->abort();
+            }
+
+            // Allows chunked responses to send their headers & chunks before the handler is finished
+            HttpResponse *response = currentResponse;
+            currentResponse->setNotifier([this, response]() {
+                responseUpdated(response);
+            });
+        }
+
+        // Stop reading request bodies while the server is over its memory budget, resumed once memory is freed
+        if (memoryBudget && memoryBudget->isExceeded() && isReadingBody(currentRequest))
+        {
+            pauseReading();
+            return;
         }
 
+        // Measured from the first byte of the request until it is parsed
+        startDataRate(requestRate);
+        const qint64 bytesAvailable = socket->bytesAvailable();
+
         // If this returns false, that indicates there is no more data left to read
         // Otherwise, true means a request was parsed or the request was aborted
-        if (!currentRequest->parseRequest(socket, currentResponse))
+        const bool parsed = currentRequest->parseRequest(socket, currentResponse);
+        requestRate.add(bytesAvailable - socket->bytesAvailable());
+        if (!parsed)
         {
             // If we are reading the body, give additional time for large files
-            if (currentRequest->state() == HttpRequest::State::ReadBody)
-                timeoutTimer->start(config->requestTimeout * 1000);
+            // Note: With a minimum request rate, a body that keeps arriving fast enough has no time limit
+            if (isReadingBody(currentRequest))
+            {
+                if (config->minRequestDataRate > 0)
+                    timeoutTimer->stop();
+                else if (currentRequest->state() == HttpRequest::State::ReadBody)
+                    timeoutTimer->start(config->requestTimeout * 1000);
+            }
 
             return;
         }
 
         // We are done parsing data, whether it be an error or not
         timeoutTimer->stop();
+        requestRate.stop();
+        ++requestCount;
+
+        // Write cached responses straight to the socket, skips the handler entirely
+        // Note: Only done if no responses are pending, otherwise the cached response would be sent out of order
+        QByteArray cachedResponse;
+        if (responseCache && pendingResponses.empty() && !currentResponse->isValid() &&
+            responseCache->find(currentRequest, &cachedResponse))
+        {
+            if (config->verbosity >= HttpServerConfig::Verbose::Debug)
+            {
+                qDebug().noquote() << QString("Sending cached response for %1 request to %2 from %3")
+                    .arg(currentRequest->method()).arg(currentRequest->uriStr()).arg(address.toString());
+            }
+
+            socket->write(cachedResponse);
+
+            HttpRequest::release(currentRequest);
+            HttpResponse::release(currentResponse);
+            currentRequest = nullptr;
+            currentResponse = nullptr;
+
+            // Starts the keep-alive timer since there are no pending responses
+            bytesWritten(0);
+            continue;
+        }
 
         // Store request & response in map while it is processed asynchronously
-        auto httpData = std::make_shared<HttpData>(currentRequest, currentResponse);
+        auto httpData = std::make_shared<HttpData>(currentRequest, currentResponse, pool);
         data.emplace(currentResponse, httpData);
-        pendingResponses.push(currentResponse);
+        pendingResponses.push_back(currentResponse);
 
         // If a response exists, then just send that, doesn't matter if its an error or not
         if (currentResponse->isValid())
         {
             currentResponse->setupFromRequest(currentRequest);
+            finishResponse(httpData);
+
             currentRequest = nullptr;
             currentResponse = nullptr;
-            return;
+            continue;
         }
 
+        // Setup the response from the request before the handler runs so it can negotiate based off request headers
+        currentResponse->setupFromRequest(currentRequest);
+
         if (config->verbosity >= HttpServerConfig::Verbose::Info)
             qInfo().noquote() << QString("Received %1 request to %2 from %3").arg(currentRequest->method())
                 .arg(currentRequest->uriStr()).arg(address.toString());
 
-        // Handle request and setup timeout timer if necessary
-        // Note: Wrap the handler in a promise so exceptions are handled correctly
-        // Note: Create local copies of current request and response so they are captured by value in the lambda
-        auto request = currentRequest;
-        auto response = currentResponse;
-        auto promise = HttpPromise::resolve(httpData).then([=](HttpDataPtr data) {
-            return requestHandler->handle(data);
-        });
-        if (config->responseTimeout > 0)
-            promise = promise.timeout(config->responseTimeout * 1000);
+        // Stop reading until the response is sent if the client asked to switch protocols
+        // Note: Set before handling the request since a synchronous handler can send the response right away
+        QString upgradeProtocol;
+        if (currentRequest->header("Upgrade", &upgradeProtocol))
+            upgradeResponse = currentResponse;
+
+        // Clear pointers for next request
+        currentRequest = nullptr;
+        currentResponse = nullptr;
+
+        handleRequest(httpData);
+
+        // Socket is gone if the response was an accepted upgrade that has already been sent
+        if (upgradeResponse || !socket)
+            return;
+    }
+}
+
+void HttpConnection::scheduleRead()
+{
+    if (readScheduled)
+        return;
+
+    readScheduled = true;
+    QMetaObject::invokeMethod(this, [this]() {
+        readScheduled = false;
+        if (socket)
+            read();
+    }, Qt::QueuedConnection);
+}
+
+void HttpConnection::memoryAvailable()
+{
+    if (readPaused && socket && !isBacklogged())
+        resumeReading();
+}
+
+void HttpConnection::updateMemoryUsage()
+{
+    if (!memoryBudget)
+        return;
+
+    qint64 usage = currentRequest ? currentRequest->bufferedBytes() : 0;
+    if (socket)
+        usage += socket->bytesAvailable() + socket->bytesToWrite();
+
+    // Responses hold their body from the moment the handler sets it, not only once they are being sent
+    for (HttpResponse *response : pendingResponses)
+    {
+        usage += response->bufferedBytes();
+
+        auto it = data.find(response);
+        if (it != data.end())
+            usage += it->second->request->bufferedBytes();
+    }
+
+    memoryBudget->add(usage - accountedBytes);
+    accountedBytes = usage;
+}
+
+bool HttpConnection::isBacklogged() const
+{
+    if (config->maxPipelinedRequests > 0 && (int)pendingResponses.size() >= config->maxPipelinedRequests)
+        return true;
+
+    if (config->maxPendingResponseBytes <= 0)
+        return false;
+
+    qint64 queuedBytes = socket->bytesToWrite();
+    for (HttpResponse *response : pendingResponses)
+        queuedBytes += response->queuedBytes();
+
+    return queuedBytes >= config->maxPendingResponseBytes;
+}
+
+void HttpConnection::pauseReading()
+{
+    if (readPaused)
+        return;
+
+    if (config->verbosity >= HttpServerConfig::Verbose::Debug)
+    {
+        qDebug().noquote() << QString("Pausing reads from %1 (%2 queued responses)").arg(address.toString())
+            .arg(pendingResponses.size());
+    }
+
+    // Limit the socket buffer so the kernel applies TCP back-pressure instead of data piling up in memory
+    // Note: The client is not to blame for the request rate while we are not reading
+    readPaused = true;
+    requestRate.stop();
+    socket->setReadBufferSize(config->maxRequestSize);
+
+    // A request paused part way (e.g. a body while over the memory budget) is not measured by the request rate, so
+    // the request timeout applies instead. Otherwise the connection could stay paused forever if memory is never freed
+    if (currentRequest)
+        timeoutTimer->start(config->requestTimeout * 1000);
+}
+
+void HttpConnection::resumeReading()
+{
+    readPaused = false;
+    socket->setReadBufferSize(0);
+
+    // Requests already buffered while paused do not emit readyRead again
+    scheduleRead();
+}
+
+void HttpConnection::startDataRate(HttpDataRate &rate)
+{
+    const int minRate = &rate == &requestRate ? config->minRequestDataRate : config->minResponseDataRate;
+    if (minRate <= 0 || rate.isActive())
+        return;
+
+    rate.start();
+    if (!dataRateTimer->isActive())
+        dataRateTimer->start();
+}
+
+void HttpConnection::checkDataRates()
+{
+    if (!requestRate.isActive() && !responseRate.isActive())
+    {
+        dataRateTimer->stop();
+        return;
+    }
+
+    if (requestRate.isBelow(config->minRequestDataRate, config->dataRateGracePeriod))
+    {
+        if (config->verbosity >= HttpServerConfig::Verbose::Info)
+        {
+            qInfo().noquote() << QString("Request from %1 is sent at %2 bytes/s, below the minimum of %3")
+                .arg(address.toString()).arg(requestRate.rate()).arg(config->minRequestDataRate);
+        }
+
+        sendTimeout();
+        return;
+    }
+
+    if (responseRate.isBelow(config->minResponseDataRate, config->dataRateGracePeriod))
+    {
+        if (config->verbosity >= HttpServerConfig::Verbose::Info)
+        {
+            qInfo().noquote() << QString("Response to %1 is read at %2 bytes/s, below the minimum of %3")
+                .arg(address.toString()).arg(responseRate.rate()).arg(config->minResponseDataRate);
+        }
+
+        // Anything still buffered would not be read by the client anyway
+        requestRate.stop();
+        responseRate.stop();
+        dataRateTimer->stop();
+        socket->abort();
+    }
+}
+
+void HttpConnection::handleRequest(HttpDataPtr httpData)
+{
+    HttpResponse *response = httpData->response;
+
+    // Most handlers finish synchronously, send their response right away without going through the promise machinery
+    HttpResult result = httpData;
+    try
+    {
+        result = requestHandler->dispatch(httpData);
+    }
+    catch (const HttpException &error)
+    {
+        response->setError(error.status, error.message, false);
+    }
+    catch (const std::exception &error)
+    {
+        response->setError(HttpStatus::InternalServerError, error.what(), false);
+    }
+
+    if (result.isReady())
+    {
+        handlerFinished(httpData);
+        return;
+    }
 
-        promise
-            .fail([=](const QPromiseTimeoutException &error) {
-                // Request timed out
+    HttpPromise promise = result.toPromise();
+
+    // Handle request asynchronously and setup timeout timer if necessary
+    if (config->responseTimeout > 0)
+        promise = promise.timeout(config->responseTimeout * 1000);
+
+    promise
+        .fail([=](const QPromiseTimeoutException &error) {
+            // Request timed out, unless it is streaming a chunked response which is sent as long as the handler
+            // produces it
+            if (!response->isChunked() || !response->isSending())
                 response->setError(HttpStatus::RequestTimeout, "", false);
-                return nullptr;
-            })
-            .fail([=](const HttpException &error) {
-                response->setError(error.status, error.message, false);
-                return nullptr;
-            })
-            .fail([=](const std::exception &error) {
-                response->setError(HttpStatus::InternalServerError, error.what(), false);
-                return nullptr;
-            })
-            .finally([=]() {
-                // If response is already finished, don't do anything
-                // This can occur if the socket is closed prematurely
-                if (httpData->finished)
-                    return;
-
-                // Handle if no response is set
-                // This should not happen, but handle it and warn the user
-                if (!response->isValid())
-                {
-                    if (config->verbosity >= HttpServerConfig::Verbose::Warning)
-                    {
-                        qWarning().noquote() << QString("No valid response set, defaulting to 500: %1 %2 %3")
-                            .arg(request->method()).arg(request->uriStr()).arg(address.toString());
-                    }
-                    response->setError(HttpStatus::InternalServerError, "An unknown error occurred", false);
-                }
 
-                // Send response
-                httpData->finished = true;
-                response->prepareToSend();
+            return nullptr;
+        })
+        .fail([=](const HttpException &error) {
+            response->setError(error.status, error.message, false);
+            return nullptr;
+        })
+        .fail([=](const std::exception &error) {
+            response->setError(HttpStatus::InternalServerError, error.what(), false);
+            return nullptr;
+        })
+        .finally([=]() {
+            handlerFinished(httpData);
+        });
+}
 
-                // If we were waiting on this response to be sent, then call bytesWritten to get things rolling
-                if (response == pendingResponses.front())
-                    bytesWritten(0);
-            });
+void HttpConnection::handlerFinished(HttpDataPtr httpData)
+{
+    // Nothing can append to or end a chunked response once the handler is done, unless it was explicitly kept open.
+    // End it, otherwise it never finishes and every pipelined response behind it is stuck
+    HttpResponse *response = httpData->response;
+    if (response->isChunked() && !response->isChunkedKeptOpen())
+        response->endChunked();
+
+    // If response is already finished, don't do anything
+    // This can occur if the socket is closed prematurely or a chunked response already sent its headers
+    if (httpData->finished)
+        return;
 
-        currentResponse->setupFromRequest(currentRequest);
+    finishResponse(httpData);
+}
 
-        // Clear pointers for next request
-        currentRequest = nullptr;
-        currentResponse = nullptr;
+void HttpConnection::finishResponse(HttpDataPtr httpData)
+{
+    HttpRequest *request = httpData->request;
+    HttpResponse *response = httpData->response;
+
+    // Handle if no response is set
+    // This should not happen, but handle it and warn the user
+    if (!response->isValid())
+    {
+        if (config->verbosity >= HttpServerConfig::Verbose::Warning)
+        {
+            qWarning().noquote() << QString("No valid response set, defaulting to 500: %1 %2 %3")
+                .arg(request->method()).arg(request->uriStr()).arg(address.toString());
+        }
+        response->setError(HttpStatus::InternalServerError, "An unknown error occurred", false);
+    }
+
+    // Compress the body if the client accepts it, this is done last so handlers don't need to remember to
+    if (config->autoCompression)
+        response->negotiateCompression();
+
+    // Send response
+    httpData->finished = true;
+    response->prepareToSend();
+
+    if (responseCache)
+        responseCache->insert(request, response);
+
+    // If we were waiting on this response to be sent, then call bytesWritten to get things rolling
+    if (response == pendingResponses.front())
+        bytesWritten(0);
+    else
+        updateMemoryUsage();
+}
+
+void HttpConnection::responseUpdated(HttpResponse *response)
+{
+    auto it = data.find(response);
+    if (it == data.end())
+        return;
+
+    // Chunked response was started, send the headers right away rather than waiting for the handler to finish
+    if (!it->second->finished)
+    {
+        finishResponse(it->second);
+        return;
     }
+
+    // More chunks are available, send them if this response is next in line
+    if (response == pendingResponses.front())
+        bytesWritten(0);
 }
 
 void HttpConnection::bytesWritten(qint64 bytes)
 {
+    responseRate.add(bytes);
+
     bool closeConnection = false;
+    bool resumeReading = false;
+    std::function<void(QTcpSocket *)> upgradeHandler;
 
     // Keep sending the responses until the buffer fills up
     while (!pendingResponses.empty())
@@ -173,6 +516,19 @@ void HttpConnection::bytesWritten(qint64 bytes)
         if (!response->isSending())
             break;
 
+        // Body was cut short by an error, closing the connection is the only way to let the client know
+        if (response->isAborted())
+        {
+            if (config->verbosity >= HttpServerConfig::Verbose::Debug)
+            {
+                qDebug().noquote() << QString("Aborting connection to %1 after incomplete response")
+                    .arg(address.toString());
+            }
+
+            socket->abort();
+            return;
+        }
+
         // If writeChunk returns false, means buffer is full
         if (!response->writeChunk(socket))
             break;
@@ -185,7 +541,19 @@ void HttpConnection::bytesWritten(qint64 bytes)
         // If any of the responses say to close the connection, then do that
         closeConnection |= connection.contains("close", Qt::CaseInsensitive);
 
+        // Switch protocols once the upgrade response is sent, otherwise the upgrade was declined so continue reading
+        if (response == upgradeResponse)
+        {
+            upgradeResponse = nullptr;
+            if (response->status() == HttpStatus::SwitchingProtocols)
+                upgradeHandler = response->upgradeHandler();
+
+            resumeReading = !upgradeHandler;
+        }
+
         // Delete the corresponding request for the response
+        // Note: Handlers could still hold onto the response, so make sure it does not notify us anymore
+        response->detach();
         auto it = data.find(response);
         if (it != data.end())
         {
@@ -194,11 +562,32 @@ void HttpConnection::bytesWritten(qint64 bytes)
         }
 
         // Delete response and pop from queue
-        pendingResponses.pop();
+        pendingResponses.pop_front();
+
+        if (upgradeHandler)
+        {
+            upgrade(upgradeHandler);
+            return;
+        }
     }
 
     socket->flush();
 
+    // Measured while the socket has data waiting on the client to read it
+    if (socket->bytesToWrite() > 0)
+        startDataRate(responseRate);
+    else
+        responseRate.stop();
+
+    if (readPaused && !isBacklogged())
+        resumeReading();
+
+    updateMemoryUsage();
+
+    // Read any requests that arrived while waiting on the declined upgrade
+    if (resumeReading)
+        QMetaObject::invokeMethod(this, "read", Qt::QueuedConnection);
+
     // If we are done sending responses, close the connection or start keep-alive timer
     if (pendingResponses.empty())
     {
@@ -214,6 +603,23 @@ void HttpConnection::bytesWritten(qint64 bytes)
     }
 }
 
+void HttpConnection::upgrade(std::function<void(QTcpSocket *)> handler)
+{
+    if (config->verbosity >= HttpServerConfig::Verbose::Debug)
+        qDebug().noquote() << QString("Switching protocols for client %1").arg(address.toString());
+
+    // Hand the socket over to the new protocol (e.g. WebSocket), this connection is done with it
+    disconnect(socket, nullptr, this, nullptr);
+    timeoutTimer->stop();
+    dataRateTimer->stop();
+
+    QTcpSocket *upgradedSocket = socket;
+    socket = nullptr;
+    handler(upgradedSocket);
+
+    emit disconnected();
+}
+
 void HttpConnection::timeout()
 {
     // If we are in keep-alive mode (meaning this socket has already had one successful request) and there is no data
@@ -224,9 +630,19 @@ void HttpConnection::timeout()
         return;
     }
 
-    // Otherwise we send a request timeout response
+    sendTimeout();
+}
+
+void HttpConnection::sendTimeout()
+{
+    requestRate.stop();
+    responseRate.stop();
+    dataRateTimer->stop();
+    timeoutTimer->stop();
+
+    // Send a request timeout response
     if (!currentResponse)
-        currentResponse = new HttpResponse(config);
+        currentResponse = HttpResponse::create(config);
 
     currentResponse->setError(HttpStatus::RequestTimeout, "", true);
     currentResponse->prepareToSend();
@@ -244,6 +660,7 @@ void HttpConnection::socketDisconnected()
         qDebug().noquote() << QString("Client %1 disconnected").arg(address.toString());
 
     timeoutTimer->stop();
+    dataRateTimer->stop();
     emit disconnected();
 }
 
@@ -266,28 +683,39 @@ void HttpConnection::sslErrors(const QList<QSslError> &errors)
 
 HttpConnection::~HttpConnection()
 {
-    socket->abort();
-    delete socket;
+    // Socket is not owned by this connection anymore if it was upgraded to another protocol
+    if (socket)
+    {
+        socket->abort();
+        delete socket;
+    }
+
     delete timeoutTimer;
+    delete dataRateTimer;
 
     // Delete pending responses
-    while (!pendingResponses.empty())
-        pendingResponses.pop();
+    pendingResponses.clear();
+
+    if (memoryBudget)
+        memoryBudget->add(-accountedBytes);
 
     // Clear pending requests, will be automatically cleaned up
     for (auto it : data)
+    {
         it.second->finished = true;
+        it.second->response->detach();
+    }
     data.clear();
 
     if (currentRequest)
     {
-        delete currentRequest;
+        HttpRequest::release(currentRequest);
         currentRequest = nullptr;
     }
 
     if (currentResponse)
     {
-        delete currentResponse;
+        HttpResponse::release(currentResponse);
         currentResponse = nullptr;
     }
 }
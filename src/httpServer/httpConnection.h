@@ -2,21 +2,27 @@
 #define HTTP_SERVER_HTTP_CONNECTION_H
 
 #include "httpData.h"
+#include "httpDataRate.h"
+#include "httpMemoryBudget.h"
 #include "httpServerConfig.h"
 #include "httpRequest.h"
 #include "httpRequestHandler.h"
 #include "httpResponse.h"
+#include "httpResponseCache.h"
+#include "httpThreadPool.h"
 #include "util.h"
 
 #include <exception>
+#include <functional>
 #include <list>
 #include <memory>
+#include <QPointer>
 #include <QTcpSocket>
 #include <QThread>
 #include <QSslConfiguration>
 #include <QTimer>
 #include <QtPromise>
-#include <queue>
+#include <deque>
 #include <unordered_map>
 
 
@@ -31,29 +37,61 @@ private:
     QHostAddress address;
     QTimer *timeoutTimer;
     bool keepAliveMode;
+    // Checks the data rates every second while a request is being received or a response is waiting on the client
+    QTimer *dataRateTimer;
+    HttpDataRate requestRate;
+    HttpDataRate responseRate;
 
     HttpRequest *currentRequest;
     HttpResponse *currentResponse;
 
     HttpRequestHandler *requestHandler;
+    HttpResponseCache *responseCache;
+    HttpThreadPool *pool;
+    // Note: Connections can be deleted after the server, the pointer is cleared if the budget is deleted first
+    QPointer<HttpMemoryBudget> memoryBudget;
+    // Bytes last added to the memory budget for this connection
+    qint64 accountedBytes;
     // Responses are stored in a queue to support HTTP pipelining and sending multiple responses
-    std::queue<HttpResponse *> pendingResponses;
+    std::deque<HttpResponse *> pendingResponses;
     // Store data for each request to enable asynchronous logic
     std::unordered_map<HttpResponse *, HttpDataPtr> data;
+    // Response to a request asking for a protocol upgrade, reading is paused until it is sent
+    HttpResponse *upgradeResponse;
+    // True while a read is queued because the previous one used up its budget
+    bool readScheduled;
+    // True while reading is paused because too many responses are queued or the memory budget is exceeded
+    bool readPaused;
 
     const QSslConfiguration *sslConfig;
 
     void createSocket(qintptr socketDescriptor);
+    void readRequests();
+    void updateMemoryUsage();
+    void scheduleRead();
+    bool isBacklogged() const;
+    void pauseReading();
+    void resumeReading();
+    void startDataRate(HttpDataRate &rate);
+    void sendTimeout();
+    void handleRequest(HttpDataPtr httpData);
+    void handlerFinished(HttpDataPtr httpData);
+    void finishResponse(HttpDataPtr httpData);
+    void responseUpdated(HttpResponse *response);
+    void upgrade(std::function<void(QTcpSocket *)> handler);
 
 public:
     HttpConnection(HttpServerConfig *config, HttpRequestHandler *requestHandler, qintptr socketDescriptor,
-        QSslConfiguration *sslConfig = nullptr, QObject *parent = nullptr);
+        QSslConfiguration *sslConfig = nullptr, HttpResponseCache *responseCache = nullptr,
+        HttpThreadPool *pool = nullptr, HttpMemoryBudget *memoryBudget = nullptr, QObject *parent = nullptr);
     ~HttpConnection();
 
 private slots:
     void read();
+    void memoryAvailable();
     void bytesWritten(qint64 bytes);
     void timeout();
+    void checkDataRates();
     void socketDisconnected();
     void sslErrors(const QList<QSslError> &errors);
 
@@ -0,0 +1,55 @@
+#include "httpContext.h"
+
+std::atomic<int> HttpContext::keyCount(0);
+
+HttpContext::Slot::Slot() noexcept : ops(nullptr)
+{
+}
+
+HttpContext::Slot::Slot(Slot &&other) noexcept : ops(other.ops)
+{
+    if (ops)
+        ops->move(&other.storage, &storage);
+
+    other.ops = nullptr;
+}
+
+HttpContext::Slot::~Slot()
+{
+    reset();
+}
+
+void HttpContext::Slot::reset()
+{
+    if (ops)
+        ops->destroy(&storage);
+
+    ops = nullptr;
+}
+
+int HttpContext::registerKey()
+{
+    return keyCount++;
+}
+
+HttpContext::Slot &HttpContext::slot(int index)
+{
+    if (index < inlineSlotCount)
+        return inlineSlots[index];
+
+    // Size for every key registered so far, so the vector is only allocated once unless keys are added later
+    const size_t overflowIndex = index - inlineSlotCount;
+    if (overflowIndex >= overflowSlots.size())
+        overflowSlots.resize(std::max<size_t>(overflowIndex + 1, keyCount - inlineSlotCount));
+
+    return overflowSlots[overflowIndex];
+}
+
+const HttpContext::Slot *HttpContext::findSlot(int index) const
+{
+    if (index < inlineSlotCount)
+        return &inlineSlots[index];
+
+    const size_t overflowIndex = index - inlineSlotCount;
+    return overflowIndex < overflowSlots.size() ? &overflowSlots[overflowIndex] : nullptr;
+}
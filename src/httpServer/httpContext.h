@@ -0,0 +1,163 @@
+#ifndef HTTP_SERVER_HTTP_CONTEXT_H
+#define HTTP_SERVER_HTTP_CONTEXT_H
+
+#include "util.h"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+template <typename T>
+class HttpContextKey;
+
+// Per-request storage for values passed between middleware & handlers
+//
+// Each HttpContextKey gets a dense index when it is created, values are stored in place in the slot for that index, so
+// setting or getting a value does no hashing and no heap allocation. Keys are meant to be created once at startup,
+// e.g. as global or static variables.
+//
+// Example:
+//     static const HttpContextKey<QString> userKey;
+//     data->set(userKey, QString("admin"));
+//     QString *user = data->get(userKey);
+class HTTPSERVER_EXPORT HttpContext
+{
+public:
+    // Bytes of storage in each slot, larger values can be stored through a std::shared_ptr
+    static const int slotSize = 32;
+
+private:
+    // Slots are stored in the context itself up to this index, a vector is allocated for the rest
+    static const int inlineSlotCount = 8;
+
+    static std::atomic<int> keyCount;
+
+    struct SlotOps
+    {
+        void (*destroy)(void *value);
+        void (*move)(void *from, void *to);
+    };
+
+    template <typename T>
+    struct SlotOpsFor
+    {
+        static void destroy(void *value)
+        {
+            static_cast<T *>(value)->~T();
+        }
+
+        static void move(void *from, void *to)
+        {
+            new (to) T(std::move(*static_cast<T *>(from)));
+            static_cast<T *>(from)->~T();
+        }
+
+        static const SlotOps ops;
+    };
+
+    struct Slot
+    {
+        typename std::aligned_storage<slotSize, alignof(std::max_align_t)>::type storage;
+        // Null when the slot is empty
+        const SlotOps *ops;
+
+        Slot() noexcept;
+        Slot(Slot &&other) noexcept;
+        ~Slot();
+
+        Slot(const Slot &) = delete;
+        Slot &operator=(const Slot &) = delete;
+        Slot &operator=(Slot &&) = delete;
+
+        void reset();
+    };
+
+    Slot inlineSlots[inlineSlotCount];
+    std::vector<Slot> overflowSlots;
+
+    Slot &slot(int index);
+    const Slot *findSlot(int index) const;
+
+    template <typename T>
+    friend class HttpContextKey;
+
+    static int registerKey();
+
+public:
+    HttpContext() = default;
+
+    HttpContext(const HttpContext &) = delete;
+    HttpContext &operator=(const HttpContext &) = delete;
+
+    // Note: Type of the value is taken from the key, so set(key, "text") works for a HttpContextKey<QString>
+    template <typename T>
+    void set(const HttpContextKey<T> &key, typename std::decay<T>::type value)
+    {
+        Slot &s = slot(key.index());
+        s.reset();
+        new (&s.storage) T(std::move(value));
+        s.ops = &SlotOpsFor<T>::ops;
+    }
+
+    // Returns nullptr if no value is set for the key
+    template <typename T>
+    T *get(const HttpContextKey<T> &key)
+    {
+        return const_cast<T *>(static_cast<const HttpContext *>(this)->get(key));
+    }
+
+    template <typename T>
+    const T *get(const HttpContextKey<T> &key) const
+    {
+        const Slot *s = findSlot(key.index());
+        return s && s->ops ? reinterpret_cast<const T *>(&s->storage) : nullptr;
+    }
+
+    template <typename T>
+    T value(const HttpContextKey<T> &key, typename std::decay<T>::type defaultValue = T()) const
+    {
+        const T *value = get(key);
+        return value ? *value : defaultValue;
+    }
+
+    template <typename T>
+    bool contains(const HttpContextKey<T> &key) const
+    {
+        return get(key) != nullptr;
+    }
+
+    template <typename T>
+    void remove(const HttpContextKey<T> &key)
+    {
+        if (findSlot(key.index()))
+            slot(key.index()).reset();
+    }
+};
+
+template <typename T>
+const HttpContext::SlotOps HttpContext::SlotOpsFor<T>::ops = {&SlotOpsFor<T>::destroy, &SlotOpsFor<T>::move};
+
+// Key for a value of type T in HttpContext
+template <typename T>
+class HttpContextKey
+{
+    static_assert(sizeof(T) <= HttpContext::slotSize, "Type is too large for a context slot, use a std::shared_ptr");
+    static_assert(alignof(T) <= alignof(std::max_align_t), "Type is over-aligned for a context slot");
+
+private:
+    int index_;
+
+public:
+    HttpContextKey() : index_(HttpContext::registerKey()) {}
+
+    HttpContextKey(const HttpContextKey &) = delete;
+    HttpContextKey &operator=(const HttpContextKey &) = delete;
+
+    int index() const { return index_; }
+};
+
+#endif // HTTP_SERVER_HTTP_CONTEXT_H
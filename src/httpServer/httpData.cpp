@@ -1,8 +1,11 @@
+#include "const.h"
 #include "httpData.h"
 #include "httpRequest.h"
 #include "httpResponse.h"
+#include "httpThreadPool.h"
 
-HttpData::HttpData(HttpRequest *request, HttpResponse *response) : request(request), response(response), state(), finished(false)
+HttpData::HttpData(HttpRequest *request, HttpResponse *response, HttpThreadPool *pool) : request(request),
+    response(response), state(), context(), params(), finished(false), pool(pool)
 {
 }
 
@@ -14,6 +17,154 @@ void HttpData::checkFinished()
 
 HttpData::~HttpData()
 {
-    delete request;
-    delete response;
+    HttpRequest::release(request);
+    HttpResponse::release(response);
+}
+
+HttpPromise HttpData::runOnPool(std::function<void()> function)
+{
+    HttpDataPtr self = shared_from_this();
+
+    return HttpPromise([&](const QtPromise::QPromiseResolve<HttpDataPtr> &resolve,
+        const QtPromise::QPromiseReject<HttpDataPtr> &reject) {
+        // Without a pool the function is run right away
+        if (!pool)
+        {
+            try
+            {
+                function();
+                resolve(self);
+            }
+            catch (...)
+            {
+                reject(std::current_exception());
+            }
+
+            return;
+        }
+
+        HttpCompletionQueue *queue = HttpCompletionQueue::current();
+        pool->start([=]() mutable {
+            std::exception_ptr error;
+            try
+            {
+                function();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            // Note: Captures are moved into the completion so the data is released on the connection thread
+            queue->post([self, resolve, reject, error]() {
+                if (error)
+                    reject(error);
+                else
+                    resolve(self);
+            });
+            self = nullptr;
+        }, [queue, reject]() {
+            queue->post([reject]() {
+                reject(HttpException(HttpStatus::ServiceUnavailable, "Server is shutting down"));
+            });
+        });
+    });
+}
+
+QString HttpData::param(int index) const
+{
+    return params.param(index);
+}
+
+QString HttpData::param(const QString &name) const
+{
+    return params.param(name);
+}
+
+qlonglong HttpData::paramInt(int index, bool *ok) const
+{
+    return params.paramInt(index, ok);
+}
+
+qlonglong HttpData::paramInt(const QString &name, bool *ok) const
+{
+    return params.paramInt(name, ok);
+}
+
+void HttpRouteParams::setMatch(const QRegularExpressionMatch &match)
+{
+    match_ = match;
+}
+
+void HttpRouteParams::setPath(const QString &path)
+{
+    this->path = path;
+}
+
+void HttpRouteParams::addPathParam(const QString &name, int start, int length)
+{
+    pathParams.append({name, start, length});
+}
+
+void HttpRouteParams::clear()
+{
+    match_ = QRegularExpressionMatch();
+    path.clear();
+    pathParams.clear();
+}
+
+int HttpRouteParams::size() const
+{
+    if (!pathParams.isEmpty())
+        return pathParams.size();
+
+    return std::max(match_.lastCapturedIndex(), 0);
+}
+
+QString HttpRouteParams::param(int index) const
+{
+    if (index < 0)
+        return QString();
+
+    if (index < pathParams.size())
+        return path.mid(pathParams[index].start, pathParams[index].length);
+
+    // Capture group 0 is the entire match
+    return match_.captured(index + 1);
+}
+
+QString HttpRouteParams::param(const QString &name) const
+{
+    for (const PathParam &pathParam : pathParams)
+    {
+        if (pathParam.name == name)
+            return path.mid(pathParam.start, pathParam.length);
+    }
+
+    return match_.hasMatch() ? match_.captured(name) : QString();
+}
+
+qlonglong HttpRouteParams::paramInt(int index, bool *ok) const
+{
+    if (index >= 0 && index < pathParams.size())
+        return path.midRef(pathParams[index].start, pathParams[index].length).toLongLong(ok);
+
+    // Note: capturedRef returns a null reference for groups that did not capture, which fails to convert
+    return match_.capturedRef(index < 0 ? -1 : index + 1).toLongLong(ok);
+}
+
+qlonglong HttpRouteParams::paramInt(const QString &name, bool *ok) const
+{
+    for (const PathParam &pathParam : pathParams)
+    {
+        if (pathParam.name == name)
+            return path.midRef(pathParam.start, pathParam.length).toLongLong(ok);
+    }
+
+    return match_.capturedRef(name).toLongLong(ok);
+}
+
+const QRegularExpressionMatch &HttpRouteParams::match() const
+{
+    return match_;
 }
@@ -1,28 +1,107 @@
 #ifndef HTTP_SERVER_HTTP_DATA_H
 #define HTTP_SERVER_HTTP_DATA_H
 
+#include "httpContext.h"
 #include "util.h"
 
+#include <functional>
+#include <memory>
 #include <unordered_map>
+#include <QRegularExpressionMatch>
+#include <QtPromise>
 #include <QString>
+#include <QVarLengthArray>
 #include <QVariant>
 
 
 // Forward declarations
 class HttpRequest;
 class HttpResponse;
+class HttpThreadPool;
 
-struct HTTPSERVER_EXPORT HttpData
+// Parameters of the route that matched the request, the capture groups of a regex route or the parameters of a path
+// route
+//
+// Values are only extracted from the path when they are accessed, so handlers that do not use them pay nothing
+class HTTPSERVER_EXPORT HttpRouteParams
+{
+private:
+    struct PathParam
+    {
+        QString name;
+        int start;
+        int length;
+    };
+
+    QRegularExpressionMatch match_;
+
+    QString path;
+    // Routes rarely have more than a few parameters, these are stored without allocating
+    QVarLengthArray<PathParam, 4> pathParams;
+
+public:
+    void setMatch(const QRegularExpressionMatch &match);
+    void setPath(const QString &path);
+    void addPathParam(const QString &name, int start, int length);
+    void clear();
+
+    // Number of parameters, capture groups for regex routes (excluding the implicit group for the entire match)
+    int size() const;
+
+    // Index 0 is the first parameter or capture group, returns a null string if there is no such parameter
+    QString param(int index) const;
+    QString param(const QString &name) const;
+
+    // Parameter converted to an integer without copying it, e.g. for :id<int> parameters. Returns 0 and sets ok to
+    // false if there is no such parameter or it is not an integer
+    qlonglong paramInt(int index, bool *ok = nullptr) const;
+    qlonglong paramInt(const QString &name, bool *ok = nullptr) const;
+
+    // Regex match of the route, invalid for path routes
+    const QRegularExpressionMatch &match() const;
+};
+
+struct HTTPSERVER_EXPORT HttpData : public std::enable_shared_from_this<HttpData>
 {
     HttpRequest *request;
     HttpResponse *response;
+    // Values passed between middleware & handlers, context is preferred since it avoids hashing & boxing in QVariant
     std::unordered_map<QString, QVariant> state;
+    HttpContext context;
+    HttpRouteParams params;
     bool finished;
+    // Pool of the server the request was received by, nullptr if the data was not created by a connection
+    HttpThreadPool *pool;
 
-    HttpData(HttpRequest *request, HttpResponse *response);
+    HttpData(HttpRequest *request, HttpResponse *response, HttpThreadPool *pool = nullptr);
     ~HttpData();
 
     void checkFinished();
+
+    // Runs the function on the thread pool, the promise is resolved on the current thread once it has finished
+    // Use this for CPU-heavy work that would otherwise stall every other connection on the thread. The function must
+    // not touch the request or response, set the response in a .then() on the returned promise instead:
+    //     return data->runOnPool([=]() { thumbnail = resize(image); }).then([=](HttpDataPtr data) { ... });
+    // The promise is rejected with a 503 HttpException if the server is destroyed before the function started.
+    QtPromise::QPromise<std::shared_ptr<HttpData>> runOnPool(std::function<void()> function);
+
+    QString param(int index) const;
+    QString param(const QString &name) const;
+    qlonglong paramInt(int index, bool *ok = nullptr) const;
+    qlonglong paramInt(const QString &name, bool *ok = nullptr) const;
+
+    template <typename T>
+    void set(const HttpContextKey<T> &key, typename std::decay<T>::type value)
+    {
+        context.set(key, std::move(value));
+    }
+
+    // Returns nullptr if no value is set for the key
+    template <typename T>
+    T *get(const HttpContextKey<T> &key)
+    {
+        return context.get(key);
+    }
 };
 
 #endif // HTTP_SERVER_HTTP_DATA_H
@@ -0,0 +1,68 @@
+#include "httpDataRate.h"
+
+#include <algorithm>
+#include <numeric>
+
+
+HttpDataRate::HttpDataRate(int window) : buckets(std::max(window, 1), 0), startTime(0), lastSecond(0), active(false)
+{
+    clock.start();
+}
+
+void HttpDataRate::start()
+{
+    if (active)
+        return;
+
+    active = true;
+    startTime = clock.elapsed();
+    lastSecond = startTime / 1000;
+    std::fill(buckets.begin(), buckets.end(), 0);
+}
+
+void HttpDataRate::stop()
+{
+    active = false;
+}
+
+void HttpDataRate::advance(qint64 second)
+{
+    // Clear the buckets of the seconds that passed without any data, at most the entire window
+    const qint64 count = std::min<qint64>(second - lastSecond, buckets.size());
+    for (qint64 i = 1; i <= count; ++i)
+        buckets[(lastSecond + i) % buckets.size()] = 0;
+
+    lastSecond = std::max(lastSecond, second);
+}
+
+void HttpDataRate::add(qint64 bytes)
+{
+    if (!active || bytes <= 0)
+        return;
+
+    const qint64 second = clock.elapsed() / 1000;
+    advance(second);
+    buckets[second % buckets.size()] += bytes;
+}
+
+qint64 HttpDataRate::rate()
+{
+    if (!active)
+        return 0;
+
+    const qint64 now = clock.elapsed();
+    advance(now / 1000);
+
+    // Note: The current second is only partially over, so the rate is slightly underestimated at most
+    const qint64 duration = std::min<qint64>(std::max<qint64>(now - startTime, 1), buckets.size() * 1000);
+    const qint64 bytes = std::accumulate(buckets.begin(), buckets.end(), qint64(0));
+    return bytes * 1000 / duration;
+}
+
+bool HttpDataRate::isBelow(int minRate, int gracePeriod)
+{
+    if (!active || minRate <= 0 || clock.elapsed() - startTime < gracePeriod * 1000ll)
+        return false;
+
+    return rate() < minRate;
+}
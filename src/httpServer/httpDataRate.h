@@ -0,0 +1,44 @@
+#ifndef HTTP_SERVER_HTTP_DATA_RATE_H
+#define HTTP_SERVER_HTTP_DATA_RATE_H
+
+#include "util.h"
+
+#include <QElapsedTimer>
+#include <vector>
+
+
+// Bytes transferred per second over a sliding window of whole seconds
+//
+// Used by connections to drop peers that send requests or read responses too slowly (e.g. slowloris) instead of
+// relying on a fixed timeout. Measuring starts with start() and the rate is only judged once the grace period has
+// passed, so a slow TCP start or a short pause is not punished.
+class HTTPSERVER_EXPORT HttpDataRate
+{
+private:
+    // Bytes transferred in each second of the window, indexed by second modulo the window size
+    std::vector<qint64> buckets;
+    QElapsedTimer clock;
+    qint64 startTime;
+    qint64 lastSecond;
+    bool active;
+
+    void advance(qint64 second);
+
+public:
+    explicit HttpDataRate(int window);
+
+    // Starts measuring, does nothing if already measuring
+    void start();
+    void stop();
+    bool isActive() const { return active; }
+
+    void add(qint64 bytes);
+
+    // Average bytes per second over the window, or since measuring started if that is shorter
+    qint64 rate();
+
+    // Returns true if the rate is below the minimum once measuring for at least gracePeriod seconds
+    bool isBelow(int minRate, int gracePeriod);
+};
+
+#endif // HTTP_SERVER_HTTP_DATA_RATE_H
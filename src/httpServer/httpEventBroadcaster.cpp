@@ -0,0 +1,119 @@
+#include "httpEventBroadcaster.h"
+
+HttpEventBroadcaster::HttpEventBroadcaster(int maxBacklog, int keepAliveInterval, QObject *parent) : QObject(parent),
+    maxBacklog(maxBacklog)
+{
+    keepAliveTimer = new QTimer(this);
+    connect(keepAliveTimer, &QTimer::timeout, this, &HttpEventBroadcaster::keepAlive);
+
+    if (keepAliveInterval > 0)
+        keepAliveTimer->start(keepAliveInterval * 1000);
+}
+
+void HttpEventBroadcaster::beginStream(HttpDataPtr data)
+{
+    // Event streams are never cached and should not be buffered by proxies (X-Accel-Buffering is for nginx)
+    data->response->setHeader("Cache-Control", "no-cache");
+    data->response->setHeader("X-Accel-Buffering", "no");
+    data->response->beginChunked(HttpStatus::Ok, "text/event-stream; charset=utf-8");
+    data->response->keepChunkedOpen();
+}
+
+QByteArray HttpEventBroadcaster::serializeEvent(QByteArray data, QString event, QString id)
+{
+    QByteArray buffer;
+    buffer.reserve(data.size() + 64);
+
+    if (!id.isEmpty())
+    {
+        buffer += "id: ";
+        buffer += id.toUtf8();
+        buffer += '\n';
+    }
+
+    if (!event.isEmpty())
+    {
+        buffer += "event: ";
+        buffer += event.toUtf8();
+        buffer += '\n';
+    }
+
+    // Each line of the data must be in its own data field, client joins them back together with newlines
+    for (QByteArray line : data.split('\n'))
+    {
+        if (line.endsWith('\r'))
+            line.chop(1);
+
+        buffer += "data: ";
+        buffer += line;
+        buffer += '\n';
+    }
+
+    // Empty line signifies the end of the event
+    buffer += '\n';
+    return buffer;
+}
+
+bool HttpEventBroadcaster::send(HttpDataPtr data, QByteArray eventData, QString event, QString id)
+{
+    return data->response->appendChunk(serializeEvent(eventData, event, id));
+}
+
+void HttpEventBroadcaster::subscribe(HttpDataPtr data)
+{
+    if (!data->response->isChunked())
+        beginStream(data);
+
+    subscribers.push_back(data);
+}
+
+void HttpEventBroadcaster::broadcast(QByteArray data, QString event, QString id)
+{
+    sendToAll(serializeEvent(data, event, id));
+}
+
+void HttpEventBroadcaster::close()
+{
+    for (HttpDataPtr &data : subscribers)
+        data->response->endChunked();
+
+    subscribers.clear();
+}
+
+int HttpEventBroadcaster::subscriberCount() const
+{
+    return (int)subscribers.size();
+}
+
+void HttpEventBroadcaster::keepAlive()
+{
+    // Lines starting with a colon are comments and are ignored by the client
+    static const QByteArray comment = ":\n\n";
+    sendToAll(comment);
+}
+
+void HttpEventBroadcaster::sendToAll(const QByteArray &buffer)
+{
+    auto it = subscribers.begin();
+    while (it != subscribers.end())
+    {
+        HttpResponse *response = (*it)->response;
+
+        // Drop subscribers that can't keep up rather than buffering an unbounded amount of events for them
+        if (maxBacklog > 0 && response->queuedChunkBytes() + buffer.size() > maxBacklog)
+        {
+            response->endChunked();
+            it = subscribers.erase(it);
+            continue;
+        }
+
+        // Fails if the client disconnected, remove it from the subscribers
+        if (!response->appendChunk(buffer))
+        {
+            it = subscribers.erase(it);
+            continue;
+        }
+
+        ++it;
+    }
+}
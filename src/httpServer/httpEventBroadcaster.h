@@ -0,0 +1,53 @@
+#ifndef HTTP_SERVER_HTTP_EVENT_BROADCASTER_H
+#define HTTP_SERVER_HTTP_EVENT_BROADCASTER_H
+
+#include "const.h"
+#include "httpData.h"
+#include "httpResponse.h"
+#include "util.h"
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <vector>
+
+
+// Sends server-sent events (text/event-stream) to any number of subscribed clients
+//
+// Each event is serialized once and the same buffer is queued to every subscriber, QByteArray is implicitly shared so
+// no copy is made per client. Subscribers that fall behind by more than maxBacklog bytes are dropped, the client is
+// expected to reconnect (EventSource does this automatically) and can use the Last-Event-ID header to catch up.
+//
+// Note: Must be used from the same thread as the HTTP server
+class HTTPSERVER_EXPORT HttpEventBroadcaster : public QObject
+{
+    Q_OBJECT
+
+private:
+    std::vector<HttpDataPtr> subscribers;
+    int maxBacklog;
+    QTimer *keepAliveTimer;
+
+    void sendToAll(const QByteArray &buffer);
+
+private slots:
+    void keepAlive();
+
+public:
+    // Keep alive interval is in seconds, a comment is sent periodically so idle connections are not closed by proxies
+    // and so disconnected subscribers are cleaned up. Set to 0 to disable
+    HttpEventBroadcaster(int maxBacklog = 1024 * 1024, int keepAliveInterval = 15, QObject *parent = nullptr);
+
+    static void beginStream(HttpDataPtr data);
+    static QByteArray serializeEvent(QByteArray data, QString event = "", QString id = "");
+    static bool send(HttpDataPtr data, QByteArray eventData, QString event = "", QString id = "");
+
+    void subscribe(HttpDataPtr data);
+    void broadcast(QByteArray data, QString event = "", QString id = "");
+    void close();
+
+    int subscriberCount() const;
+};
+
+#endif // HTTP_SERVER_HTTP_EVENT_BROADCASTER_H
@@ -0,0 +1,399 @@
+#include "httpJsonWriter.h"
+
+#include <cmath>
+#include <QJsonDocument>
+#include <QLocale>
+
+HttpJsonWriter::HttpJsonWriter(HttpResponse *response, HttpStatus status, Mode mode, int flushSize) :
+    response(response), mode(mode), flushSize(flushSize), out(&buffer), baseDepth(0), needComma(false), open(true),
+    finished(false)
+{
+    switch (mode)
+    {
+        case Mode::Document:
+            response->setStatus(status);
+            response->setHeader("Content-Type", "application/json");
+            response->body_.clear();
+            out = &response->body_;
+            break;
+
+        case Mode::Array:
+            response->beginChunked(status, "application/json");
+            buffer.reserve(flushSize + 1024);
+            buffer += '[';
+            scopes.push_back(false);
+            baseDepth = 1;
+            break;
+
+        case Mode::Lines:
+            response->beginChunked(status, "application/x-ndjson");
+            buffer.reserve(flushSize + 1024);
+            break;
+    }
+}
+
+HttpJsonWriter::~HttpJsonWriter()
+{
+    finish();
+}
+
+void HttpJsonWriter::beginValue()
+{
+    // Lines are separated by a newline instead of a comma
+    if (needComma && !(mode == Mode::Lines && scopes.size() == baseDepth))
+        *out += ',';
+
+    needComma = false;
+}
+
+void HttpJsonWriter::endValue()
+{
+    needComma = true;
+
+    if (scopes.size() != baseDepth || mode == Mode::Document)
+        return;
+
+    // Top-level value is complete, a good spot to send what we have so far
+    if (mode == Mode::Lines)
+    {
+        buffer += '\n';
+        needComma = false;
+    }
+
+    if (buffer.size() >= flushSize)
+        flush();
+}
+
+void HttpJsonWriter::writeString(const QString &str)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    *out += '"';
+
+    // Encode UTF-16 straight to escaped UTF-8, avoids a temporary QByteArray from toUtf8 for every string
+    const ushort *data = str.utf16();
+    const int size = str.size();
+    for (int i = 0; i < size; ++i)
+    {
+        uint c = data[i];
+        if (c < 0x80)
+        {
+            switch (c)
+            {
+                case '"': *out += "\\\""; break;
+                case '\\': *out += "\\\\"; break;
+                case '\b': *out += "\\b"; break;
+                case '\f': *out += "\\f"; break;
+                case '\n': *out += "\\n"; break;
+                case '\r': *out += "\\r"; break;
+                case '\t': *out += "\\t"; break;
+                default:
+                    if (c < 0x20)
+                    {
+                        const char escaped[] = {'\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 0xF]};
+                        out->append(escaped, sizeof(escaped));
+                    }
+                    else
+                    {
+                        *out += (char)c;
+                    }
+                    break;
+            }
+        }
+        else if (c < 0x800)
+        {
+            *out += (char)(0xC0 | (c >> 6));
+            *out += (char)(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            // Combine surrogate pairs, unpaired surrogates are replaced with U+FFFD
+            if (QChar::isHighSurrogate(c) && i + 1 < size && QChar::isLowSurrogate(data[i + 1]))
+                c = QChar::surrogateToUcs4(c, data[++i]);
+            else if (QChar::isSurrogate(c))
+                c = 0xFFFD;
+
+            if (c < 0x10000)
+            {
+                *out += (char)(0xE0 | (c >> 12));
+            }
+            else
+            {
+                *out += (char)(0xF0 | (c >> 18));
+                *out += (char)(0x80 | ((c >> 12) & 0x3F));
+            }
+
+            *out += (char)(0x80 | ((c >> 6) & 0x3F));
+            *out += (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    *out += '"';
+}
+
+bool HttpJsonWriter::isPlain(const char *data, int size)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        const uchar c = (uchar)data[i];
+        if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\')
+            return false;
+    }
+
+    return true;
+}
+
+void HttpJsonWriter::writeString(QLatin1String str)
+{
+    // Strings without characters that need escaping or encoding are copied as-is
+    if (!isPlain(str.data(), str.size()))
+        return writeString(QString(str));
+
+    *out += '"';
+    out->append(str.data(), str.size());
+    *out += '"';
+}
+
+void HttpJsonWriter::writeUtf8(const char *str)
+{
+    const int size = (int)qstrlen(str);
+    if (!isPlain(str, size))
+        return writeString(QString::fromUtf8(str, size));
+
+    *out += '"';
+    out->append(str, size);
+    *out += '"';
+}
+
+HttpJsonWriter &HttpJsonWriter::beginObject()
+{
+    beginValue();
+    *out += '{';
+    scopes.push_back(true);
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::endObject()
+{
+    Q_ASSERT(!scopes.empty() && scopes.back());
+
+    *out += '}';
+    scopes.pop_back();
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::beginArray()
+{
+    beginValue();
+    *out += '[';
+    scopes.push_back(false);
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::endArray()
+{
+    Q_ASSERT(scopes.size() > baseDepth && !scopes.back());
+
+    *out += ']';
+    scopes.pop_back();
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::key(QLatin1String name)
+{
+    Q_ASSERT(!scopes.empty() && scopes.back());
+
+    beginValue();
+    writeString(name);
+    *out += ':';
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::key(const QString &name)
+{
+    Q_ASSERT(!scopes.empty() && scopes.back());
+
+    beginValue();
+    writeString(name);
+    *out += ':';
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::key(const char *name)
+{
+    Q_ASSERT(!scopes.empty() && scopes.back());
+
+    beginValue();
+    writeUtf8(name);
+    *out += ':';
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::value(std::nullptr_t)
+{
+    beginValue();
+    *out += "null";
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::value(bool value)
+{
+    beginValue();
+    *out += value ? "true" : "false";
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::value(int value)
+{
+    beginValue();
+    *out += QByteArray::number(value);
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::value(unsigned int value)
+{
+    return rawValue(QByteArray::number(value));
+}
+
+HttpJsonWriter &HttpJsonWriter::value(long value)
+{
+    return rawValue(QByteArray::number((qint64)value));
+}
+
+HttpJsonWriter &HttpJsonWriter::value(unsigned long value)
+{
+    return rawValue(QByteArray::number((quint64)value));
+}
+
+HttpJsonWriter &HttpJsonWriter::value(qint64 value)
+{
+    beginValue();
+    *out += QByteArray::number(value);
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::value(quint64 value)
+{
+    return rawValue(QByteArray::number(value));
+}
+
+HttpJsonWriter &HttpJsonWriter::value(float value)
+{
+    if (!std::isfinite(value))
+        return rawValue("null");
+
+    // Shortest representation that reads back as the same float, writing it as a double would include the rounding
+    // error of the float (e.g. 0.1f as 0.10000000149011612)
+    QByteArray number;
+    for (int precision = 1; precision <= 9; ++precision)
+    {
+        number = QByteArray::number(value, 'g', precision);
+        if (number.toFloat() == value)
+            break;
+    }
+
+    return rawValue(number);
+}
+
+HttpJsonWriter &HttpJsonWriter::value(double value)
+{
+    beginValue();
+
+    // JSON has no representation for NaN or infinity, QJsonDocument writes null as well
+    if (std::isfinite(value))
+        *out += QByteArray::number(value, 'g', QLocale::FloatingPointShortest);
+    else
+        *out += "null";
+
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::value(QLatin1String value)
+{
+    beginValue();
+    writeString(value);
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::value(const QString &value)
+{
+    beginValue();
+    writeString(value);
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::value(const char *value)
+{
+    beginValue();
+    writeUtf8(value);
+    endValue();
+    return *this;
+}
+
+HttpJsonWriter &HttpJsonWriter::value(const QJsonObject &value)
+{
+    return rawValue(QJsonDocument(value).toJson(QJsonDocument::Compact));
+}
+
+HttpJsonWriter &HttpJsonWriter::value(const QJsonArray &value)
+{
+    return rawValue(QJsonDocument(value).toJson(QJsonDocument::Compact));
+}
+
+HttpJsonWriter &HttpJsonWriter::rawValue(const QByteArray &json)
+{
+    beginValue();
+    *out += json;
+    endValue();
+    return *this;
+}
+
+bool HttpJsonWriter::flush()
+{
+    if (mode == Mode::Document || buffer.isEmpty())
+        return open;
+
+    // Discard the output once the client is gone, the caller can check isOpen to stop early
+    if (open)
+        open = response->appendChunk(buffer);
+
+    // Chunk shares the buffer data, so start a new buffer instead of clearing it
+    buffer = QByteArray();
+    buffer.reserve(flushSize + 1024);
+    return open;
+}
+
+void HttpJsonWriter::finish()
+{
+    if (finished)
+        return;
+
+    finished = true;
+
+    // Close anything left open, the outer array of Array mode is closed here as well
+    while (scopes.size() > 0)
+    {
+        *out += scopes.back() ? '}' : ']';
+        scopes.pop_back();
+    }
+
+    if (mode == Mode::Document)
+        return;
+
+    flush();
+    response->endChunked();
+}
+
+bool HttpJsonWriter::isOpen() const
+{
+    return open;
+}
@@ -0,0 +1,116 @@
+#ifndef HTTP_SERVER_HTTP_JSON_WRITER_H
+#define HTTP_SERVER_HTTP_JSON_WRITER_H
+
+#include "httpResponse.h"
+#include "util.h"
+
+#include <cstddef>
+#include <QByteArray>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLatin1String>
+#include <QString>
+#include <vector>
+
+
+// Writes JSON tokens straight into the body of a response without building a QJsonDocument first
+//
+// Document mode writes a single JSON value into the response body. Array and Lines modes send a chunked response, each
+// top-level value is an element of a JSON array or a line of newline-delimited JSON (NDJSON). The output is flushed as
+// a chunk every time a top-level value is completed and at least flushSize bytes are buffered. The response is
+// finished when finish is called or the writer is destroyed.
+//
+// Example:
+//     HttpJsonWriter json(data->response, HttpStatus::Ok, HttpJsonWriter::Mode::Lines);
+//     for (const User &user : users)
+//         json.beginObject().field("id", user.id).field("name", user.name).endObject();
+//     json.finish();
+class HTTPSERVER_EXPORT HttpJsonWriter
+{
+public:
+    enum class Mode
+    {
+        Document,
+        Array,
+        Lines
+    };
+
+private:
+    HttpResponse *response;
+    Mode mode;
+    int flushSize;
+
+    // Document mode writes directly into the response body, other modes buffer the next chunk
+    QByteArray buffer;
+    QByteArray *out;
+
+    // Open objects & arrays, true for objects
+    std::vector<bool> scopes;
+    // Depth of the top-level values, the outer array of Array mode is not counted as a value
+    size_t baseDepth;
+    bool needComma;
+    bool open;
+    bool finished;
+
+    void beginValue();
+    void endValue();
+    void writeString(const QString &str);
+    void writeString(QLatin1String str);
+    void writeUtf8(const char *str);
+    static bool isPlain(const char *data, int size);
+
+public:
+    HttpJsonWriter(HttpResponse *response, HttpStatus status = HttpStatus::Ok, Mode mode = Mode::Document,
+        int flushSize = 16 * 1024);
+    ~HttpJsonWriter();
+
+    HttpJsonWriter(const HttpJsonWriter &) = delete;
+    HttpJsonWriter &operator=(const HttpJsonWriter &) = delete;
+
+    HttpJsonWriter &beginObject();
+    HttpJsonWriter &endObject();
+    HttpJsonWriter &beginArray();
+    HttpJsonWriter &endArray();
+
+    HttpJsonWriter &key(QLatin1String name);
+    HttpJsonWriter &key(const QString &name);
+    // Note: C strings are expected to be UTF-8
+    HttpJsonWriter &key(const char *name);
+
+    HttpJsonWriter &value(std::nullptr_t);
+    HttpJsonWriter &value(bool value);
+    // Note: There is an overload for each integer type so none of them are ambiguous, e.g. quint64 & size_t IDs
+    HttpJsonWriter &value(int value);
+    HttpJsonWriter &value(unsigned int value);
+    HttpJsonWriter &value(long value);
+    HttpJsonWriter &value(unsigned long value);
+    HttpJsonWriter &value(qint64 value);
+    HttpJsonWriter &value(quint64 value);
+    HttpJsonWriter &value(float value);
+    HttpJsonWriter &value(double value);
+    HttpJsonWriter &value(QLatin1String value);
+    HttpJsonWriter &value(const QString &value);
+    HttpJsonWriter &value(const char *value);
+    HttpJsonWriter &value(const QJsonObject &value);
+    HttpJsonWriter &value(const QJsonArray &value);
+
+    // Writes already serialized JSON as-is
+    HttpJsonWriter &rawValue(const QByteArray &json);
+
+    template<typename T>
+    HttpJsonWriter &field(const char *name, const T &value)
+    {
+        key(name);
+        return this->value(value);
+    }
+
+    // Sends the buffered output as a chunk, returns false if the client is gone
+    // Note: Does nothing in Document mode
+    bool flush();
+    void finish();
+
+    // False once the client has disconnected, further output is discarded
+    bool isOpen() const;
+};
+
+#endif // HTTP_SERVER_HTTP_JSON_WRITER_H
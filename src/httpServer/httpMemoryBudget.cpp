@@ -0,0 +1,30 @@
+#include "httpMemoryBudget.h"
+
+HttpMemoryBudget::HttpMemoryBudget(qint64 limit, QObject *parent) : QObject(parent), limit_(limit), usage_(0)
+{
+}
+
+void HttpMemoryBudget::add(qint64 bytes)
+{
+    if (bytes == 0)
+        return;
+
+    const qint64 usage = usage_ += bytes;
+    if (bytes < 0 && usage < limit_ && usage - bytes >= limit_)
+        emit available();
+}
+
+bool HttpMemoryBudget::isExceeded() const
+{
+    return usage_ >= limit_;
+}
+
+qint64 HttpMemoryBudget::limit() const
+{
+    return limit_;
+}
+
+qint64 HttpMemoryBudget::usage() const
+{
+    return usage_;
+}
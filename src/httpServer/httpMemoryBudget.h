@@ -0,0 +1,38 @@
+#ifndef HTTP_SERVER_HTTP_MEMORY_BUDGET_H
+#define HTTP_SERVER_HTTP_MEMORY_BUDGET_H
+
+#include "util.h"
+
+#include <atomic>
+#include <QObject>
+
+
+// Server-wide accounting of the bytes buffered by connections
+//
+// Each connection reports the change in the bytes it holds for request bodies, multipart data, socket buffers and
+// queued responses. While the total is over the limit, connections stop reading request bodies and answer new requests
+// with 503 Service Unavailable, so a burst of large requests is shed instead of running the process out of memory.
+class HTTPSERVER_EXPORT HttpMemoryBudget : public QObject
+{
+    Q_OBJECT
+
+private:
+    qint64 limit_;
+    std::atomic<qint64> usage_;
+
+public:
+    HttpMemoryBudget(qint64 limit, QObject *parent = nullptr);
+
+    // Positive to account for more bytes, negative once they are freed
+    void add(qint64 bytes);
+
+    bool isExceeded() const;
+    qint64 limit() const;
+    qint64 usage() const;
+
+signals:
+    // Emitted when the usage drops back under the limit
+    void available();
+};
+
+#endif // HTTP_SERVER_HTTP_MEMORY_BUDGET_H
@@ -0,0 +1,176 @@
+#include "httpMimeType.h"
+
+#include <cctype>
+#include <cstring>
+#include <QMimeDatabase>
+#include <QMutex>
+#include <unordered_map>
+
+namespace
+{
+    // Number of bytes looked at when sniffing data, matches what QMimeDatabase reads from a device
+    const int sniffSize = 512;
+
+    const std::unordered_map<QString, QString> extensionMimeTypes {
+        {"html", "text/html"},
+        {"htm", "text/html"},
+        {"css", "text/css"},
+        {"js", "application/javascript"},
+        {"mjs", "application/javascript"},
+        {"json", "application/json"},
+        {"map", "application/json"},
+        {"xml", "application/xml"},
+        {"txt", "text/plain"},
+        {"csv", "text/csv"},
+        {"md", "text/markdown"},
+        {"wasm", "application/wasm"},
+        {"pdf", "application/pdf"},
+        {"zip", "application/zip"},
+        {"gz", "application/gzip"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"webp", "image/webp"},
+        {"avif", "image/avif"},
+        {"svg", "image/svg+xml"},
+        {"ico", "image/vnd.microsoft.icon"},
+        {"woff", "font/woff"},
+        {"woff2", "font/woff2"},
+        {"ttf", "font/ttf"},
+        {"otf", "font/otf"},
+        {"mp3", "audio/mpeg"},
+        {"ogg", "audio/ogg"},
+        {"wav", "audio/x-wav"},
+        {"mp4", "video/mp4"},
+        {"webm", "video/webm"}
+    };
+
+    struct Magic
+    {
+        const char *bytes;
+        int size;
+        const char *mimeType;
+    };
+
+    const Magic magics[] {
+        {"\x89PNG\r\n\x1a\n", 8, "image/png"},
+        {"\xFF\xD8\xFF", 3, "image/jpeg"},
+        {"GIF87a", 6, "image/gif"},
+        {"GIF89a", 6, "image/gif"},
+        {"%PDF-", 5, "application/pdf"},
+        {"\x1F\x8B", 2, "application/gzip"},
+        {"PK\x03\x04", 4, "application/zip"},
+        {"wOFF", 4, "font/woff"},
+        {"wOF2", 4, "font/woff2"},
+        {"\0asm", 4, "application/wasm"}
+    };
+
+    QMutex fallbackMutex;
+    std::unordered_map<QString, QString> fallbackMimeTypes;
+
+    QMimeDatabase &mimeDatabase()
+    {
+        static QMimeDatabase database;
+        return database;
+    }
+
+    bool startsWith(const char *data, int size, const char *prefix, int prefixSize, bool caseSensitive = true)
+    {
+        if (size < prefixSize)
+            return false;
+
+        return caseSensitive ? memcmp(data, prefix, prefixSize) == 0 : qstrnicmp(data, prefix, prefixSize) == 0;
+    }
+
+    // Checks for control characters that do not appear in text, same heuristic QMimeDatabase uses for text/plain
+    bool isText(const char *data, int size)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            const uchar c = (uchar)data[i];
+            if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != 0x1B)
+                return false;
+        }
+
+        return true;
+    }
+}
+
+QString mimeTypeForFilename(const QString &filename)
+{
+    // Extension is everything after the last dot of the file name, files without one are looked up by name
+    const int slash = filename.lastIndexOf('/');
+    const int dot = filename.lastIndexOf('.');
+    const QString key = (dot > slash ? filename.mid(dot + 1) : filename.mid(slash + 1)).toLower();
+
+    auto it = extensionMimeTypes.find(key);
+    if (it != extensionMimeTypes.end())
+        return it->second;
+
+    QMutexLocker locker(&fallbackMutex);
+
+    auto fallbackIt = fallbackMimeTypes.find(key);
+    if (fallbackIt != fallbackMimeTypes.end())
+        return fallbackIt->second;
+
+    const QString mimeType = mimeDatabase().mimeTypeForFile(filename, QMimeDatabase::MatchExtension).name();
+    fallbackMimeTypes.emplace(key, mimeType);
+    return mimeType;
+}
+
+QString mimeTypeForData(const char *data, int size)
+{
+    if (size == 0)
+        return "application/x-zerosize";
+
+    size = std::min(size, sniffSize);
+
+    for (const Magic &magic : magics)
+    {
+        if (startsWith(data, size, magic.bytes, magic.size))
+            return magic.mimeType;
+    }
+
+    if (size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WEBP", 4) == 0)
+        return "image/webp";
+
+    if (isText(data, size))
+    {
+        // Skip UTF-8 BOM & leading whitespace to find markup
+        int index = startsWith(data, size, "\xEF\xBB\xBF", 3) ? 3 : 0;
+        while (index < size && isspace((uchar)data[index]))
+            ++index;
+
+        const char *text = data + index;
+        const int textSize = size - index;
+        if (startsWith(text, textSize, "<!doctype html", 14, false) || startsWith(text, textSize, "<html", 5, false))
+            return "text/html";
+
+        if (startsWith(text, textSize, "<svg", 4) ||
+            (startsWith(text, textSize, "<?xml", 5) && QByteArray::fromRawData(text, textSize).contains("<svg")))
+            return "image/svg+xml";
+
+        if (startsWith(text, textSize, "<?xml", 5))
+            return "application/xml";
+
+        return "text/plain";
+    }
+
+    // Rare binary formats, not worth memoizing since the data differs every time
+    return mimeDatabase().mimeTypeForData(QByteArray::fromRawData(data, size)).name();
+}
+
+QString mimeTypeForData(const QByteArray &data)
+{
+    return mimeTypeForData(data.constData(), data.size());
+}
+
+QString mimeTypeForData(QIODevice *device)
+{
+    if (!device->isReadable())
+        return "application/octet-stream";
+
+    const QByteArray data = device->peek(sniffSize);
+    return mimeTypeForData(data.constData(), data.size());
+}
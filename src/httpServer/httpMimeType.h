@@ -0,0 +1,27 @@
+#ifndef HTTP_SERVER_HTTP_MIME_TYPE_H
+#define HTTP_SERVER_HTTP_MIME_TYPE_H
+
+#include "util.h"
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+
+
+// Content type detection for responses without an explicit type
+//
+// Common extensions are looked up in a precomputed table and common formats are recognized by their magic number.
+// Anything else falls back to QMimeDatabase, results for extensions are memoized so each extension is only looked up
+// once.
+
+// Determines the MIME type from the extension of the filename
+HTTPSERVER_EXPORT QString mimeTypeForFilename(const QString &filename);
+
+// Determines the MIME type from the first few bytes of the data
+HTTPSERVER_EXPORT QString mimeTypeForData(const char *data, int size);
+HTTPSERVER_EXPORT QString mimeTypeForData(const QByteArray &data);
+
+// Peeks at the start of the device without consuming any data
+HTTPSERVER_EXPORT QString mimeTypeForData(QIODevice *device);
+
+#endif // HTTP_SERVER_HTTP_MIME_TYPE_H
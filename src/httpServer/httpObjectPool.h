@@ -0,0 +1,57 @@
+#ifndef HTTP_SERVER_HTTP_OBJECT_POOL_H
+#define HTTP_SERVER_HTTP_OBJECT_POOL_H
+
+#include <vector>
+
+
+// Per-thread free list of objects that are reset & reused instead of deleted
+//
+// Objects released on a thread are only handed out again on that thread, so taking and returning objects needs no
+// locking. Objects still in the pool are deleted when the thread exits.
+template <typename T>
+class HttpObjectPool
+{
+private:
+    struct FreeList
+    {
+        std::vector<T *> objects;
+
+        ~FreeList()
+        {
+            for (T *object : objects)
+                delete object;
+        }
+    };
+
+    static FreeList &freeList()
+    {
+        static thread_local FreeList list;
+        return list;
+    }
+
+public:
+    // Returns nullptr if the pool is empty
+    static T *take()
+    {
+        std::vector<T *> &objects = freeList().objects;
+        if (objects.empty())
+            return nullptr;
+
+        T *object = objects.back();
+        objects.pop_back();
+        return object;
+    }
+
+    // Returns false if the pool already holds maxSize objects, the caller deletes the object in that case
+    static bool put(T *object, int maxSize)
+    {
+        std::vector<T *> &objects = freeList().objects;
+        if ((int)objects.size() >= maxSize)
+            return false;
+
+        objects.push_back(object);
+        return true;
+    }
+};
+
+#endif // HTTP_SERVER_HTTP_OBJECT_POOL_H
@@ -1,8 +1,13 @@
 #include "httpRequest.h"
-
-HttpRequest::HttpRequest(HttpServerConfig *config) : config(config), buffer(), requestBytesSize(0),
-    state_(State::ReadRequestLine), method_(), uri_(), version_(), expectedBodySize(0), body_(), mimeType_(),
-    charset_(), boundary(), tmpFormData(nullptr)
+#include "httpObjectPool.h"
+
+HttpRequest::HttpRequest(HttpServerConfig *config, std::shared_ptr<HttpArena> arena) : config(config),
+    poolSize(config->objectPoolSize), arena(arena),
+    buffer(), requestBytesSize(0), state_(State::ReadRequestLine), method_(), methodFlag(HttpMethod::None), uri_(),
+    version_(), headers(0, QStringCaseInsensitiveHash(), QStringCaseInSensitiveEqual(), arena.get()),
+    cookies(0, std::hash<QString>(), std::equal_to<QString>(), arena.get()), expectedBodySize(0), body_(), mimeType_(),
+    charset_(), boundary(), tmpFormData(nullptr),
+    formFields_(0, std::hash<QString>(), std::equal_to<QString>(), arena.get())
 {
 }
 
@@ -54,6 +59,16 @@ bool HttpRequest::parseRequest(QTcpSocket *socket, HttpResponse *response)
     }
 }
 
+void HttpRequest::abort()
+{
+    state_ = State::Abort;
+}
+
+int HttpRequest::bufferedBytes() const
+{
+    return buffer.size() + body_.size();
+}
+
 bool HttpRequest::parseRequestLine(QTcpSocket *socket, HttpResponse *response)
 {
     // Return false if no more data is available
@@ -114,6 +129,7 @@ bool HttpRequest::parseRequestLine(QTcpSocket *socket, HttpResponse *response)
     //
     // In the future, a configuration setting could be added to allow customization of the heading character set
     method_ = QString::fromLatin1(parts[0]);
+    methodFlag = parseHttpMethod(parts[0]);
     uri_ = QUrl(parts[1]);
     uriQuery_ = QUrlQuery(uri_);
     version_ = QString::fromLatin1(parts[2]);
@@ -121,7 +137,7 @@ bool HttpRequest::parseRequestLine(QTcpSocket *socket, HttpResponse *response)
     state_ = State::ReadHeader;
 
     // Make sure the method specified is allowed
-    if (std::find(allowedMethods.begin(), allowedMethods.end(), method_) == allowedMethods.end())
+    if (methodFlag == HttpMethod::None)
     {
         if (config->verbosity >= HttpServerConfig::Verbose::Info)
             qInfo().noquote() << QString("Invalid method received from %1: %2").arg(address_.toString()).arg(method_);
@@ -595,6 +611,11 @@ QString HttpRequest::method() const
     return method_;
 }
 
+HttpMethod HttpRequest::httpMethod() const
+{
+    return methodFlag;
+}
+
 QUrl HttpRequest::uri() const
 {
     return uri_;
@@ -652,7 +673,7 @@ void HttpRequest::setCharset(QString charset)
 
 std::unordered_map<QString, QString> HttpRequest::formFields() const
 {
-    return formFields_;
+    return std::unordered_map<QString, QString>(formFields_.begin(), formFields_.end());
 }
 
 std::unordered_map<QString, FormFile> HttpRequest::formFiles() const
@@ -963,6 +984,11 @@ bool HttpRequest::header(QString key, QUrl *value) const
 }
 
 HttpRequest::~HttpRequest()
+{
+    deleteFormData();
+}
+
+void HttpRequest::deleteFormData()
 {
     // Delete each temporary file (will automatically close it)
     for (auto kv : formFiles_)
@@ -976,3 +1002,53 @@ HttpRequest::~HttpRequest()
         tmpFormData = nullptr;
     }
 }
+
+void HttpRequest::reset(HttpServerConfig *config, std::shared_ptr<HttpArena> arena)
+{
+    deleteFormData();
+
+    this->config = config;
+    buffer.clear();
+    requestBytesSize = 0;
+    state_ = State::ReadRequestLine;
+    address_.clear();
+    method_.clear();
+    methodFlag = HttpMethod::None;
+    uri_.clear();
+    uriQuery_.clear();
+    version_.clear();
+    expectedBodySize = 0;
+    body_.clear();
+    mimeType_.clear();
+    charset_.clear();
+    boundary.clear();
+
+    // Maps are switched to the new arena before the reference to the old one is dropped
+    resetArenaMap(headers, arena.get());
+    resetArenaMap(cookies, arena.get());
+    resetArenaMap(formFields_, arena.get());
+    this->arena = arena;
+}
+
+HttpRequest *HttpRequest::create(HttpServerConfig *config, std::shared_ptr<HttpArena> arena)
+{
+    HttpRequest *request = HttpObjectPool<HttpRequest>::take();
+    if (!request)
+        return new HttpRequest(config, arena);
+
+    request->reset(config, arena);
+    request->poolSize = config->objectPoolSize;
+    return request;
+}
+
+void HttpRequest::release(HttpRequest *request)
+{
+    if (!request)
+        return;
+
+    // Reset right away so the request does not keep its arena or temporary files alive while in the pool
+    // Note: The config is not used here, the server it belongs to may already be gone
+    request->reset(nullptr, nullptr);
+    if (!HttpObjectPool<HttpRequest>::put(request, request->poolSize))
+        delete request;
+}
@@ -1,6 +1,7 @@
 #ifndef HTTP_SERVER_HTTP_REQUEST_H
 #define HTTP_SERVER_HTTP_REQUEST_H
 
+#include "httpArena.h"
 #include "httpCookie.h"
 #include "httpResponse.h"
 #include "httpServerConfig.h"
@@ -21,6 +22,7 @@
 #include <QUuid>
 #include <QUrl>
 #include <QUrlQuery>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -55,9 +57,11 @@ public:
     };
 
 private:
-    const std::vector<QString> allowedMethods = {"GET", "HEAD", "POST", "PUT", "DELETE", "OPTIONS"};
-
     HttpServerConfig *config;
+    // Maximum size of the pool the request is returned to, copied from the config since requests can outlive the server
+    int poolSize;
+    // Note: Declared before the maps allocated from it so it is destroyed after them
+    std::shared_ptr<HttpArena> arena;
 
     QByteArray buffer;
     int requestBytesSize;
@@ -65,13 +69,14 @@ private:
     State state_;
     QHostAddress address_;
     QString method_;
+    HttpMethod methodFlag;
     QUrl uri_;
     QUrlQuery uriQuery_;
     QString version_;
 
-    std::unordered_map<QString, QString, QStringCaseInsensitiveHash, QStringCaseInSensitiveEqual> headers;
+    HttpArenaMap<QString, QString, QStringCaseInsensitiveHash, QStringCaseInSensitiveEqual> headers;
     // Note: Cookies ARE case sensitive, headers are not
-    std::unordered_map<QString, QString> cookies;
+    HttpArenaMap<QString, QString> cookies;
 
     int expectedBodySize;
     QByteArray body_;
@@ -82,7 +87,7 @@ private:
 
     TemporaryFormData *tmpFormData;
 
-    std::unordered_map<QString, QString> formFields_;
+    HttpArenaMap<QString, QString> formFields_;
     std::unordered_map<QString, FormFile> formFiles_;
 
     bool parseRequestLine(QTcpSocket *socket, HttpResponse *response);
@@ -93,11 +98,25 @@ private:
     void parseContentType();
     void parsePostFormBody();
 
+    void deleteFormData();
+    void reset(HttpServerConfig *config, std::shared_ptr<HttpArena> arena);
+
 public:
-    HttpRequest(HttpServerConfig *config);
+    // Maps are allocated from the arena if one is given, the heap otherwise
+    HttpRequest(HttpServerConfig *config, std::shared_ptr<HttpArena> arena = nullptr);
     ~HttpRequest();
 
+    // Takes a request from the pool of the current thread, a new one is allocated if the pool is empty
+    static HttpRequest *create(HttpServerConfig *config, std::shared_ptr<HttpArena> arena = nullptr);
+    // Resets the request and returns it to the pool of the current thread, deletes it if the pool is full
+    static void release(HttpRequest *request);
+
     bool parseRequest(QTcpSocket *socket, HttpResponse *response);
+    // Stops parsing the request, the data left in the socket is discarded on the next call to parseRequest
+    void abort();
+
+    // Bytes of the request held in memory, i.e. the parse buffer & body
+    int bufferedBytes() const;
 
     QString parseBodyStr() const;
     QJsonDocument parseJsonBody() const;
@@ -105,6 +124,7 @@ public:
     State state() const;
     QHostAddress address() const;
     QString method() const;
+    HttpMethod httpMethod() const;
     QUrl uri() const;
     QString uriStr() const;
     QUrlQuery uriQuery() const;
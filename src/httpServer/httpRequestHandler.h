@@ -7,6 +7,7 @@
 #include "httpData.h"
 #include "httpRequest.h"
 #include "httpResponse.h"
+#include "httpResult.h"
 
 
 class HTTPSERVER_EXPORT HttpRequestHandler : public QObject
@@ -17,6 +18,15 @@ public:
     HttpRequestHandler(QObject *parent = nullptr) : QObject(parent) {}
 
     virtual HttpPromise handle(HttpDataPtr data) = 0;
+
+    // Called by the connection for each request, defaults to handle
+    // Override this as well to return data that is ready right away, the response is then sent without allocating any
+    // promises. handle can then forward to it:
+    //     HttpPromise handle(HttpDataPtr data) override { return dispatch(data).toPromise(); }
+    virtual HttpResult dispatch(HttpDataPtr data)
+    {
+        return handle(data);
+    }
 };
 
 #endif // HTTP_SERVER_HTTP_REQUEST_HANDLER_H
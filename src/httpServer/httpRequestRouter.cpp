@@ -1,40 +1,499 @@
 #include "httpRequestRouter.h"
 
+HttpRequestRouter::HttpRequestRouter() : storeMatchInState(false)
+{
+}
+
+void HttpRequestRouter::setStoreMatchInState(bool enabled)
+{
+    storeMatchInState = enabled;
+}
+
 void HttpRequestRouter::addRoute(QString method, QString regex, HttpFunc handler)
 {
-    HttpRequestRoute route = {{method}, QRegularExpression(regex), handler};
-    route.pathRegex.optimize();
-    routes.push_back(route);
+    addRoute(toMethods({method}), regex, handler);
 }
 
 void HttpRequestRouter::addRoute(std::vector<QString> methods, QString regex, HttpFunc handler)
+{
+    addRoute(toMethods(methods), regex, handler);
+}
+
+void HttpRequestRouter::addRoute(HttpMethods methods, QString regex, HttpFunc handler)
 {
     HttpRequestRoute route = {methods, QRegularExpression(regex), handler};
     route.pathRegex.optimize();
     routes.push_back(route);
+    indexRoute(regex);
+}
+
+void HttpRequestRouter::addRoute(HttpMethods methods, QString regex, std::vector<HttpFunc> middleware,
+    HttpFunc handler)
+{
+    addRoute(methods, regex, chain(std::move(middleware), handler));
+}
+
+void HttpRequestRouter::addRoute(QString method, QString regex, std::vector<HttpFunc> middleware, HttpFunc handler)
+{
+    addRoute(toMethods({method}), regex, chain(std::move(middleware), handler));
+}
+
+void HttpRequestRouter::addRoute(std::vector<QString> methods, QString regex, std::vector<HttpFunc> middleware,
+    HttpFunc handler)
+{
+    addRoute(toMethods(methods), regex, chain(std::move(middleware), handler));
+}
+
+void HttpRequestRouter::addPath(HttpMethods methods, QString pattern, std::vector<HttpFunc> middleware,
+    HttpFunc handler)
+{
+    addPath(methods, pattern, chain(std::move(middleware), handler));
+}
+
+void HttpRequestRouter::addPath(QString method, QString pattern, std::vector<HttpFunc> middleware, HttpFunc handler)
+{
+    addPath(toMethods({method}), pattern, chain(std::move(middleware), handler));
+}
+
+void HttpRequestRouter::addPath(std::vector<QString> methods, QString pattern, std::vector<HttpFunc> middleware,
+    HttpFunc handler)
+{
+    addPath(toMethods(methods), pattern, chain(std::move(middleware), handler));
+}
+
+HttpFunc HttpRequestRouter::chain(std::vector<HttpFunc> middleware, HttpFunc handler)
+{
+    // Built from the handler backwards so each step holds the rest of the chain
+    HttpFunc next = handler;
+    for (auto it = middleware.rbegin(); it != middleware.rend(); ++it)
+    {
+        HttpFunc current = *it;
+        next = [current, next](HttpDataPtr data) -> HttpResult {
+            HttpResult result = current(data);
+            if (result.isReady())
+            {
+                if (data->response->isValid())
+                    return data;
+
+                return next(data);
+            }
+
+            return result.toPromise().then([next](HttpDataPtr data) -> HttpPromise {
+                if (data->response->isValid())
+                    return HttpPromise::resolve(data);
+
+                return next(data).toPromise();
+            });
+        };
+    }
+
+    return next;
+}
+
+QString HttpRequestRouter::literalPrefix(const QString &regex)
+{
+    // Only patterns anchored at the start have a prefix every match must begin with
+    if (!regex.startsWith('^'))
+        return QString();
+
+    // Top-level alternation means the anchor only applies to the first alternative, be conservative and skip any
+    // pattern with an alternation
+    for (int i = 0; i < regex.size(); ++i)
+    {
+        if (regex[i] == '\\')
+            ++i;
+        else if (regex[i] == '|')
+            return QString();
+    }
+
+    static const QString special = "\\.^$|?*+()[]{}";
+    static const QString quantifiers = "?*{";
+
+    QString prefix;
+    int i = 1;
+    while (i < regex.size())
+    {
+        QChar c = regex[i];
+        int next = i + 1;
+
+        // Escaped punctuation is literal, escaped letters & digits are classes (e.g. \w) or backreferences
+        if (c == '\\')
+        {
+            if (next >= regex.size() || regex[next].isLetterOrNumber())
+                break;
+
+            c = regex[next++];
+        }
+        else if (special.contains(c))
+        {
+            break;
+        }
+
+        // Character followed by a quantifier that allows zero occurrences is not required
+        if (next < regex.size() && quantifiers.contains(regex[next]))
+            break;
+
+        prefix += c;
+        i = next;
+    }
+
+    return prefix;
+}
+
+void HttpRequestRouter::indexRoute(const QString &regex)
+{
+    PrefixNode *node = &prefixRoot;
+    for (const QChar c : literalPrefix(regex))
+    {
+        std::unique_ptr<PrefixNode> &child = node->children[c.unicode()];
+        if (!child)
+            child.reset(new PrefixNode());
+
+        node = child.get();
+    }
+
+    node->routes.push_back(routes.size() - 1);
+}
+
+void HttpRequestRouter::addPath(QString method, QString pattern, HttpFunc handler)
+{
+    addPath(toMethods({method}), pattern, handler);
+}
+
+void HttpRequestRouter::addPath(std::vector<QString> methods, QString pattern, HttpFunc handler)
+{
+    addPath(toMethods(methods), pattern, handler);
+}
+
+void HttpRequestRouter::addPath(HttpMethods methods, QString pattern, HttpFunc handler)
+{
+    PathNode *node = &pathRoot;
+    QString literal;
+
+    int i = 0;
+    while (i < pattern.size())
+    {
+        // Parameters & wildcards must take up an entire segment, elsewhere : and * are just text
+        const bool segmentStart = i == 0 || pattern[i - 1] == '/';
+        if (segmentStart && pattern[i] == ':')
+        {
+            node = insertStatic(node, literal);
+            literal.clear();
+
+            int end = pattern.indexOf('/', i);
+            if (end == -1)
+                end = pattern.size();
+
+            // Optional type follows the name in angle brackets, e.g. :id<int>
+            QString name = pattern.mid(i + 1, end - i - 1);
+            HttpPathParamType type = HttpPathParamType::String;
+            const int typeStart = name.indexOf('<');
+            if (typeStart != -1 && name.endsWith('>'))
+            {
+                const QString typeName = name.mid(typeStart + 1, name.size() - typeStart - 2);
+                if (typeName == "int")
+                    type = HttpPathParamType::Int;
+                else
+                    qWarning().noquote() << QString("Unknown path parameter type '%1' in %2, matching as a string")
+                        .arg(typeName).arg(pattern);
+
+                name = name.left(typeStart);
+            }
+
+            // Reuse the node for the same parameter so its routes share the same subtree
+            auto it = std::find_if(node->paramChildren.begin(), node->paramChildren.end(),
+                [&](const std::unique_ptr<PathNode> &child) {
+                    return child->paramName == name && child->paramType == type;
+                });
+            if (it == node->paramChildren.end())
+            {
+                std::unique_ptr<PathNode> child(new PathNode());
+                child->paramName = name;
+                child->paramType = type;
+
+                // String parameters match anything, keep them after the typed ones so those get a chance first
+                auto position = type == HttpPathParamType::String ? node->paramChildren.end() :
+                    std::find_if(node->paramChildren.begin(), node->paramChildren.end(),
+                        [](const std::unique_ptr<PathNode> &child) {
+                            return child->paramType == HttpPathParamType::String;
+                        });
+                it = node->paramChildren.insert(position, std::move(child));
+            }
+
+            node = it->get();
+            i = end;
+        }
+        else if (segmentStart && pattern[i] == '*')
+        {
+            node = insertStatic(node, literal);
+            literal.clear();
+
+            // Wildcard matches the rest of the path, anything after it in the pattern is part of the name
+            if (!node->wildcardChild)
+            {
+                node->wildcardChild.reset(new PathNode());
+                node->wildcardChild->paramName = pattern.mid(i + 1);
+            }
+
+            node = node->wildcardChild.get();
+            i = pattern.size();
+        }
+        else
+        {
+            literal += pattern[i++];
+        }
+    }
+
+    node = insertStatic(node, literal);
+    node->routes.push_back({methods, handler});
+}
+
+HttpRequestRouter::PathNode *HttpRequestRouter::insertStatic(PathNode *node, QString text)
+{
+    while (!text.isEmpty())
+    {
+        // At most one child starts with each character
+        auto it = std::find_if(node->children.begin(), node->children.end(),
+            [&](const std::unique_ptr<PathNode> &child) { return child->prefix[0] == text[0]; });
+        if (it == node->children.end())
+        {
+            std::unique_ptr<PathNode> child(new PathNode());
+            child->prefix = text;
+            node->children.push_back(std::move(child));
+            return node->children.back().get();
+        }
+
+        PathNode *child = it->get();
+        int common = 0;
+        while (common < child->prefix.size() && common < text.size() && child->prefix[common] == text[common])
+            ++common;
+
+        // Split the child so the common part becomes its own node, the child keeps everything else
+        if (common < child->prefix.size())
+        {
+            std::unique_ptr<PathNode> parent(new PathNode());
+            parent->prefix = child->prefix.left(common);
+            child->prefix = child->prefix.mid(common);
+            parent->children.push_back(std::move(*it));
+            *it = std::move(parent);
+            child = it->get();
+        }
+
+        node = child;
+        text = text.mid(common);
+    }
+
+    return node;
+}
+
+bool HttpRequestRouter::isInt(const QStringRef &value)
+{
+    // Only plain digits with an optional sign, toLongLong alone would also accept surrounding whitespace
+    for (int i = 0; i < value.size(); ++i)
+    {
+        if (!value[i].isDigit() && !(i == 0 && value.size() > 1 && value[i] == '-'))
+            return false;
+    }
+
+    bool ok;
+    value.toLongLong(&ok);
+    return ok;
+}
+
+HttpMethods HttpRequestRouter::toMethods(const std::vector<QString> &names)
+{
+    HttpMethods methods;
+    for (const QString &name : names)
+    {
+        const HttpMethod method = parseHttpMethod(name);
+        if (method == HttpMethod::None)
+        {
+            qWarning().noquote() << QString("Unknown method %1 in route, register custom methods with "
+                "registerHttpMethod before adding routes").arg(name);
+            continue;
+        }
+
+        methods |= method;
+    }
+
+    return methods;
+}
+
+const HttpPathRoute *HttpRequestRouter::findRoute(const PathNode *node, HttpMethod method, HttpMethods &allowed)
+{
+    for (const HttpPathRoute &route : node->routes)
+    {
+        if (route.methods.testFlag(method))
+            return &route;
+
+        allowed |= route.methods;
+    }
+
+    return nullptr;
+}
+
+const HttpPathRoute *HttpRequestRouter::matchPath(const PathNode *node, const QString &path, int pos,
+    HttpMethod method, PathParams &params, HttpMethods &allowed)
+{
+    if (pos == path.size())
+    {
+        if (const HttpPathRoute *route = findRoute(node, method, allowed))
+            return route;
+    }
+    else
+    {
+        // Static text first, at most one child can match since they each start with a different character
+        const QChar c = path[pos];
+        for (const std::unique_ptr<PathNode> &child : node->children)
+        {
+            if (child->prefix[0] != c)
+                continue;
+
+            const int size = child->prefix.size();
+            if (path.midRef(pos, size) == child->prefix)
+            {
+                if (const HttpPathRoute *route = matchPath(child.get(), path, pos + size, method, params, allowed))
+                    return route;
+            }
+
+            break;
+        }
+
+        // Parameters match up to the end of the segment & cannot be empty
+        int end = path.indexOf('/', pos);
+        if (end == -1)
+            end = path.size();
+
+        if (end > pos && !node->paramChildren.empty())
+        {
+            const QStringRef value = path.midRef(pos, end - pos);
+            for (const std::unique_ptr<PathNode> &child : node->paramChildren)
+            {
+                if (child->paramType == HttpPathParamType::Int && !isInt(value))
+                    continue;
+
+                params.push_back({child.get(), pos, end - pos});
+                if (const HttpPathRoute *route = matchPath(child.get(), path, end, method, params, allowed))
+                    return route;
+
+                params.pop_back();
+            }
+        }
+    }
+
+    // Wildcard matches whatever is left of the path, including nothing
+    if (node->wildcardChild)
+    {
+        if (const HttpPathRoute *route = findRoute(node->wildcardChild.get(), method, allowed))
+        {
+            params.push_back({node->wildcardChild.get(), pos, path.size() - pos});
+            return route;
+        }
+    }
+
+    return nullptr;
 }
 
 HttpPromise HttpRequestRouter::route(HttpDataPtr data, bool *foundRoute)
 {
-    // Iterate through each route
-    for (const HttpRequestRoute &route : routes)
+    return dispatch(data, foundRoute).toPromise();
+}
+
+HttpResult HttpRequestRouter::dispatch(HttpDataPtr data, bool *foundRoute)
+{
+    const QString path = data->request->uriStr();
+    const HttpMethod method = data->request->httpMethod();
+
+    // Methods of the routes that match the path but not the method, used for the Allow header of a 405 response
+    HttpMethods allowed;
+
+    // Path routes first, a single walk down the tree regardless of the number of routes
+    if (!pathRoot.children.empty() || !pathRoot.paramChildren.empty() || pathRoot.wildcardChild)
     {
-        // Check for matching method and URI match
-        const bool methodMatch = std::find(route.methods.begin(), route.methods.end(), data->request->method()) != route.methods.end();
-        const QRegularExpressionMatch regexMatch = route.pathRegex.match(data->request->uriStr());
+        PathParams params;
+        QString matchedPath = path;
+        const HttpPathRoute *pathRoute = matchPath(&pathRoot, matchedPath, 0, method, params, allowed);
+
+        // Trailing slash is optional
+        if (!pathRoute && path.size() > 1 && path.endsWith('/'))
+        {
+            params.clear();
+            matchedPath.chop(1);
+            pathRoute = matchPath(&pathRoot, matchedPath, 0, method, params, allowed);
+        }
+
+        if (pathRoute)
+        {
+            // Only the position of each parameter is stored, values are extracted when the handler asks for them
+            data->params.setPath(matchedPath);
+            for (const PathParamMatch &param : params)
+                data->params.addPathParam(param.node->paramName, param.start, param.length);
+
+            if (foundRoute) *foundRoute = true;
+            return pathRoute->handler(data);
+        }
+    }
+
+    // Gather the regex routes whose literal prefix matches the path, runs no regex for routes that cannot match
+    std::vector<size_t> candidates = prefixRoot.routes;
+
+    const PrefixNode *node = &prefixRoot;
+    for (const QChar c : path)
+    {
+        auto it = node->children.find(c.unicode());
+        if (it == node->children.end())
+            break;
+
+        node = it->second.get();
+        candidates.insert(candidates.end(), node->routes.begin(), node->routes.end());
+    }
+
+    // Check candidates in the order they were added so the first route added still wins
+    std::sort(candidates.begin(), candidates.end());
+
+    for (size_t index : candidates)
+    {
+        const HttpRequestRoute &route = routes[index];
+
+        // Check for matching method before running the regex
+        if (!route.methods.testFlag(method))
+            continue;
 
         // Found one, call route handler and return
-        if (methodMatch && regexMatch.hasMatch())
+        const QRegularExpressionMatch regexMatch = route.pathRegex.match(path);
+        if (regexMatch.hasMatch())
         {
-            data->state["matches"] = regexMatch.capturedTexts();
-            data->state["match"] = QVariant::fromValue(regexMatch);
+            data->params.setMatch(regexMatch);
+
+            if (storeMatchInState)
+            {
+                data->state["matches"] = regexMatch.capturedTexts();
+                data->state["match"] = QVariant::fromValue(regexMatch);
+            }
 
             if (foundRoute) *foundRoute = true;
             return route.handler(data);
         }
     }
 
+    // Only when no route matches, check whether the path matches routes for other methods
+    for (size_t index : candidates)
+    {
+        const HttpRequestRoute &route = routes[index];
+        if (!route.methods.testFlag(method) && (route.methods & ~allowed) && route.pathRegex.match(path).hasMatch())
+            allowed |= route.methods;
+    }
+
+    if (allowed && !data->response->isValid())
+    {
+        data->response->setError(HttpStatus::MethodNotAllowed);
+        data->response->setHeader("Allow", getHttpMethodsStr(allowed));
+
+        if (foundRoute) *foundRoute = true;
+        return data;
+    }
+
     // No match found, defer back to handler
     if (foundRoute) *foundRoute = false;
-    return HttpPromise::resolve(data);
+    return data;
 }
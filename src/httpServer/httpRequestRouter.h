@@ -2,62 +2,226 @@
 #define HTTP_SERVER_HTTP_REQUEST_ROUTER_H
 
 #include <functional>
-#include <list>
+#include <map>
+#include <memory>
 #include <QtPromise>
+#include <QVarLengthArray>
 #include <vector>
 
 #include "const.h"
 #include "httpRequest.h"
 #include "httpResponse.h"
+#include "httpResult.h"
 #include "util.h"
 
 
 struct HttpRequestRoute
 {
-    std::vector<QString> methods;
+    HttpMethods methods;
     QRegularExpression pathRegex;
 
     HttpFunc handler;
 };
 
+// Type of a path parameter, a parameter only matches segments that are valid for its type
+enum class HttpPathParamType
+{
+    String,
+    Int
+};
+
+struct HttpPathRoute
+{
+    HttpMethods methods;
+    HttpFunc handler;
+};
+
+// Routes requests by regex or by path pattern
+//
+// Path patterns are stored in a radix tree, so finding a route takes time proportional to the length of the path
+// instead of the number of routes. Patterns consist of static text, :name parameters that match a single segment
+// (optionally typed, e.g. :id<int>) and a trailing *name wildcard that matches the rest of the path. Static text is
+// preferred over parameters and parameters over wildcards. Path routes are checked before regex routes, which are
+// checked in the order they were added.
+//
+// Regex routes are indexed by the literal text their pattern starts with (e.g. /users/ for ^/users/(\w*)/?$), so only
+// the routes whose prefix matches the path are run. Routes without an anchored literal prefix are always run.
+//
+// Parameters of the matched route are available through data->param, e.g. data->param("id") or data->param(0) for the
+// first parameter or capture group, and data->paramInt for :name<int> parameters. Handlers written against older
+// versions that read data->state["match"] or data->state["matches"] can turn that back on with
+// setStoreMatchInState(true).
+//
+// Requests for a path that only has routes for other methods get a 405 Method Not Allowed response listing the methods
+// of those routes in the Allow header, unless the response was already set (e.g. by CORS middleware)
 class HTTPSERVER_EXPORT HttpRequestRouter
 {
 private:
-    std::list<HttpRequestRoute> routes;
+    struct PathNode
+    {
+        // Static text matched by this node, empty for parameter & wildcard nodes
+        QString prefix;
+        std::vector<std::unique_ptr<PathNode>> children;
+
+        // Typed parameters are tried before string parameters
+        std::vector<std::unique_ptr<PathNode>> paramChildren;
+        std::unique_ptr<PathNode> wildcardChild;
+
+        QString paramName;
+        HttpPathParamType paramType = HttpPathParamType::String;
+
+        std::vector<HttpPathRoute> routes;
+    };
+
+    struct PathParamMatch
+    {
+        const PathNode *node;
+        int start;
+        int length;
+    };
+
+    using PathParams = QVarLengthArray<PathParamMatch, 8>;
+
+    // Trie of the literal prefixes of regex routes, each node lists the routes whose prefix ends there
+    struct PrefixNode
+    {
+        std::map<ushort, std::unique_ptr<PrefixNode>> children;
+        std::vector<size_t> routes;
+    };
+
+    std::vector<HttpRequestRoute> routes;
+    PrefixNode prefixRoot;
+    PathNode pathRoot;
+    bool storeMatchInState;
+
+    static QString literalPrefix(const QString &regex);
+    void indexRoute(const QString &regex);
+
+    static PathNode *insertStatic(PathNode *node, QString text);
+    static bool isInt(const QStringRef &value);
+    static HttpMethods toMethods(const std::vector<QString> &names);
+    static const HttpPathRoute *findRoute(const PathNode *node, HttpMethod method, HttpMethods &allowed);
+    static const HttpPathRoute *matchPath(const PathNode *node, const QString &path, int pos, HttpMethod method,
+        PathParams &params, HttpMethods &allowed);
 
 public:
+    HttpRequestRouter();
+
+    HttpRequestRouter(const HttpRequestRouter &) = delete;
+    HttpRequestRouter &operator=(const HttpRequestRouter &) = delete;
+
+    void addRoute(HttpMethods methods, QString regex, HttpFunc handler);
     void addRoute(QString method, QString regex, HttpFunc handler);
     void addRoute(std::vector<QString> methods, QString regex, HttpFunc handler);
 
+    void addPath(HttpMethods methods, QString pattern, HttpFunc handler);
+    void addPath(QString method, QString pattern, HttpFunc handler);
+    void addPath(std::vector<QString> methods, QString pattern, HttpFunc handler);
+
+    // Runs the middleware in order before the handler, e.g. addRoute("GET", "^/data/?$", {middleware::CORS}, handler)
+    // The middleware is composed with the handler once here instead of chaining promises in every request
+    void addRoute(HttpMethods methods, QString regex, std::vector<HttpFunc> middleware, HttpFunc handler);
+    void addRoute(QString method, QString regex, std::vector<HttpFunc> middleware, HttpFunc handler);
+    void addRoute(std::vector<QString> methods, QString regex, std::vector<HttpFunc> middleware, HttpFunc handler);
+
+    void addPath(HttpMethods methods, QString pattern, std::vector<HttpFunc> middleware, HttpFunc handler);
+    void addPath(QString method, QString pattern, std::vector<HttpFunc> middleware, HttpFunc handler);
+    void addPath(std::vector<QString> methods, QString pattern, std::vector<HttpFunc> middleware, HttpFunc handler);
+
     // Allows registering member functions using addRoute(..., <CLASS>, &Class:memberFunction)
-    template <typename T>
-    void addRoute(QString method, QString regex, T *inst,
-        HttpPromise (T::*handler)(HttpDataPtr data))
+    // Methods can be given as HttpMethod flags (e.g. HttpMethod::Get | HttpMethod::Post), a name or a list of names
+    // Member functions can return an HttpPromise or an HttpResult
+    template <typename T, typename Methods, typename R>
+    void addRoute(Methods methods, QString regex, T *inst, R (T::*handler)(HttpDataPtr data))
     {
-        return addRoute(method, regex, std::bind(handler, inst, std::placeholders::_1));
+        return addRoute(methods, regex, std::bind(handler, inst, std::placeholders::_1));
     }
 
-    template <typename T>
-    void addRoute(QString method, QString regex, T *inst,
-        HttpPromise (T::*handler)(HttpDataPtr data) const)
+    template <typename T, typename Methods, typename R>
+    void addRoute(Methods methods, QString regex, T *inst, R (T::*handler)(HttpDataPtr data) const)
     {
-        return addRoute(method, regex, std::bind(handler, inst, std::placeholders::_1));
+        return addRoute(methods, regex, std::bind(handler, inst, std::placeholders::_1));
     }
 
-    template <typename T>
+    template <typename T, typename R>
     void addRoute(std::vector<QString> methods, QString regex, T *inst,
-        HttpPromise (T::*handler)(HttpDataPtr data))
+        R (T::*handler)(HttpDataPtr data))
     {
         return addRoute(methods, regex, std::bind(handler, inst, std::placeholders::_1));
     }
 
-    template <typename T>
+    template <typename T, typename R>
     void addRoute(std::vector<QString> methods, QString regex, T *inst,
-        HttpPromise (T::*handler)(HttpDataPtr data) const)
+        R (T::*handler)(HttpDataPtr data) const)
     {
         return addRoute(methods, regex, std::bind(handler, inst, std::placeholders::_1));
     }
 
+    // Allows registering member functions using addPath(..., <CLASS>, &Class:memberFunction)
+    template <typename T, typename Methods, typename R>
+    void addPath(Methods methods, QString pattern, T *inst, R (T::*handler)(HttpDataPtr data))
+    {
+        return addPath(methods, pattern, std::bind(handler, inst, std::placeholders::_1));
+    }
+
+    template <typename T, typename Methods, typename R>
+    void addPath(Methods methods, QString pattern, T *inst, R (T::*handler)(HttpDataPtr data) const)
+    {
+        return addPath(methods, pattern, std::bind(handler, inst, std::placeholders::_1));
+    }
+
+    template <typename T, typename R>
+    void addPath(std::vector<QString> methods, QString pattern, T *inst, R (T::*handler)(HttpDataPtr data))
+    {
+        return addPath(methods, pattern, std::bind(handler, inst, std::placeholders::_1));
+    }
+
+    template <typename T, typename R>
+    void addPath(std::vector<QString> methods, QString pattern, T *inst,
+        R (T::*handler)(HttpDataPtr data) const)
+    {
+        return addPath(methods, pattern, std::bind(handler, inst, std::placeholders::_1));
+    }
+
+    // Allows registering member functions with middleware using
+    // addRoute(..., {middleware}, <CLASS>, &Class:memberFunction)
+    template <typename T, typename Methods, typename F>
+    void addRoute(Methods methods, QString regex, std::vector<HttpFunc> middleware, T *inst, F handler)
+    {
+        return addRoute(methods, regex, std::move(middleware), std::bind(handler, inst, std::placeholders::_1));
+    }
+
+    template <typename T, typename F>
+    void addRoute(std::vector<QString> methods, QString regex, std::vector<HttpFunc> middleware, T *inst, F handler)
+    {
+        return addRoute(methods, regex, std::move(middleware), std::bind(handler, inst, std::placeholders::_1));
+    }
+
+    template <typename T, typename Methods, typename F>
+    void addPath(Methods methods, QString pattern, std::vector<HttpFunc> middleware, T *inst, F handler)
+    {
+        return addPath(methods, pattern, std::move(middleware), std::bind(handler, inst, std::placeholders::_1));
+    }
+
+    template <typename T, typename F>
+    void addPath(std::vector<QString> methods, QString pattern, std::vector<HttpFunc> middleware, T *inst, F handler)
+    {
+        return addPath(methods, pattern, std::move(middleware), std::bind(handler, inst, std::placeholders::_1));
+    }
+
+    // Composes the middleware & handler into a single function
+    // Middleware that finishes synchronously runs back-to-back with the next one, the chain only waits on a promise
+    // when a middleware is asynchronous. Remaining middleware & the handler are skipped once a middleware sets the
+    // response status, e.g. CORS for a pre-flight request.
+    static HttpFunc chain(std::vector<HttpFunc> middleware, HttpFunc handler);
+
+    // Stores the regex match in data->state as well, off by default since it allocates for every request
+    // Turn it on for handlers that still read data->state["match"] or ["matches"], data->param & data->params.match()
+    // give the same values without it
+    void setStoreMatchInState(bool enabled);
+
+    // Runs the handler of the matching route, the result is ready right away if the handler finished synchronously
+    HttpResult dispatch(HttpDataPtr data, bool *foundRoute = nullptr);
     HttpPromise route(HttpDataPtr data, bool *foundRoute = nullptr);
 };
 
@@ -1,16 +1,91 @@
 #include "httpResponse.h"
+#include "httpMimeType.h"
+#include "httpObjectPool.h"
 #include "httpRequest.h"
 
-HTTPSERVER_EXPORT QMimeDatabase HttpResponse::mimeDatabase;
+namespace
+{
+    // Pooled responses keep the capacity of their send buffer up to this size
+    const int maxRetainedBufferSize = 64 * 1024;
+}
+
+
+HttpResponse::HttpResponse(HttpServerConfig *config, std::shared_ptr<HttpArena> arena) : config(config),
+    poolSize(config->objectPoolSize), arena(arena), status_(HttpStatus::None),
+    headers(0, QStringCaseInsensitiveHash(), QStringCaseInSensitiveEqual(), arena.get()),
+    cookies(0, std::hash<QString>(), std::equal_to<QString>(), arena.get()), cacheTtl_(0), writeIndex(0),
+    sending(false), bodyIndex(0), chunked(false), chunksEnded(false), chunksKeptOpen(false), chunkBytes(0),
+    bodyEnded(false), aborted(false), detached(false)
+{
+}
+
+void HttpResponse::reset(HttpServerConfig *config, std::shared_ptr<HttpArena> arena)
+{
+    this->config = config;
+    version_ = "HTTP/1.1";
+    status_ = HttpStatus::None;
+    body_.clear();
+    acceptEncoding_.clear();
+    cacheTtl_ = 0;
+
+    // Keeps the capacity reserved in prepareToSend, so the next response on the thread does not need to allocate
+    writeIndex = 0;
+    if (buffer.capacity() > maxRetainedBufferSize)
+        buffer = QByteArray();
+    else
+        buffer.resize(0);
+
+    sending = false;
+    compressor.reset();
+    bodyIndex = 0;
+    chunked = false;
+    chunksEnded = false;
+    chunksKeptOpen = false;
+    chunks.clear();
+    chunkBytes = 0;
+    bodyEnded = false;
+    aborted = false;
+    upgradeHandler_ = nullptr;
+    notifier = nullptr;
+    detached = false;
+
+    // Maps are switched to the new arena before the reference to the old one is dropped
+    resetArenaMap(headers, arena.get());
+    resetArenaMap(cookies, arena.get());
+    this->arena = arena;
+}
 
-HttpResponse::HttpResponse(HttpServerConfig *config, QObject *parent) : QObject(parent), config(config),
-    status_(HttpStatus::None)
+HttpResponse *HttpResponse::create(HttpServerConfig *config, std::shared_ptr<HttpArena> arena)
 {
+    HttpResponse *response = HttpObjectPool<HttpResponse>::take();
+    if (!response)
+        return new HttpResponse(config, arena);
+
+    response->reset(config, arena);
+    response->poolSize = config->objectPoolSize;
+    return response;
+}
+
+void HttpResponse::release(HttpResponse *response)
+{
+    if (!response)
+        return;
+
+    // Reset right away so the response does not keep its arena, body or handlers alive while in the pool
+    // Note: The config is not used here, the server it belongs to may already be gone
+    response->reset(nullptr, nullptr);
+    if (!HttpObjectPool<HttpResponse>::put(response, response->poolSize))
+        delete response;
 }
 
 bool HttpResponse::isSending() const
 {
-    return !buffer.isEmpty();
+    return sending;
+}
+
+bool HttpResponse::isAborted() const
+{
+    return aborted;
 }
 
 bool HttpResponse::isValid() const
@@ -65,7 +140,7 @@ void HttpResponse::setStatus(HttpStatus status, QByteArray body, QString content
 
     // Auto-determine content type
     if (contentType.isEmpty())
-        contentType = mimeDatabase.mimeTypeForData(body).name();
+        contentType = mimeTypeForData(body);
 
     // Note that the content type here must contain the charset in addition since it cannot be deduced from the body
     setHeader("Content-Type", contentType);
@@ -87,6 +162,23 @@ void HttpResponse::setStatus(HttpStatus status, QString body, QString mimeType)
     setHeader("Content-Type", mimeType + "; charset=utf-8");
 }
 
+void HttpResponse::setStatus(HttpStatus status, const HttpTemplate &tmpl, const HttpTemplateValues &values,
+    QString contentType)
+{
+    status_ = status;
+    body_.clear();
+    tmpl.render(body_, values);
+
+    if (contentType.isEmpty())
+        contentType = tmpl.mimeType();
+
+    // Auto-determine content type if the template does not have one
+    if (contentType.isEmpty())
+        contentType = mimeTypeForData(body_);
+
+    setHeader("Content-Type", contentType);
+}
+
 void HttpResponse::setBody(QByteArray body)
 {
     body_ = body;
@@ -94,18 +186,45 @@ void HttpResponse::setBody(QByteArray body)
 
 void HttpResponse::setError(HttpStatus status, QString errorMessage, bool closeConnection)
 {
+    // The headers of a chunked response have already been sent, ending the body normally would make a truncated body
+    // look complete, so the connection is closed instead
+    if (chunked && sending)
+    {
+        if (config->verbosity >= HttpServerConfig::Verbose::Warning)
+        {
+            qWarning().noquote() << QString("Error occurred after chunked response was started, aborting: %1 %2")
+                .arg(int(status)).arg(errorMessage);
+        }
+
+        aborted = true;
+        if (notifier)
+            notifier();
+
+        return;
+    }
+
+    // Chunked response that has not been sent yet, replace it with a regular error response
+    if (chunked)
+    {
+        chunked = false;
+        chunksEnded = false;
+        chunksKeptOpen = false;
+        chunks.clear();
+        chunkBytes = 0;
+    }
+
     auto it = config->errorDocumentMap.find(status);
     if (it != config->errorDocumentMap.end())
     {
-        QFile file(it->second);
-        if (file.open(QIODevice::ReadOnly))
+        // Error documents are parsed once and cached until the file is modified
+        auto tmpl = HttpTemplate::fromFile(it->second);
+        if (tmpl)
         {
-            QByteArray data = file.readAll();
-            data.replace("${message}", errorMessage.toUtf8());
-            data.replace("${statusCode}", QByteArray::number(int(status)));
-            data.replace("${statusStr}", getHttpStatusStr(status).toUtf8());
-
-            setStatus(status, data, "");
+            setStatus(status, *tmpl, {
+                {"message", errorMessage.toUtf8()},
+                {"statusCode", QByteArray::number(int(status))},
+                {"statusStr", getHttpStatusStr(status).toUtf8()}
+            });
 
             if (config->errorDocumentCacheTime > 0)
                 setHeader("Cache-Control", QString("max-age=%1").arg(config->errorDocumentCacheTime));
@@ -150,13 +269,63 @@ void HttpResponse::redirect(QString url, bool permanent)
 void HttpResponse::compressBody(int compressionLevel)
 {
     // Do nothing if there is no body
-    if (body_.size() == 0)
+    if (!chunked && body_.size() == 0)
         return;
 
-    body_ = gzipCompress(body_, compressionLevel);
+    // Large bodies are compressed in pieces while they are sent, this lets the response start right away and avoids
+    // holding a second, compressed copy of the entire body in memory
+    // Chunked bodies are always compressed in pieces since they are not available up front
+    if (chunked || (config->streamingCompressionMinSize > 0 && body_.size() >= config->streamingCompressionMinSize))
+    {
+        compressor.reset(new GzipCompressor(compressionLevel));
+        bodyIndex = 0;
+    }
+
+    if (!compressor || !compressor->isValid())
+    {
+        compressor.reset();
+
+        // Send chunked bodies uncompressed rather than compressing the first chunk only
+        if (chunked)
+            return;
+
+        body_ = gzipCompress(body_, compressionLevel);
+    }
+
     setHeader("Content-Encoding", "gzip");
 }
 
+void HttpResponse::negotiateCompression()
+{
+    // Skip bodies that are already encoded (e.g. compressBody or precompressed files) or too small to benefit
+    // Note: Size of chunked bodies is not known, so assume they are worth compressing
+    if (headers.find("Content-Encoding") != headers.end() ||
+        (!chunked && body_.size() < config->autoCompressionMinSize))
+        return;
+
+    // Only compress MIME types in the allowlist, formats such as PNG or JPEG are already compressed
+    QString contentType;
+    if (!header("Content-Type", &contentType))
+        return;
+
+    const QString mimeType = contentType.section(';', 0, 0).trimmed();
+    const bool allowed = std::any_of(config->autoCompressionMimeTypes.begin(), config->autoCompressionMimeTypes.end(),
+        [&mimeType](const QString &allowedType) {
+            // Entries ending with a slash match the entire type (e.g. text/)
+            return allowedType.endsWith('/') ? mimeType.startsWith(allowedType, Qt::CaseInsensitive) :
+                mimeType.compare(allowedType, Qt::CaseInsensitive) == 0;
+        });
+    // Event streams are left alone so each event can be shared between subscribers instead of compressed per client
+    if (!allowed || mimeType.compare("text/event-stream", Qt::CaseInsensitive) == 0)
+        return;
+
+    // Whether the body is compressed now depends on Accept-Encoding, so caches must be told regardless of the outcome
+    addVaryHeader("Accept-Encoding");
+
+    if (acceptEncodingQuality(acceptEncoding_, "gzip") > 0.0f)
+        compressBody(config->autoCompressionLevel);
+}
+
 void HttpResponse::sendFile(QString filename, QString mimeType, QString charset, int len, int compressionLevel,
     QString attachmentFilename, int cacheTime)
 {
@@ -170,18 +339,84 @@ void HttpResponse::sendFile(QString filename, QString mimeType, QString charset,
     }
 
     if (mimeType.isEmpty())
-        mimeType = mimeDatabase.mimeTypeForFile(filename, QMimeDatabase::MatchExtension).name();
+        mimeType = mimeTypeForFilename(filename);
+
+    // Prefer a precompressed sibling of the file if the client accepts it, saves compressing the file every request
+    // Note: Partial reads (len != -1) are not supported since the length refers to the uncompressed file
+    if (len == -1 && config->precompressedFiles &&
+        sendPrecompressedFile(filename, mimeType, charset, attachmentFilename, cacheTime))
+        return;
 
     sendFile(&file, mimeType, charset, len, compressionLevel, attachmentFilename, cacheTime);
 }
 
+bool HttpResponse::sendPrecompressedFile(QString filename, QString mimeType, QString charset,
+    QString attachmentFilename, int cacheTime)
+{
+    // Content encodings and their file extensions, in order of preference if the client weighs them equally
+    static const std::vector<std::pair<QString, QString>> encodings = {
+        {"br", ".br"},
+        {"zstd", ".zst"},
+        {"gzip", ".gz"}
+    };
+
+    const QDateTime lastModified = QFileInfo(filename).lastModified();
+    bool hasSibling = false;
+    float bestQuality = 0.0f;
+    QString bestEncoding;
+    QString bestFilename;
+
+    for (auto &encoding : encodings)
+    {
+        // Siblings older than the original file are leftovers from a previous build, ignore them
+        QFileInfo info(filename + encoding.second);
+        if (!info.isFile() || info.lastModified() < lastModified)
+            continue;
+
+        hasSibling = true;
+        float quality = acceptEncodingQuality(acceptEncoding_, encoding.first);
+        if (quality > bestQuality)
+        {
+            bestQuality = quality;
+            bestEncoding = encoding.first;
+            bestFilename = info.filePath();
+        }
+    }
+
+    // Response varies based on Accept-Encoding if any compressed variant exists, even if it was not chosen
+    if (hasSibling)
+        addVaryHeader("Accept-Encoding");
+
+    // Serve the original file if the client explicitly prefers it, equal qualities favor the compressed variant
+    // Note: Identity is only weighed if listed or covered by a wildcard, it is acceptable otherwise but not preferred
+    if (bestEncoding.isEmpty() || acceptEncodingQuality(acceptEncoding_, "identity") > bestQuality)
+        return false;
+
+    QFile file(bestFilename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        if (config->verbosity >= HttpServerConfig::Verbose::Info)
+        {
+            qInfo().noquote() << QString("Unable to open precompressed file to be sent (%1): %2").arg(bestFilename)
+                .arg(file.errorString());
+        }
+
+        return false;
+    }
+
+    sendFile(&file, mimeType, charset, -1, -2, attachmentFilename, cacheTime);
+    setHeader("Content-Encoding", bestEncoding);
+    return true;
+}
+
 void HttpResponse::sendFile(QIODevice *device, QString mimeType, QString charset, int len, int compressionLevel,
     QString attachmentFilename, int cacheTime)
 {
     body_ = len != -1 ? device->read(len) : device->readAll();
 
+    // Note: The device has been read at this point, so the type is determined from the body that will be sent
     if (mimeType.isEmpty())
-        mimeType = mimeDatabase.mimeTypeForData(device).name();
+        mimeType = mimeTypeForData(body_);
 
     setHeader("Content-Type", charset.isEmpty() ? mimeType : QString("%1; charset=%2").arg(mimeType).arg(charset));
 
@@ -195,6 +430,122 @@ void HttpResponse::sendFile(QIODevice *device, QString mimeType, QString charset
         compressBody(compressionLevel);
 }
 
+void HttpResponse::beginChunked(HttpStatus status, QString contentType)
+{
+    if (chunked || sending)
+    {
+        if (config->verbosity >= HttpServerConfig::Verbose::Warning)
+            qWarning().noquote() << "Chunked response can only be started before the response is sent";
+
+        return;
+    }
+
+    status_ = status;
+    chunked = true;
+    body_.clear();
+
+    if (!contentType.isEmpty())
+        setHeader("Content-Type", contentType);
+
+    // Let the connection know that the headers can be sent right away
+    if (notifier)
+        notifier();
+}
+
+bool HttpResponse::appendChunk(QByteArray chunk)
+{
+    // Nowhere to send the chunk if the connection is gone or the body has already ended
+    if (!chunked || chunksEnded || detached)
+        return false;
+
+    if (chunk.isEmpty())
+        return true;
+
+    chunkBytes += chunk.size();
+    chunks.push_back(chunk);
+
+    if (notifier)
+        notifier();
+
+    return true;
+}
+
+void HttpResponse::endChunked()
+{
+    if (!chunked || chunksEnded)
+        return;
+
+    chunksEnded = true;
+
+    if (notifier)
+        notifier();
+}
+
+void HttpResponse::keepChunkedOpen()
+{
+    chunksKeptOpen = true;
+}
+
+bool HttpResponse::isChunked() const
+{
+    return chunked;
+}
+
+bool HttpResponse::isChunkedKeptOpen() const
+{
+    return chunksKeptOpen;
+}
+
+int HttpResponse::queuedChunkBytes() const
+{
+    return chunkBytes;
+}
+
+int HttpResponse::queuedBytes() const
+{
+    if (!sending)
+        return 0;
+
+    int bytes = buffer.size() - writeIndex + chunkBytes;
+    // Body compressed while being sent is only read as the buffer is refilled, what is left of it is still queued
+    if (compressor && !chunked && !bodyEnded)
+        bytes += body_.size() - bodyIndex;
+
+    return bytes;
+}
+
+int HttpResponse::bufferedBytes() const
+{
+    // Note: The body is kept until the response is done, even while it is copied or compressed into the buffer
+    return body_.size() + chunkBytes + (sending ? buffer.size() - writeIndex : 0);
+}
+
+void HttpResponse::setUpgrade(std::function<void(QTcpSocket *)> handler)
+{
+    upgradeHandler_ = handler;
+}
+
+std::function<void(QTcpSocket *)> HttpResponse::upgradeHandler() const
+{
+    return upgradeHandler_;
+}
+
+void HttpResponse::setNotifier(std::function<void()> notifier)
+{
+    this->notifier = notifier;
+}
+
+void HttpResponse::detach()
+{
+    notifier = nullptr;
+    detached = true;
+}
+
+void HttpResponse::setCacheTtl(int milliseconds)
+{
+    cacheTtl_ = milliseconds;
+}
+
 void HttpResponse::setCookie(HttpCookie &cookie)
 {
     // Check if the cookie exists first
@@ -228,25 +579,51 @@ void HttpResponse::setHeader(QString name, int value)
     headers[name] = QString::number(value);
 }
 
+void HttpResponse::addVaryHeader(QString field)
+{
+    auto it = headers.find("Vary");
+    if (it == headers.end())
+    {
+        headers["Vary"] = field;
+        return;
+    }
+
+    // Do not list the same field twice
+    for (const QString &existing : it->second.split(','))
+    {
+        if (existing.trimmed().compare(field, Qt::CaseInsensitive) == 0)
+            return;
+    }
+
+    it->second += ", " + field;
+}
+
 void HttpResponse::setupFromRequest(HttpRequest *request)
 {
+    if (request)
+        acceptEncoding_ = request->headerDefault("Accept-Encoding", "");
+
     // If no connection is specified in the response, use the value from the request or default to keep-alive
     if (headers.find("Connection") == headers.end())
         headers["Connection"] = request ? request->headerDefault("Connection", "keep-alive") : "keep-alive";
 
-    if (status_ == HttpStatus::MethodNotAllowed && request)
-    {
-        // Combine the allowed methods into one string delineated by commas
-        headers["Allow"] = std::accumulate(request->allowedMethods.begin(), request->allowedMethods.end(), QString(""),
-            [](const QString str1, const QString str2) {
-                return str1.isEmpty() ? str2 : str1 + ", " + str2;
-            });
-    }
+    // Router sets the methods allowed for the route, otherwise list every method the server accepts
+    if (status_ == HttpStatus::MethodNotAllowed && headers.find("Allow") == headers.end())
+        headers["Allow"] = getHttpMethodsStr(knownHttpMethods());
 }
 
 void HttpResponse::prepareToSend()
 {
-    headers["Content-Length"] = QString::number(body_.size());
+    // The length of a body compressed while being sent or appended in chunks is not known up front, so chunked
+    // transfer encoding is used
+    // RFC7230 section 3.3.2 states that informational (1xx) responses must not contain a Content-Length
+    if (isStreamed())
+    {
+        headers.erase("Content-Length");
+        headers["Transfer-Encoding"] = "chunked";
+    }
+    else if (status_ >= HttpStatus::Ok)
+        headers["Content-Length"] = QString::number(body_.size());
 
     // If the connection is keep-alive, then attach the keep alive timeout value
     if (headers["Connection"].contains("keep-alive", Qt::CaseInsensitive))
@@ -255,7 +632,7 @@ void HttpResponse::prepareToSend()
     writeIndex = 0;
     buffer.clear();
     // Reserve a generally acceptable amount of space
-    buffer.reserve(2048 + body_.length());
+    buffer.reserve(2048 + (isStreamed() ? config->streamingChunkSize : body_.length()));
 
     // Status line
     buffer += version_;
@@ -285,24 +662,132 @@ void HttpResponse::prepareToSend()
     // Empty line signifies end of headers
     buffer += "\r\n";
 
-    // Body
-    buffer += body_;
+    // Body, unless it is sent in pieces
+    if (!isStreamed())
+        buffer += body_;
+
+    sending = true;
 }
 
 bool HttpResponse::writeChunk(QTcpSocket *socket)
 {
-    int bytesWritten = socket->write(&buffer.data()[writeIndex], buffer.length() - writeIndex);
-    if (bytesWritten == -1)
+    while (true)
     {
-        // Force close the socket and say we're done
-        socket->close();
-        return true;
+        // Write whatever is left in the buffer
+        if (writeIndex < buffer.size())
+        {
+            int bytesWritten = socket->write(&buffer.data()[writeIndex], buffer.length() - writeIndex);
+            if (bytesWritten == -1)
+            {
+                // Force close the socket and say we're done
+                socket->close();
+                return true;
+            }
+
+            // If we did not write the entire buffer, then the socket is full, wait for more bytes to be written
+            writeIndex += bytesWritten;
+            if (writeIndex < buffer.size())
+                return false;
+        }
+
+        // Entire response has been written
+        if (!hasPendingBody())
+            return true;
+
+        // Wait for more chunks to be appended or the socket to drain before producing more of the body, we'll be called
+        // again once either happens
+        if (!canFillBuffer() || socket->bytesToWrite() >= config->socketWriteBufferSize)
+            return false;
+
+        fillBuffer();
     }
+}
 
-    // Increment the bytes written, if we wrote the entire buffer, return true, otherwise return false
-    writeIndex += bytesWritten;
-    if (writeIndex >= buffer.size() - 1)
-        return true;
+bool HttpResponse::isStreamed() const
+{
+    return chunked || compressor;
+}
 
-    return false;
+bool HttpResponse::hasPendingBody() const
+{
+    return isStreamed() && !bodyEnded;
+}
+
+bool HttpResponse::canFillBuffer() const
+{
+    return !chunked || chunksEnded || !chunks.empty();
+}
+
+void HttpResponse::fillBuffer()
+{
+    // Note: resize keeps the capacity reserved in prepareToSend
+    buffer.resize(0);
+    writeIndex = 0;
+
+    // Grab the next piece of the body, either the next appended chunk or the next slice of the entire body
+    // Note: fromRawData does not copy the body, it is valid as long as the body is
+    QByteArray piece;
+    bool last;
+    if (chunked)
+    {
+        if (!chunks.empty())
+        {
+            piece = chunks.front();
+            chunks.pop_front();
+            chunkBytes -= piece.size();
+        }
+
+        last = chunksEnded && chunks.empty();
+    }
+    else
+    {
+        const int size = std::min(config->streamingChunkSize, body_.size() - bodyIndex);
+        piece = QByteArray::fromRawData(&body_.constData()[bodyIndex], size);
+        bodyIndex += size;
+        last = bodyIndex >= body_.size();
+    }
+
+    if (compressor)
+    {
+        // The last piece writes the GZIP trailer
+        // Appended chunks are flushed so they reach the client right away instead of waiting on zlib to buffer more
+        const int flush = last ? Z_FINISH : (chunked ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+
+        QByteArray compressed;
+        if (compressor->compress(piece.constData(), piece.size(), compressed, flush))
+            appendBodyChunk(compressed);
+        else
+        {
+            // There is no way to signal an error midway through a response, so just end the body here
+            if (config->verbosity >= HttpServerConfig::Verbose::Warning)
+                qWarning().noquote() << "Unable to compress response body";
+
+            last = true;
+        }
+    }
+    else
+        appendBodyChunk(piece);
+
+    // Zero-length chunk terminates the body, the body is no longer needed at this point
+    if (last)
+    {
+        buffer += "0\r\n\r\n";
+        bodyEnded = true;
+        piece.clear();
+        body_.clear();
+        chunks.clear();
+        chunkBytes = 0;
+    }
+}
+
+void HttpResponse::appendBodyChunk(const QByteArray &chunk)
+{
+    // Zero-length chunks are reserved for the end of the body
+    if (chunk.isEmpty())
+        return;
+
+    buffer += QByteArray::number(chunk.size(), 16);
+    buffer += "\r\n";
+    buffer += chunk;
+    buffer += "\r\n";
 }
@@ -1,51 +1,113 @@
 #ifndef HTTP_SERVER_HTTP_RESPONSE_H
 #define HTTP_SERVER_HTTP_RESPONSE_H
 
+#include "httpArena.h"
 #include "httpCookie.h"
 #include "httpServerConfig.h"
+#include "httpTemplate.h"
 #include "util.h"
 
+#include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMap>
-#include <QMimeDatabase>
 #include <QString>
 #include <QTcpSocket>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 
 // Forward declaration
 class HttpRequest;
 
-class HTTPSERVER_EXPORT HttpResponse : public QObject
+class HTTPSERVER_EXPORT HttpResponse
 {
-    Q_OBJECT
+    friend class HttpJsonWriter;
+    friend class HttpResponseCache;
 
 private:
-    // Used for determining MIME type when sending files
-    static QMimeDatabase mimeDatabase;
-
     HttpServerConfig *config;
+    // Maximum size of the pool the response is returned to, copied from the config since responses can outlive the
+    // server
+    int poolSize;
+    // Note: Declared before the maps allocated from it so it is destroyed after them
+    std::shared_ptr<HttpArena> arena;
 
     // The HTTP version is currently fixed at 1.1 since HTTP/2 is not supported
     QString version_ = "HTTP/1.1";
     HttpStatus status_;
 
-    std::unordered_map<QString, QString, QStringCaseInsensitiveHash, QStringCaseInSensitiveEqual> headers;
+    HttpArenaMap<QString, QString, QStringCaseInsensitiveHash, QStringCaseInSensitiveEqual> headers;
     // Note: Cookies ARE case sensitive, headers are not
-    std::unordered_map<QString, HttpCookie> cookies;
+    HttpArenaMap<QString, HttpCookie> cookies;
 
     QByteArray body_;
 
+    // Accept-Encoding header of the request, used to negotiate the content encoding
+    QString acceptEncoding_;
+
+    // Number of milliseconds the response can be served from the response cache, 0 if it cannot be cached
+    int cacheTtl_;
+
     int writeIndex;
     QByteArray buffer;
+    bool sending;
+
+    // Large bodies are compressed in pieces while being sent, bodyIndex is the start of the next piece to compress
+    std::unique_ptr<GzipCompressor> compressor;
+    int bodyIndex;
+
+    // Chunked responses send their headers right away and the body is appended in pieces as it becomes available
+    bool chunked;
+    bool chunksEnded;
+    // Chunked responses are ended once the handler is done unless something else keeps appending chunks afterwards
+    bool chunksKeptOpen;
+    std::deque<QByteArray> chunks;
+    int chunkBytes;
+
+    // True once the zero-length chunk ending a streamed body has been written to the buffer
+    bool bodyEnded;
+    // True if an error occurred after a chunked response started sending, the body can only be cut short by closing
+    // the connection
+    bool aborted;
+
+    // Called with the socket once a protocol upgrade response (101 Switching Protocols) has been sent
+    std::function<void(QTcpSocket *)> upgradeHandler_;
+
+    // Notifies the connection when the response has more to send, cleared once the connection is done with it
+    std::function<void()> notifier;
+    bool detached;
+
+    void reset(HttpServerConfig *config, std::shared_ptr<HttpArena> arena);
+
+    bool isStreamed() const;
+    bool hasPendingBody() const;
+    bool canFillBuffer() const;
+    void fillBuffer();
+    void appendBodyChunk(const QByteArray &chunk);
+
+    bool sendPrecompressedFile(QString filename, QString mimeType, QString charset, QString attachmentFilename,
+        int cacheTime);
 
 public:
-    HttpResponse(HttpServerConfig *config, QObject *parent = nullptr);
+    // Headers & cookies are allocated from the arena if one is given, the heap otherwise
+    HttpResponse(HttpServerConfig *config, std::shared_ptr<HttpArena> arena = nullptr);
+
+    // Takes a response from the pool of the current thread, a new one is allocated if the pool is empty
+    static HttpResponse *create(HttpServerConfig *config, std::shared_ptr<HttpArena> arena = nullptr);
+    // Resets the response and returns it to the pool of the current thread, deletes it if the pool is full
+    static void release(HttpResponse *response);
 
     bool isValid() const;
     bool isSending() const;
+    bool isAborted() const;
+    // Bytes of the response that are ready to send but have not been written to the socket yet
+    int queuedBytes() const;
+    // Bytes of the response held in memory, i.e. the body, appended chunks & what is left of the send buffer
+    int bufferedBytes() const;
 
     QString version() const;
     HttpStatus status() const;
@@ -58,6 +120,8 @@ public:
     void setStatus(HttpStatus status, QByteArray body, QString contentType = "");
     void setStatus(HttpStatus status, QJsonDocument body);
     void setStatus(HttpStatus status, QString body, QString mimeType);
+    void setStatus(HttpStatus status, const HttpTemplate &tmpl, const HttpTemplateValues &values,
+        QString contentType = "");
     void setBody(QByteArray body);
 
     void setError(HttpStatus status, QString errorMessage = "", bool closeConnection = false);
@@ -65,17 +129,38 @@ public:
     void redirect(QUrl url, bool permanent = false);
     void redirect(QString url, bool permanent = false);
     void compressBody(int compressionLevel = Z_DEFAULT_COMPRESSION);
+    void negotiateCompression();
 
     void sendFile(QString filename, QString mimeType = "", QString charset = "", int len = -1,
         int compressionLevel = -2, QString attachmentFilename = "", int cacheTime = 0);
     void sendFile(QIODevice *device, QString mimeType = "", QString charset = "", int len = -1,
         int compressionLevel = -2, QString attachmentFilename = "", int cacheTime = 0);
 
+    void beginChunked(HttpStatus status, QString contentType = "");
+    bool appendChunk(QByteArray chunk);
+    void endChunked();
+    // By default, a chunked response that the handler did not end is ended once the handler is done (its promise is
+    // settled). Call this if the chunks are appended after that, e.g. by HttpEventBroadcaster, endChunked must then be
+    // called by whatever keeps appending them
+    void keepChunkedOpen();
+    bool isChunked() const;
+    bool isChunkedKeptOpen() const;
+    int queuedChunkBytes() const;
+
+    void setCacheTtl(int milliseconds);
+
     void setCookie(HttpCookie &cookie);
 
     void setHeader(QString name, QString value, bool encode = false);
     void setHeader(QString name, QDateTime value);
     void setHeader(QString name, int value);
+    void addVaryHeader(QString field);
+
+    void setUpgrade(std::function<void(QTcpSocket *)> handler);
+    std::function<void(QTcpSocket *)> upgradeHandler() const;
+
+    void setNotifier(std::function<void()> notifier);
+    void detach();
 
     void setupFromRequest(HttpRequest *request);
     void prepareToSend();
@@ -0,0 +1,150 @@
+#include "httpResponseCache.h"
+
+HttpResponseCache::HttpResponseCache(qint64 maxSize) : maxSize(maxSize), size_(0)
+{
+}
+
+QString HttpResponseCache::createKey(const HttpRequest *request)
+{
+    // Note: uriStr is only the path, the query is added so different queries are not served each other's responses
+    QString key = request->method() + ' ' + request->uriStr();
+
+    const QUrl uri = request->uri();
+    if (uri.hasQuery())
+        key += '?' + uri.query(QUrl::FullyEncoded);
+
+    return key;
+}
+
+bool HttpResponseCache::isCacheableRequest(const HttpRequest *request)
+{
+    // Cached responses are serialized with a keep-alive connection header, so requests asking to close the connection
+    // must go through the handler
+    return request->httpMethod() == HttpMethod::Get &&
+        request->headerDefault("Connection", "keep-alive").compare("keep-alive", Qt::CaseInsensitive) == 0;
+}
+
+bool HttpResponseCache::find(const HttpRequest *request, QByteArray *data)
+{
+    if (!isCacheableRequest(request))
+        return false;
+
+    auto range = index.equal_range(createKey(request));
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        auto entry = it->second;
+
+        // Check that the request headers match the ones this variant was created for
+        bool match = true;
+        for (size_t i = 0; i < entry->varyHeaders.size() && match; ++i)
+            match = request->headerDefault(entry->varyHeaders[i], "") == entry->varyValues[i];
+
+        if (!match)
+            continue;
+
+        if (entry->expiration.hasExpired())
+        {
+            erase(entry);
+            return false;
+        }
+
+        // Move to the front since it was just used
+        entries.splice(entries.begin(), entries, entry);
+        *data = entry->data;
+        return true;
+    }
+
+    return false;
+}
+
+void HttpResponseCache::insert(const HttpRequest *request, const HttpResponse *response)
+{
+    // Only complete, successful responses that the handler opted in for can be cached
+    // Responses that set cookies are specific to the client
+    if (response->cacheTtl_ <= 0 || response->status_ != HttpStatus::Ok || response->isStreamed() ||
+        !response->cookies.empty() || response->upgradeHandler_ || !isCacheableRequest(request))
+        return;
+
+    auto connection = response->headers.find("Connection");
+    if (connection == response->headers.end() || connection->second.compare("keep-alive", Qt::CaseInsensitive) != 0)
+        return;
+
+    if (response->buffer.size() > maxSize)
+        return;
+
+    Entry entry;
+    entry.key = createKey(request);
+    entry.data = response->buffer;
+    entry.expiration = QDeadlineTimer(response->cacheTtl_);
+
+    // Response varies based on the request headers listed in the Vary header
+    auto vary = response->headers.find("Vary");
+    if (vary != response->headers.end())
+    {
+        for (const QString &field : vary->second.split(','))
+        {
+            const QString header = field.trimmed();
+            if (header.isEmpty())
+                continue;
+
+            // Varies on something other than headers, cannot be cached
+            if (header == "*")
+                return;
+
+            entry.varyHeaders.push_back(header);
+            entry.varyValues.push_back(request->headerDefault(header, ""));
+        }
+    }
+
+    // Remove the existing variant for these request headers
+    auto range = index.equal_range(entry.key);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second->varyHeaders == entry.varyHeaders && it->second->varyValues == entry.varyValues)
+        {
+            erase(it->second);
+            break;
+        }
+    }
+
+    // Evict the least recently used entries until there is room
+    while (!entries.empty() && size_ + entry.data.size() > maxSize)
+        erase(std::prev(entries.end()));
+
+    size_ += entry.data.size();
+    entries.push_front(std::move(entry));
+    index.emplace(entries.front().key, entries.begin());
+}
+
+void HttpResponseCache::erase(std::list<Entry>::iterator it)
+{
+    auto range = index.equal_range(it->key);
+    for (auto indexIt = range.first; indexIt != range.second; ++indexIt)
+    {
+        if (indexIt->second == it)
+        {
+            index.erase(indexIt);
+            break;
+        }
+    }
+
+    size_ -= it->data.size();
+    entries.erase(it);
+}
+
+void HttpResponseCache::clear()
+{
+    entries.clear();
+    index.clear();
+    size_ = 0;
+}
+
+qint64 HttpResponseCache::size() const
+{
+    return size_;
+}
+
+int HttpResponseCache::count() const
+{
+    return (int)entries.size();
+}
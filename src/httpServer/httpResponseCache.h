@@ -0,0 +1,56 @@
+#ifndef HTTP_SERVER_HTTP_RESPONSE_CACHE_H
+#define HTTP_SERVER_HTTP_RESPONSE_CACHE_H
+
+#include "httpRequest.h"
+#include "httpResponse.h"
+#include "util.h"
+
+#include <list>
+#include <QByteArray>
+#include <QDeadlineTimer>
+#include <QString>
+#include <unordered_map>
+#include <vector>
+
+
+// Cache of fully serialized responses, allows a response to be written straight to the socket without running the
+// handler
+//
+// Responses are keyed on the method, URI (path & query) and the values of the request headers listed in the Vary
+// header of the response. Handlers opt in by calling HttpResponse::setCacheTtl. Least recently used responses are
+// evicted once the cache exceeds its size in bytes.
+class HTTPSERVER_EXPORT HttpResponseCache
+{
+private:
+    struct Entry
+    {
+        QString key;
+        std::vector<QString> varyHeaders;
+        std::vector<QString> varyValues;
+        QByteArray data;
+        QDeadlineTimer expiration;
+    };
+
+    qint64 maxSize;
+    qint64 size_;
+
+    // Most recently used entries are at the front, there is an entry for each variant of the same key
+    std::list<Entry> entries;
+    std::unordered_multimap<QString, std::list<Entry>::iterator> index;
+
+    static QString createKey(const HttpRequest *request);
+    static bool isCacheableRequest(const HttpRequest *request);
+    void erase(std::list<Entry>::iterator it);
+
+public:
+    HttpResponseCache(qint64 maxSize);
+
+    bool find(const HttpRequest *request, QByteArray *data);
+    void insert(const HttpRequest *request, const HttpResponse *response);
+    void clear();
+
+    qint64 size() const;
+    int count() const;
+};
+
+#endif // HTTP_SERVER_HTTP_RESPONSE_CACHE_H
@@ -0,0 +1,31 @@
+#include "httpResult.h"
+
+HttpResult::HttpResult(HttpDataPtr data) : data_(data)
+{
+}
+
+HttpResult::HttpResult(HttpPromise promise) : data_(), promise_(new HttpPromise(promise))
+{
+}
+
+HttpResult::HttpResult(const HttpResult &other) : data_(other.data_),
+    promise_(other.promise_ ? new HttpPromise(*other.promise_) : nullptr)
+{
+}
+
+HttpResult &HttpResult::operator=(const HttpResult &other)
+{
+    data_ = other.data_;
+    promise_.reset(other.promise_ ? new HttpPromise(*other.promise_) : nullptr);
+    return *this;
+}
+
+bool HttpResult::isReady() const
+{
+    return !promise_ || promise_->isFulfilled();
+}
+
+HttpPromise HttpResult::toPromise() const
+{
+    return promise_ ? *promise_ : HttpPromise::resolve(data_);
+}
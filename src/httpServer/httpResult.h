@@ -0,0 +1,37 @@
+#ifndef HTTP_SERVER_HTTP_RESULT_H
+#define HTTP_SERVER_HTTP_RESULT_H
+
+#include "const.h"
+#include "util.h"
+
+#include <memory>
+
+
+// Result of a handler, either data that is ready to be sent or a promise for asynchronous work
+//
+// Both convert implicitly, so a handler can return data right away when it finishes synchronously and the connection
+// sends the response without going through the promise machinery. A promise that is already fulfilled (e.g.
+// HttpPromise::resolve(data)) counts as ready as well.
+class HTTPSERVER_EXPORT HttpResult
+{
+private:
+    HttpDataPtr data_;
+    // Only allocated for asynchronous results
+    std::unique_ptr<HttpPromise> promise_;
+
+public:
+    HttpResult(HttpDataPtr data);
+    HttpResult(HttpPromise promise);
+
+    HttpResult(const HttpResult &other);
+    HttpResult(HttpResult &&other) = default;
+    HttpResult &operator=(const HttpResult &other);
+    HttpResult &operator=(HttpResult &&other) = default;
+
+    bool isReady() const;
+
+    // Returns the promise, ready data is wrapped in a resolved promise
+    HttpPromise toPromise() const;
+};
+
+#endif // HTTP_SERVER_HTTP_RESULT_H
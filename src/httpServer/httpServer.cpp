@@ -1,10 +1,20 @@
 #include "httpServer.h"
 
 HttpServer::HttpServer(const HttpServerConfig &config, HttpRequestHandler *requestHandler, QObject *parent) :
-    QTcpServer(parent), config(config), requestHandler(requestHandler), sslConfig(nullptr)
+    QTcpServer(parent), config(config), requestHandler(requestHandler), sslConfig(nullptr), responseCache(nullptr),
+    memoryBudget(nullptr)
 {
+    // Note: Uses the config stored in the server, the one passed in may not outlive it
+    pool = new HttpThreadPool(&this->config);
+
     setMaxPendingConnections(config.maxPendingConnections);
     loadSslConfig();
+
+    if (config.responseCacheSize > 0)
+        responseCache = new HttpResponseCache(config.responseCacheSize);
+
+    if (config.memoryBudget > 0)
+        memoryBudget = new HttpMemoryBudget(config.memoryBudget, this);
 }
 
 bool HttpServer::listen()
@@ -138,24 +148,35 @@ void HttpServer::incomingConnection(qintptr socketDescriptor)
                 .arg(config.maxConnections).arg(socket->peerAddress().toString());
         }
 
-        HttpResponse *response = new HttpResponse(&config);
+        HttpResponse *response = HttpResponse::create(&config);
         response->setError(HttpStatus::ServiceUnavailable, "Too many connections", true);
         response->prepareToSend();
 
         // Assume that the entire request will be written in one go, relatively safe assumption
         response->writeChunk(socket);
-        delete response;
+        HttpResponse::release(response);
 
         // This will disconnect after all bytes have been written
         socket->disconnectFromHost();
         return;
     }
 
-    HttpConnection *connection = new HttpConnection(&config, requestHandler, socketDescriptor, sslConfig);
+    HttpConnection *connection = new HttpConnection(&config, requestHandler, socketDescriptor, sslConfig,
+        responseCache, pool, memoryBudget);
     connect(connection, &HttpConnection::disconnected, this, &HttpServer::connectionDisconnected);
     connections.push_back(connection);
 }
 
+HttpThreadPoolStats HttpServer::poolStats() const
+{
+    return pool->stats();
+}
+
+qint64 HttpServer::memoryUsage() const
+{
+    return memoryBudget ? memoryBudget->usage() : 0;
+}
+
 void HttpServer::connectionDisconnected()
 {
     HttpConnection *connection = dynamic_cast<HttpConnection *>(sender());
@@ -178,5 +199,9 @@ HttpServer::~HttpServer()
         delete connection;
 
     delete sslConfig;
+    delete responseCache;
     close();
+
+    // Deleted last since it waits for running jobs to finish
+    delete pool;
 }
@@ -2,8 +2,11 @@
 #define HTTP_SERVER_HTTPSERVER_H
 
 #include "httpConnection.h"
+#include "httpMemoryBudget.h"
 #include "httpServerConfig.h"
 #include "httpRequestHandler.h"
+#include "httpResponseCache.h"
+#include "httpThreadPool.h"
 #include "util.h"
 
 #include <QBasicTimer>
@@ -22,6 +25,9 @@ private:
     HttpRequestHandler *requestHandler;
 
     QSslConfiguration *sslConfig;
+    HttpResponseCache *responseCache;
+    HttpThreadPool *pool;
+    HttpMemoryBudget *memoryBudget;
     std::vector<HttpConnection *> connections;
 
     void loadSslConfig();
@@ -33,6 +39,10 @@ public:
     bool listen();
     void close();
 
+    HttpThreadPoolStats poolStats() const;
+    // Bytes currently accounted against HttpServerConfig::memoryBudget, 0 if there is no budget
+    qint64 memoryUsage() const;
+
 protected:
     void incomingConnection(qintptr socketDescriptor);
 
@@ -2,6 +2,7 @@
 #define HTTP_SERVER_CONFIG_H
 
 #include <QHostAddress>
+#include <vector>
 
 #include "util.h"
 
@@ -27,6 +28,20 @@ struct HTTPSERVER_EXPORT HttpServerConfig
     int maxRequestSize = 16 * 1024;
     int maxMultipartSize = 1 * 1024 * 1024;
 
+    // Number of requests & bytes a connection reads per event loop wakeup before letting other connections run, so a
+    // client pipelining many requests cannot starve the rest. Anything left is read on a later iteration, 0 is no limit
+    int maxRequestsPerRead = 16;
+    int maxBytesPerRead = 256 * 1024;
+
+    // Maximum number of pipelined requests waiting on a response and bytes of response output queued on a connection.
+    // Once either is reached, the connection stops reading from the socket until the queue drains. 0 is no limit
+    int maxPipelinedRequests = 32;
+    int maxPendingResponseBytes = 1024 * 1024;
+
+    // Server-wide limit in bytes for request bodies, multipart data, socket buffers & responses held in memory. While
+    // it is exceeded, connections stop reading request bodies and new requests get a 503 response. 0 is no limit
+    qint64 memoryBudget = 0;
+
     // Timeout time in seconds to receive a request
     // The request timeout is applied for the first request and will usually be set higher. If a request is not
     // received by this time, an error response will be sent back.
@@ -38,6 +53,59 @@ struct HTTPSERVER_EXPORT HttpServerConfig
     int keepAliveTimeout = 5;
     int responseTimeout = 10;
 
+    // Minimum rates in bytes per second that a client must send a request (headers & body) and read a response at,
+    // averaged over the last dataRateWindow seconds. Rates are only enforced once a transfer has been going on for
+    // dataRateGracePeriod seconds. Slow requests get a timeout response, slow responses are aborted. When the minimum
+    // request rate is set, it replaces the request timeout while reading a body so large uploads are not cut off.
+    // Note: Both rates are disabled (0) by default, so slowloris protection is OFF unless they are set. Until then a
+    // client that trickles in a request or never reads its response is only limited by the timeouts above
+    int minRequestDataRate = 0;
+    int minResponseDataRate = 0;
+    int dataRateGracePeriod = 5;
+    int dataRateWindow = 5;
+
+    // Serve precompressed siblings of files (e.g. app.js.br, app.js.zst, app.js.gz) in HttpResponse::sendFile when
+    // the client accepts the encoding. Siblings older than the original file are ignored
+    bool precompressedFiles = true;
+
+    // Automatically GZIP compress response bodies right before sending if the client accepts it. Only bodies of at
+    // least autoCompressionMinSize bytes with a MIME type in the allowlist are compressed, bodies that already have a
+    // Content-Encoding are left alone. Allowlist entries ending with a slash match the entire type (e.g. text/)
+    bool autoCompression = false;
+    int autoCompressionLevel = Z_DEFAULT_COMPRESSION;
+    int autoCompressionMinSize = 1024;
+    std::vector<QString> autoCompressionMimeTypes = {"text/", "application/json", "application/javascript",
+        "application/xml", "image/svg+xml"};
+
+    // Bodies of at least streamingCompressionMinSize bytes given to HttpResponse::compressBody are compressed in pieces
+    // of streamingChunkSize bytes while being sent, using chunked transfer encoding since the final length is unknown.
+    // Set to 0 to always compress the entire body up front
+    int streamingCompressionMinSize = 256 * 1024;
+    int streamingChunkSize = 32 * 1024;
+
+    // Stop producing more of a response once the socket has this many bytes waiting to be written
+    int socketWriteBufferSize = 256 * 1024;
+
+    // Maximum size in bytes of the cache of serialized responses, set to 0 to disable. Only responses that the handler
+    // opts in for with HttpResponse::setCacheTtl are cached, cache hits are written straight to the socket without
+    // running the handler
+    int responseCacheSize = 0;
+
+    // Size in bytes of the blocks each request allocates its & its response's headers, cookies and form fields from.
+    // The memory is released along with the request and reused for later requests on the thread, up to objectPoolSize
+    // arenas are kept per thread. Set to 0 to allocate them from the heap instead
+    int requestArenaBlockSize = 4 * 1024;
+
+    // Number of request & response objects each thread keeps to reuse for later requests instead of allocating new
+    // ones, set to 0 to disable
+    int objectPoolSize = 64;
+
+    // Number of threads of the pool that HttpData::runOnPool runs work on, 0 starts one per CPU core. The threads are
+    // only started once work is submitted. Use HttpServer::poolStats to observe the pool.
+    int poolThreadCount = 0;
+    // Logs a warning when more than this many jobs are waiting for a pool thread, set to 0 to disable
+    int poolQueueWarningSize = 256;
+
     QString defaultContentType = "application/octet-stream";
     QString defaultCharset = "utf-8";
 
@@ -0,0 +1,61 @@
+#include "httpTask.h"
+
+#include <new>
+#include <vector>
+
+namespace
+{
+    // Frame sizes are rounded up to a multiple of this, frames up to frameSizeStep * frameSizeCount bytes are pooled
+    const size_t frameSizeStep = 256;
+    const size_t frameSizeCount = 16;
+    // Frames kept per size on each thread
+    const size_t maxPooledFrames = 32;
+
+    struct FramePool
+    {
+        std::vector<void *> frames[frameSizeCount];
+
+        ~FramePool()
+        {
+            for (std::vector<void *> &sizeFrames : frames)
+            {
+                for (void *frame : sizeFrames)
+                    ::operator delete(frame);
+            }
+        }
+    };
+
+    thread_local FramePool framePool;
+
+    size_t frameSizeIndex(size_t size)
+    {
+        return (size + frameSizeStep - 1) / frameSizeStep - 1;
+    }
+}
+
+void *httpAllocateFrame(size_t size)
+{
+    const size_t index = frameSizeIndex(size);
+    if (index >= frameSizeCount)
+        return ::operator new(size);
+
+    std::vector<void *> &frames = framePool.frames[index];
+    if (frames.empty())
+        return ::operator new((index + 1) * frameSizeStep);
+
+    void *frame = frames.back();
+    frames.pop_back();
+    return frame;
+}
+
+void httpDeallocateFrame(void *frame, size_t size)
+{
+    const size_t index = frameSizeIndex(size);
+    if (index >= frameSizeCount || framePool.frames[index].size() >= maxPooledFrames)
+    {
+        ::operator delete(frame);
+        return;
+    }
+
+    framePool.frames[index].push_back(frame);
+}
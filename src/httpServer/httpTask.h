@@ -0,0 +1,333 @@
+#ifndef HTTP_SERVER_HTTP_TASK_H
+#define HTTP_SERVER_HTTP_TASK_H
+
+// Coroutine handlers are only available when compiling as C++20 (e.g. CONFIG += c++2a), the rest of the library does
+// not depend on them
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define HTTP_SERVER_COROUTINES 1
+#endif
+#endif
+
+#include "util.h"
+
+#include <cstddef>
+
+
+// Coroutine frames are allocated from a per-thread free list so a handler does not hit the heap for every request
+// Note: Always part of the library, which is built as C++11, so applications compiled as C++20 can link against it
+HTTPSERVER_EXPORT void *httpAllocateFrame(size_t size);
+HTTPSERVER_EXPORT void httpDeallocateFrame(void *frame, size_t size);
+
+#ifdef HTTP_SERVER_COROUTINES
+
+#include "const.h"
+#include "httpResult.h"
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <QObject>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtPromise>
+#include <type_traits>
+#include <utility>
+
+
+// Resumes the coroutine after the given number of milliseconds, e.g. co_await HttpDelay(1000)
+class HTTPSERVER_EXPORT HttpDelay
+{
+private:
+    int milliseconds;
+
+public:
+    explicit HttpDelay(int milliseconds) : milliseconds(milliseconds) {}
+
+    bool await_ready() const noexcept { return milliseconds <= 0; }
+    void await_suspend(std::coroutine_handle<> handle) const
+    {
+        QTimer::singleShot(milliseconds, [handle]() {
+            handle.resume();
+        });
+    }
+    void await_resume() const noexcept {}
+};
+
+// Runs the function on the global thread pool and resumes the coroutine on the current thread with its result, e.g.
+//     QByteArray hash = co_await httpRunInPool([body]() { return QCryptographicHash::hash(body, ...); });
+template <typename R>
+class HttpPoolJob
+{
+private:
+    using Value = std::conditional_t<std::is_void_v<R>, bool, std::optional<R>>;
+
+    std::function<R()> function;
+    Value value {};
+    std::exception_ptr error;
+
+public:
+    explicit HttpPoolJob(std::function<R()> function) : function(std::move(function)) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // Context object lives in the current thread, the coroutine is resumed through its event loop
+        QObject *context = new QObject();
+        QThreadPool::globalInstance()->start(new Runnable([this, handle, context]() {
+            try
+            {
+                if constexpr (std::is_void_v<R>)
+                    function();
+                else
+                    value = function();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            QMetaObject::invokeMethod(context, [handle, context]() {
+                context->deleteLater();
+                handle.resume();
+            }, Qt::QueuedConnection);
+        }));
+    }
+    R await_resume()
+    {
+        if (error)
+            std::rethrow_exception(error);
+
+        if constexpr (!std::is_void_v<R>)
+            return std::move(*value);
+    }
+
+private:
+    class Runnable : public QRunnable
+    {
+    private:
+        std::function<void()> function;
+
+    public:
+        explicit Runnable(std::function<void()> function) : function(std::move(function)) {}
+        void run() override { function(); }
+    };
+};
+
+template <typename F>
+HttpPoolJob<std::invoke_result_t<F>> httpRunInPool(F function)
+{
+    return HttpPoolJob<std::invoke_result_t<F>>(std::move(function));
+}
+
+// Coroutine handler, returns the HttpDataPtr of the request with co_return
+//
+// The coroutine starts running right away, so a handler that finishes without suspending returns a ready HttpResult
+// and the response is sent without creating any promise. Handlers can co_await HttpPromise (or any QPromise), HttpDelay
+// and httpRunInPool. Routes & HttpRequestHandler::dispatch accept an HttpTask anywhere an HttpResult is expected:
+//
+//     HttpTask handleAsyncTest(HttpDataPtr data)
+//     {
+//         co_await HttpDelay(1000);
+//         data->response->setStatus(HttpStatus::Ok);
+//         co_return data;
+//     }
+class HTTPSERVER_EXPORT HttpTask
+{
+public:
+    class promise_type
+    {
+        friend class HttpTask;
+
+    private:
+        HttpDataPtr data;
+        std::exception_ptr error;
+
+        // Set once the task has been converted to a promise, the frame then completes it & destroys itself
+        bool detached = false;
+        std::function<void(HttpDataPtr)> resolve;
+        std::function<void(std::exception_ptr)> reject;
+
+        template <typename T>
+        struct PromiseAwaiter
+        {
+            QtPromise::QPromise<T> promise;
+            std::conditional_t<std::is_void_v<T>, bool, std::optional<T>> value {};
+            std::exception_ptr error;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                // Note: QtPromise calls the rejection handler while the exception is being handled
+                auto onRejected = [this, handle]() {
+                    error = std::current_exception();
+                    handle.resume();
+                };
+
+                if constexpr (std::is_void_v<T>)
+                    promise.then([handle]() { handle.resume(); }, onRejected);
+                else
+                    promise.then([this, handle](const T &result) { value = result; handle.resume(); }, onRejected);
+            }
+            T await_resume()
+            {
+                if (error)
+                    std::rethrow_exception(error);
+
+                if constexpr (!std::is_void_v<T>)
+                    return std::move(*value);
+            }
+        };
+
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<promise_type> handle) const noexcept
+            {
+                promise_type &promise = handle.promise();
+
+                // Task still owns the frame and reads the result itself
+                if (!promise.detached)
+                    return;
+
+                auto resolve = std::move(promise.resolve);
+                auto reject = std::move(promise.reject);
+                HttpDataPtr data = std::move(promise.data);
+                std::exception_ptr error = promise.error;
+                handle.destroy();
+
+                if (error)
+                    reject(error);
+                else
+                    resolve(data);
+            }
+            void await_resume() const noexcept {}
+        };
+
+    public:
+        static void *operator new(size_t size)
+        {
+            return httpAllocateFrame(size);
+        }
+
+        static void operator delete(void *frame, size_t size)
+        {
+            httpDeallocateFrame(frame, size);
+        }
+
+        HttpTask get_return_object()
+        {
+            return HttpTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+
+        void return_value(HttpDataPtr value)
+        {
+            data = std::move(value);
+        }
+
+        void unhandled_exception()
+        {
+            error = std::current_exception();
+        }
+
+        template <typename T>
+        PromiseAwaiter<T> await_transform(QtPromise::QPromise<T> promise)
+        {
+            return PromiseAwaiter<T> {std::move(promise)};
+        }
+
+        template <typename Awaitable>
+        Awaitable &&await_transform(Awaitable &&awaitable)
+        {
+            return std::forward<Awaitable>(awaitable);
+        }
+    };
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit HttpTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    void release()
+    {
+        if (!handle)
+            return;
+
+        if (handle.done())
+        {
+            handle.destroy();
+        }
+        else
+        {
+            // Coroutine is waiting on something that will resume it, let it finish & destroy its frame on its own
+            promise_type &promise = handle.promise();
+            promise.detached = true;
+            promise.resolve = [](HttpDataPtr) {};
+            promise.reject = [](std::exception_ptr) {};
+        }
+
+        handle = nullptr;
+    }
+
+public:
+    HttpTask(HttpTask &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    HttpTask &operator=(HttpTask &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            handle = std::exchange(other.handle, nullptr);
+        }
+
+        return *this;
+    }
+
+    HttpTask(const HttpTask &) = delete;
+    HttpTask &operator=(const HttpTask &) = delete;
+
+    ~HttpTask()
+    {
+        release();
+    }
+
+    bool isReady() const
+    {
+        return !handle || handle.done();
+    }
+
+    // Returns the data if the coroutine has finished, otherwise a promise that is resolved when it finishes
+    // Note: Exceptions thrown before the coroutine suspended are rethrown here
+    operator HttpResult() &&
+    {
+        std::coroutine_handle<promise_type> task = std::exchange(handle, nullptr);
+        promise_type &promise = task.promise();
+
+        if (task.done())
+        {
+            HttpDataPtr data = std::move(promise.data);
+            std::exception_ptr error = promise.error;
+            task.destroy();
+
+            if (error)
+                std::rethrow_exception(error);
+
+            return data;
+        }
+
+        return HttpPromise([&promise](const QtPromise::QPromiseResolve<HttpDataPtr> &resolve,
+            const QtPromise::QPromiseReject<HttpDataPtr> &reject) {
+            promise.detached = true;
+            promise.resolve = [resolve](HttpDataPtr data) { resolve(data); };
+            promise.reject = [reject](std::exception_ptr error) { reject(error); };
+        });
+    }
+};
+
+#endif // HTTP_SERVER_COROUTINES
+
+#endif // HTTP_SERVER_HTTP_TASK_H
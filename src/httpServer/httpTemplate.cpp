@@ -0,0 +1,110 @@
+#include "httpTemplate.h"
+#include "httpMimeType.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+QMutex HttpTemplate::cacheMutex;
+std::unordered_map<QString, HttpTemplate::CacheEntry> HttpTemplate::cache;
+
+HttpTemplate::HttpTemplate(const QByteArray &source, QString mimeType) : literalSize(0), mimeType_(mimeType)
+{
+    int index = 0;
+    QByteArray literal;
+
+    while (index < source.size())
+    {
+        // Find the next placeholder, anything without a closing brace is literal text
+        const int start = source.indexOf("${", index);
+        const int end = start == -1 ? -1 : source.indexOf('}', start + 2);
+        if (end == -1)
+        {
+            literal += source.mid(index);
+            break;
+        }
+
+        literal += source.mid(index, start - index);
+        if (!literal.isEmpty())
+        {
+            literalSize += literal.size();
+            segments.push_back({literal, false});
+            literal.clear();
+        }
+
+        segments.push_back({source.mid(start + 2, end - start - 2), true});
+        index = end + 1;
+    }
+
+    if (!literal.isEmpty())
+    {
+        literalSize += literal.size();
+        segments.push_back({literal, false});
+    }
+}
+
+std::shared_ptr<const HttpTemplate> HttpTemplate::fromFile(QString filename)
+{
+    QFileInfo info(filename);
+    if (!info.isFile())
+        return nullptr;
+
+    QMutexLocker locker(&cacheMutex);
+
+    // Use the cached template as long as the file has not changed
+    auto it = cache.find(filename);
+    if (it != cache.end() && it->second.lastModified == info.lastModified() && it->second.size == info.size())
+        return it->second.tmpl;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    // MIME type is determined once here instead of every time the template is rendered
+    const QByteArray source = file.readAll();
+    QString mimeType = mimeTypeForFilename(filename);
+    if (mimeType == "application/octet-stream")
+        mimeType = mimeTypeForData(source);
+
+    auto tmpl = std::make_shared<const HttpTemplate>(source, mimeType);
+    cache[filename] = CacheEntry {info.lastModified(), info.size(), tmpl};
+    return tmpl;
+}
+
+QString HttpTemplate::mimeType() const
+{
+    return mimeType_;
+}
+
+void HttpTemplate::render(QByteArray &out, const HttpTemplateValues &values) const
+{
+    out.reserve(out.size() + literalSize + 64 * (int)values.size());
+
+    for (const Segment &segment : segments)
+    {
+        if (!segment.placeholder)
+        {
+            out += segment.text;
+            continue;
+        }
+
+        // Linear search is faster than hashing for the handful of values a template usually has
+        auto it = std::find_if(values.begin(), values.end(),
+            [&segment](const std::pair<QByteArray, QByteArray> &value) { return value.first == segment.text; });
+
+        if (it != values.end())
+            out += it->second;
+        else
+        {
+            out += "${";
+            out += segment.text;
+            out += '}';
+        }
+    }
+}
+
+QByteArray HttpTemplate::render(const HttpTemplateValues &values) const
+{
+    QByteArray out;
+    render(out, values);
+    return out;
+}
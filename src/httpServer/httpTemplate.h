@@ -0,0 +1,59 @@
+#ifndef HTTP_SERVER_HTTP_TEMPLATE_H
+#define HTTP_SERVER_HTTP_TEMPLATE_H
+
+#include "util.h"
+
+#include <memory>
+#include <QByteArray>
+#include <QDateTime>
+#include <QMutex>
+#include <QString>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+using HttpTemplateValues = std::vector<std::pair<QByteArray, QByteArray>>;
+
+// Template with ${name} placeholders that is parsed once into literal and placeholder segments
+//
+// Rendering appends each segment to the output in one pass, placeholders without a value are left as-is. Values are
+// inserted as-is, so escape any untrusted values that are placed in HTML
+class HTTPSERVER_EXPORT HttpTemplate
+{
+private:
+    struct Segment
+    {
+        // Literal text or the name of the placeholder
+        QByteArray text;
+        bool placeholder;
+    };
+
+    struct CacheEntry
+    {
+        QDateTime lastModified;
+        qint64 size;
+        std::shared_ptr<const HttpTemplate> tmpl;
+    };
+
+    static QMutex cacheMutex;
+    static std::unordered_map<QString, CacheEntry> cache;
+
+    std::vector<Segment> segments;
+    int literalSize;
+    QString mimeType_;
+
+public:
+    HttpTemplate(const QByteArray &source, QString mimeType = "");
+
+    // Loads the template from a file, templates are cached by filename & reloaded when the file is modified
+    // Returns nullptr if the file cannot be read
+    static std::shared_ptr<const HttpTemplate> fromFile(QString filename);
+
+    QString mimeType() const;
+
+    void render(QByteArray &out, const HttpTemplateValues &values) const;
+    QByteArray render(const HttpTemplateValues &values) const;
+};
+
+#endif // HTTP_SERVER_HTTP_TEMPLATE_H
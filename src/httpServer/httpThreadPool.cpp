@@ -0,0 +1,256 @@
+#include "httpThreadPool.h"
+
+#include <QDebug>
+#include <QThread>
+
+namespace
+{
+    // Pool & index of the worker running on the current thread, nullptr & -1 on other threads
+    // Note: Both are needed since a job of one pool can submit jobs to another pool
+    thread_local HttpThreadPool *currentPool = nullptr;
+    thread_local int currentWorker = -1;
+}
+
+HttpCompletionQueue::HttpCompletionQueue() : head(&stub), tail(&stub), drainScheduled(false)
+{
+    stub.next.store(nullptr, std::memory_order_relaxed);
+}
+
+HttpCompletionQueue::~HttpCompletionQueue()
+{
+    while (Node *node = pop())
+        delete node;
+}
+
+HttpCompletionQueue *HttpCompletionQueue::current()
+{
+    static thread_local std::unique_ptr<HttpCompletionQueue> queue;
+    if (!queue)
+        queue.reset(new HttpCompletionQueue());
+
+    return queue.get();
+}
+
+void HttpCompletionQueue::push(Node *node)
+{
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+HttpCompletionQueue::Node *HttpCompletionQueue::pop()
+{
+    Node *node = tail;
+    Node *next = node->next.load(std::memory_order_acquire);
+
+    // Skip over the stub node
+    if (node == &stub)
+    {
+        if (!next)
+            return nullptr;
+
+        tail = next;
+        node = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next)
+    {
+        tail = next;
+        return node;
+    }
+
+    // A producer has swapped the head but not linked its node yet, it schedules another drain once it has
+    if (node != head.load(std::memory_order_acquire))
+        return nullptr;
+
+    // Node is the last one, put the stub back behind it so it can be popped
+    push(&stub);
+    next = node->next.load(std::memory_order_acquire);
+    if (next)
+    {
+        tail = next;
+        return node;
+    }
+
+    return nullptr;
+}
+
+void HttpCompletionQueue::drain()
+{
+    // Cleared before popping so a completion pushed while draining schedules another drain
+    drainScheduled.store(false);
+
+    while (Node *node = pop())
+    {
+        node->callback();
+        delete node;
+    }
+}
+
+void HttpCompletionQueue::post(std::function<void()> callback)
+{
+    Node *node = new Node();
+    node->callback = std::move(callback);
+    push(node);
+
+    // Only the first completion after a drain wakes up the thread
+    if (!drainScheduled.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, [this]() {
+            drain();
+        }, Qt::QueuedConnection);
+    }
+}
+
+HttpThreadPool::HttpThreadPool(HttpServerConfig *config) : config(config), stopping(false), queued(0), active(0),
+    completed(0), stolen(0), nextWorker(0)
+{
+    int threadCount = config->poolThreadCount > 0 ? config->poolThreadCount : QThread::idealThreadCount();
+    for (int i = 0; i < std::max(threadCount, 1); ++i)
+        workers.emplace_back(new Worker());
+}
+
+HttpThreadPool::~HttpThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+
+    for (auto &worker : workers)
+    {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+
+    // Threads only finish the job they are running, let the owners of the remaining jobs know they will never run
+    int cancelled = 0;
+    for (auto &worker : workers)
+    {
+        for (Job &job : worker->jobs)
+        {
+            // Released first so nothing the job captured outlives the cancellation
+            job.run = nullptr;
+            if (job.cancel)
+                job.cancel();
+
+            ++cancelled;
+        }
+        worker->jobs.clear();
+    }
+
+    if (cancelled > 0 && config->verbosity >= HttpServerConfig::Verbose::Info)
+        qInfo().noquote() << QString("Cancelled %1 pool jobs that had not started").arg(cancelled);
+}
+
+void HttpThreadPool::startThreads()
+{
+    for (int i = 0; i < (int)workers.size(); ++i)
+        workers[i]->thread = std::thread(&HttpThreadPool::run, this, i);
+
+    if (config->verbosity >= HttpServerConfig::Verbose::Debug)
+        qDebug().noquote() << QString("Started %1 pool threads").arg(workers.size());
+}
+
+void HttpThreadPool::start(std::function<void()> job, std::function<void()> cancel)
+{
+    std::call_once(startFlag, &HttpThreadPool::startThreads, this);
+
+    // Jobs queued from a thread of this pool stay on that thread, its data is likely still in cache
+    const int index = currentPool == this ? currentWorker : (int)(nextWorker++ % workers.size());
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->jobs.push_back({std::move(job), std::move(cancel)});
+    }
+
+    int queuedJobs;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queuedJobs = ++queued;
+    }
+    wakeup.notify_one();
+
+    if (config->poolQueueWarningSize > 0 && queuedJobs == config->poolQueueWarningSize + 1 &&
+        config->verbosity >= HttpServerConfig::Verbose::Warning)
+    {
+        qWarning().noquote() << QString("More than %1 jobs are waiting for a pool thread")
+            .arg(config->poolQueueWarningSize);
+    }
+}
+
+bool HttpThreadPool::takeJob(int index, Job &job)
+{
+    // Newest job of its own queue first
+    {
+        Worker &worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.jobs.empty())
+        {
+            job = std::move(worker.jobs.back());
+            worker.jobs.pop_back();
+            return true;
+        }
+    }
+
+    // Otherwise steal the oldest job of another queue
+    for (size_t i = 1; i < workers.size(); ++i)
+    {
+        Worker &victim = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            ++stolen;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void HttpThreadPool::run(int index)
+{
+    currentPool = this;
+    currentWorker = index;
+
+    // Jobs still queued once the pool is stopping are cancelled by the destructor
+    while (!stopping)
+    {
+        Job job;
+        if (takeJob(index, job))
+        {
+            --queued;
+            ++active;
+            try
+            {
+                job.run();
+            }
+            catch (const std::exception &error)
+            {
+                if (config->verbosity >= HttpServerConfig::Verbose::Warning)
+                    qWarning().noquote() << QString("Uncaught exception in pool job: %1").arg(error.what());
+            }
+            catch (...)
+            {
+                if (config->verbosity >= HttpServerConfig::Verbose::Warning)
+                    qWarning().noquote() << QString("Uncaught exception in pool job");
+            }
+            --active;
+            ++completed;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeup.wait(lock, [this]() {
+            return stopping || queued > 0;
+        });
+    }
+}
+
+HttpThreadPoolStats HttpThreadPool::stats() const
+{
+    return {(int)workers.size(), queued.load(), active.load(), completed.load(), stolen.load()};
+}
@@ -0,0 +1,120 @@
+#ifndef HTTP_SERVER_HTTP_THREAD_POOL_H
+#define HTTP_SERVER_HTTP_THREAD_POOL_H
+
+#include "httpServerConfig.h"
+#include "util.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <QObject>
+#include <thread>
+#include <vector>
+
+
+// Completed pool jobs waiting to be handled on the thread that submitted them
+//
+// Pool threads push to a lock-free multi-producer single-consumer queue, the owning thread is woken up once through
+// its event loop & drains every completion queued by then.
+class HTTPSERVER_EXPORT HttpCompletionQueue : public QObject
+{
+private:
+    struct Node
+    {
+        std::atomic<Node *> next;
+        std::function<void()> callback;
+    };
+
+    // Producers push at the head, the consumer pops from the tail
+    std::atomic<Node *> head;
+    Node *tail;
+    Node stub;
+    std::atomic<bool> drainScheduled;
+
+    void push(Node *node);
+    Node *pop();
+    void drain();
+
+public:
+    HttpCompletionQueue();
+    ~HttpCompletionQueue();
+
+    // Returns the queue of the current thread, which must run a Qt event loop
+    static HttpCompletionQueue *current();
+
+    // Thread-safe, the callback is called on the thread the queue belongs to
+    void post(std::function<void()> callback);
+};
+
+struct HTTPSERVER_EXPORT HttpThreadPoolStats
+{
+    int threads;
+    // Jobs waiting for a thread
+    int queued;
+    // Jobs currently running
+    int active;
+    qint64 completed;
+    // Jobs that were run by a thread other than the one they were queued on
+    qint64 stolen;
+};
+
+// Work-stealing thread pool for CPU-heavy work that would otherwise stall the event loop, see HttpData::runOnPool
+//
+// Each thread has its own queue. Jobs submitted by a pool thread go to its own queue, other jobs are spread over the
+// queues round-robin. A thread runs the newest job of its own queue first and steals the oldest job of another queue
+// when its own is empty. Threads are started the first time a job is submitted.
+//
+// Destroying the pool waits for the running jobs to finish, jobs that have not started yet are cancelled instead.
+class HTTPSERVER_EXPORT HttpThreadPool
+{
+private:
+    struct Job
+    {
+        std::function<void()> run;
+        // Called instead of run when the pool is destroyed before the job started, may be empty
+        std::function<void()> cancel;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        std::thread thread;
+    };
+
+    HttpServerConfig *config;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::once_flag startFlag;
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> stopping;
+
+    std::atomic<int> queued;
+    std::atomic<int> active;
+    std::atomic<qint64> completed;
+    std::atomic<qint64> stolen;
+    std::atomic<unsigned int> nextWorker;
+
+    void startThreads();
+    void run(int index);
+    bool takeJob(int index, Job &job);
+
+public:
+    HttpThreadPool(HttpServerConfig *config);
+    ~HttpThreadPool();
+
+    HttpThreadPool(const HttpThreadPool &) = delete;
+    HttpThreadPool &operator=(const HttpThreadPool &) = delete;
+
+    // Thread-safe
+    // Cancel is called on the thread destroying the pool if the job is still queued by then, e.g. to reject a promise
+    void start(std::function<void()> job, std::function<void()> cancel = nullptr);
+
+    HttpThreadPoolStats stats() const;
+};
+
+#endif // HTTP_SERVER_HTTP_THREAD_POOL_H
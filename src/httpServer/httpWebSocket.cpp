@@ -0,0 +1,689 @@
+#include "httpWebSocket.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HTTP_SERVER_WEB_SOCKET_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HTTP_SERVER_WEB_SOCKET_NEON
+#endif
+
+HttpWebSocket::HttpWebSocket(QTcpSocket *socket, int compressionBits, int maxMessageSize, QObject *parent) :
+    QObject(parent), socket(socket), maxMessageSize(maxMessageSize), compressionBits(compressionBits),
+    inflateInitialized(false), inMessage(false), messageOpcode(Opcode::Text), messageCompressed(false),
+    closeSent(false)
+{
+    socket->setParent(this);
+    address = socket->peerAddress();
+
+    connect(socket, &QTcpSocket::readyRead, this, &HttpWebSocket::read);
+    connect(socket, &QTcpSocket::disconnected, this, &HttpWebSocket::socketDisconnected);
+
+    if (compressionBits > 0)
+    {
+        inflateStream.zalloc = Z_NULL;
+        inflateStream.zfree = Z_NULL;
+        inflateStream.opaque = Z_NULL;
+        inflateStream.avail_in = 0;
+        inflateStream.next_in = Z_NULL;
+
+        // Client messages can use a context across messages, so one inflate stream is kept for the whole session
+        // Negative window bits means raw deflate data, 15 handles any window size the client chooses
+        inflateInitialized = inflateInit2(&inflateStream, -15) == Z_OK;
+        if (!inflateInitialized)
+            this->compressionBits = 0;
+    }
+}
+
+void HttpWebSocket::accept(HttpDataPtr data, std::function<void(HttpWebSocket *)> onOpen, bool compression,
+    int maxMessageSize)
+{
+    HttpRequest *request = data->request;
+    HttpResponse *response = data->response;
+
+    // RFC6455 section 4.2.1 lists the requirements for the opening handshake
+    const QString upgrade = request->headerDefault("Upgrade", "");
+    const QString connection = request->headerDefault("Connection", "");
+    const QString key = request->headerDefault("Sec-WebSocket-Key", "").trimmed();
+    if (request->httpMethod() != HttpMethod::Get || !upgrade.contains("websocket", Qt::CaseInsensitive) ||
+        !connection.contains("upgrade", Qt::CaseInsensitive) || key.isEmpty())
+        throw HttpException(HttpStatus::BadRequest, "Invalid WebSocket handshake");
+
+    // Only version 13 (RFC6455) is supported, tell the client which version to use
+    if (request->headerDefault("Sec-WebSocket-Version", "").trimmed() != "13")
+    {
+        response->setError(HttpStatus::UpgradeRequired, "Unsupported WebSocket version");
+        response->setHeader("Sec-WebSocket-Version", "13");
+        return;
+    }
+
+    const QByteArray acceptKey = QCryptographicHash::hash((key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11").toLatin1(),
+        QCryptographicHash::Sha1).toBase64();
+
+    QString responseExtensions;
+    const int compressionBits = compression ?
+        negotiateCompression(request->headerDefault("Sec-WebSocket-Extensions", ""), &responseExtensions) : 0;
+
+    response->setStatus(HttpStatus::SwitchingProtocols);
+    response->setHeader("Upgrade", "websocket");
+    response->setHeader("Connection", "Upgrade");
+    response->setHeader("Sec-WebSocket-Accept", QString::fromLatin1(acceptKey));
+    if (!responseExtensions.isEmpty())
+        response->setHeader("Sec-WebSocket-Extensions", responseExtensions);
+
+    response->setUpgrade([onOpen, compressionBits, maxMessageSize](QTcpSocket *socket) {
+        HttpWebSocket *webSocket = new HttpWebSocket(socket, compressionBits, maxMessageSize);
+        onOpen(webSocket);
+
+        // Handle any frames that arrived along with the handshake
+        webSocket->read();
+    });
+}
+
+int HttpWebSocket::negotiateCompression(QString extensions, QString *responseExtensions)
+{
+    // Use the first permessage-deflate offer that we are able to accept
+    for (const QString &offer : extensions.split(','))
+    {
+        QStringList params = offer.split(';');
+        if (params[0].trimmed().compare("permessage-deflate", Qt::CaseInsensitive) != 0)
+            continue;
+
+        int windowBits = 15;
+        bool valid = true;
+        for (int i = 1; i < params.size(); ++i)
+        {
+            QString name = params[i].section('=', 0, 0).trimmed();
+            QString value = params[i].section('=', 1).trimmed().remove('"');
+
+            if (name == "server_max_window_bits")
+            {
+                bool ok;
+                windowBits = value.toInt(&ok);
+                valid &= ok && windowBits >= 8 && windowBits <= 15;
+            }
+            else if (name != "server_no_context_takeover" && name != "client_no_context_takeover" &&
+                name != "client_max_window_bits")
+            {
+                // Unknown parameter, the offer must be declined
+                valid = false;
+            }
+        }
+
+        if (!valid)
+            continue;
+
+        // zlib does not support a window size of 8 for raw deflate, 9 is the smallest allowed
+        windowBits = std::max(windowBits, 9);
+
+        // Client context takeover and window size do not matter since the client messages are inflated with the
+        // largest window
+        *responseExtensions = "permessage-deflate; server_no_context_takeover";
+        if (windowBits < 15)
+            *responseExtensions += QString("; server_max_window_bits=%1").arg(windowBits);
+
+        return windowBits;
+    }
+
+    return 0;
+}
+
+void HttpWebSocket::unmask(char *data, qint64 size, const char *mask)
+{
+    qint64 i = 0;
+
+    // The 4-byte mask repeats throughout the payload, so it can be broadcast across an entire register
+    // Note: Mask is copied from memory as-is, so the byte order is correct regardless of endianness
+    quint32 mask32;
+    std::memcpy(&mask32, mask, 4);
+
+#if defined(HTTP_SERVER_WEB_SOCKET_SSE2)
+    const __m128i maskVector = _mm_set1_epi32((int)mask32);
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&data[i]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&data[i]), _mm_xor_si128(chunk, maskVector));
+    }
+#elif defined(HTTP_SERVER_WEB_SOCKET_NEON)
+    const uint8x16_t maskVector = vreinterpretq_u8_u32(vdupq_n_u32(mask32));
+    for (; i + 16 <= size; i += 16)
+    {
+        uint8_t *chunk = reinterpret_cast<uint8_t *>(&data[i]);
+        vst1q_u8(chunk, veorq_u8(vld1q_u8(chunk), maskVector));
+    }
+#endif
+
+    // Remaining 8-byte words, this is also the fallback when no SIMD instructions are available
+    const quint64 mask64 = ((quint64)mask32 << 32) | mask32;
+    for (; i + 8 <= size; i += 8)
+    {
+        quint64 word;
+        std::memcpy(&word, &data[i], 8);
+        word ^= mask64;
+        std::memcpy(&data[i], &word, 8);
+    }
+
+    // Remaining bytes, index is a multiple of 4 at this point so the mask lines up
+    for (; i < size; ++i)
+        data[i] ^= mask[i % 4];
+}
+
+bool HttpWebSocket::isValidUtf8(const char *data, qint64 size)
+{
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    qint64 i = 0;
+
+    while (i < size)
+    {
+        // Skip over ASCII 8 bytes at a time, most text messages are mostly ASCII
+        if (i + 8 <= size)
+        {
+            quint64 word;
+            std::memcpy(&word, &bytes[i], 8);
+            if ((word & 0x8080808080808080ull) == 0)
+            {
+                i += 8;
+                continue;
+            }
+        }
+
+        const unsigned char lead = bytes[i];
+        if (lead < 0x80)
+        {
+            ++i;
+            continue;
+        }
+
+        // Valid ranges of the second byte are narrowed for the lead bytes that could otherwise encode overlong forms,
+        // surrogates (U+D800 to U+DFFF) or code points above U+10FFFF
+        int length;
+        unsigned char min = 0x80;
+        unsigned char max = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF)
+            length = 2;
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            length = 3;
+            if (lead == 0xE0)
+                min = 0xA0;
+            else if (lead == 0xED)
+                max = 0x9F;
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            length = 4;
+            if (lead == 0xF0)
+                min = 0x90;
+            else if (lead == 0xF4)
+                max = 0x8F;
+        }
+        else
+            return false;
+
+        if (size - i < length || bytes[i + 1] < min || bytes[i + 1] > max)
+            return false;
+
+        for (int j = 2; j < length; ++j)
+        {
+            if ((bytes[i + j] & 0xC0) != 0x80)
+                return false;
+        }
+
+        i += length;
+    }
+
+    return true;
+}
+
+QByteArray HttpWebSocket::buildFrame(Opcode opcode, const QByteArray &payload, bool compressed)
+{
+    QByteArray frame;
+    frame.reserve(payload.size() + 10);
+
+    // Messages from the server are always sent in a single frame (FIN bit set) and are not masked
+    // RSV1 bit signals that the message is compressed
+    frame += char(0x80 | (compressed ? 0x40 : 0x00) | int(opcode));
+
+    const qint64 size = payload.size();
+    if (size < 126)
+        frame += char(size);
+    else if (size <= 0xFFFF)
+    {
+        frame += char(126);
+        frame += char((size >> 8) & 0xFF);
+        frame += char(size & 0xFF);
+    }
+    else
+    {
+        frame += char(127);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            frame += char((size >> shift) & 0xFF);
+    }
+
+    frame += payload;
+    return frame;
+}
+
+QByteArray HttpWebSocket::deflateMessage(const QByteArray &payload, int windowBits)
+{
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+
+    // Negative window bits means raw deflate data without a zlib header or trailer
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return QByteArray();
+
+    const int chunkSize = std::min(std::max((int)qNextPowerOfTwo(payload.size()), 1024), 128 * 1024);
+    QByteArray ret;
+
+    stream.avail_in = (unsigned int)payload.size();
+    stream.next_in = (unsigned char *)payload.data();
+
+    do
+    {
+        const int offset = ret.size();
+        ret.resize(offset + chunkSize);
+
+        stream.avail_out = (unsigned int)chunkSize;
+        stream.next_out = (unsigned char *)&ret.data()[offset];
+
+        deflate(&stream, Z_SYNC_FLUSH);
+        ret.resize(offset + chunkSize - (int)stream.avail_out);
+    } while (stream.avail_out == 0);
+
+    deflateEnd(&stream);
+
+    // RFC7692 section 7.2.1 states that the empty block from the sync flush (0x00 0x00 0xFF 0xFF) is removed
+    if (ret.endsWith(QByteArray("\x00\x00\xFF\xFF", 4)))
+        ret.chop(4);
+
+    return ret;
+}
+
+void HttpWebSocket::read()
+{
+    buffer += socket->readAll();
+
+    while (parseFrame())
+        ;
+}
+
+bool HttpWebSocket::parseFrame()
+{
+    // Need at least the first two bytes of the header
+    if (closeSent || buffer.size() < 2)
+        return false;
+
+    const unsigned char *header = reinterpret_cast<const unsigned char *>(buffer.constData());
+    const bool fin = header[0] & 0x80;
+    const bool rsv1 = header[0] & 0x40;
+    const Opcode opcode = Opcode(header[0] & 0x0F);
+    const bool masked = header[1] & 0x80;
+
+    quint64 payloadSize = header[1] & 0x7F;
+    int headerSize = 2;
+    if (payloadSize == 126)
+    {
+        if (buffer.size() < 4)
+            return false;
+
+        payloadSize = (quint64(header[2]) << 8) | header[3];
+        headerSize = 4;
+    }
+    else if (payloadSize == 127)
+    {
+        if (buffer.size() < 10)
+            return false;
+
+        payloadSize = 0;
+        for (int i = 2; i < 10; ++i)
+            payloadSize = (payloadSize << 8) | header[i];
+        headerSize = 10;
+
+        // RFC6455 section 5.2 states that the most significant bit of a 64-bit length must be 0
+        if (payloadSize >> 63)
+        {
+            fail(1002, "Invalid payload length");
+            return false;
+        }
+    }
+
+    // RFC6455 section 5.1 states that the server must close the connection if a client frame is not masked
+    if (!masked)
+    {
+        fail(1002, "Client frames must be masked");
+        return false;
+    }
+
+    // RSV2 & RSV3 are not used, RSV1 is only used when compression is enabled
+    if ((header[0] & 0x30) || (rsv1 && compressionBits == 0))
+    {
+        fail(1002, "Reserved bits must not be set");
+        return false;
+    }
+
+    // RFC6455 section 5.5 states that control frames must not be fragmented and can be at most 125 bytes
+    const bool control = int(opcode) & 0x8;
+    if (control && (!fin || payloadSize > 125 || rsv1))
+    {
+        fail(1002, "Invalid control frame");
+        return false;
+    }
+
+    // Note: Compared against the space left so a huge length can not overflow, control frames are not part of the
+    // message
+    if (!control && payloadSize > (quint64)std::max(maxMessageSize - message.size(), 0))
+    {
+        fail(1009, "Message is too large");
+        return false;
+    }
+
+    // Wait for the rest of the frame
+    // Note: Payload size is at most maxMessageSize at this point
+    const int payloadIndex = headerSize + 4;
+    if ((quint64)buffer.size() < payloadIndex + payloadSize)
+        return false;
+
+    // Unmask the payload in place
+    char *payload = &buffer.data()[payloadIndex];
+    unmask(payload, (qint64)payloadSize, &buffer.constData()[headerSize]);
+
+    if (control)
+    {
+        QByteArray controlPayload(payload, (int)payloadSize);
+        buffer.remove(0, payloadIndex + (int)payloadSize);
+        handleControlFrame(opcode, controlPayload);
+        return true;
+    }
+
+    if (opcode == Opcode::Continuation)
+    {
+        if (!inMessage)
+        {
+            fail(1002, "Continuation frame without a message");
+            return false;
+        }
+    }
+    else if (opcode == Opcode::Text || opcode == Opcode::Binary)
+    {
+        if (inMessage)
+        {
+            fail(1002, "Expected continuation frame");
+            return false;
+        }
+
+        // RSV1 is only set on the first frame of a compressed message
+        inMessage = true;
+        messageOpcode = opcode;
+        messageCompressed = rsv1;
+        message.clear();
+    }
+    else
+    {
+        fail(1002, "Unknown opcode");
+        return false;
+    }
+
+    message.append(payload, (int)payloadSize);
+    buffer.remove(0, payloadIndex + (int)payloadSize);
+
+    if (fin)
+        handleMessage();
+
+    return true;
+}
+
+void HttpWebSocket::handleControlFrame(Opcode opcode, QByteArray payload)
+{
+    switch (opcode)
+    {
+        case Opcode::Ping:
+            sendFrame(buildFrame(Opcode::Pong, payload));
+            break;
+
+        case Opcode::Pong:
+            emit pong(payload);
+            break;
+
+        case Opcode::Close:
+        {
+            // Echo the status code back to the client and close the connection
+            quint16 code = 1000;
+            if (payload.size() >= 2)
+                code = quint16((quint8(payload[0]) << 8) | quint8(payload[1]));
+
+            // Reason following the code must be UTF-8 as well
+            if (payload.size() > 2 && !isValidUtf8(payload.constData() + 2, payload.size() - 2))
+            {
+                fail(1007, "Invalid UTF-8 in close reason");
+                break;
+            }
+
+            close(code);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void HttpWebSocket::handleMessage()
+{
+    inMessage = false;
+
+    if (messageCompressed && !inflateMessage(message))
+    {
+        fail(1007, "Unable to decompress message");
+        return;
+    }
+
+    QByteArray data = message;
+    message.clear();
+
+    // RFC6455 section 8.1 states that the connection must be failed if a text message is not valid UTF-8
+    if (messageOpcode == Opcode::Text && !isValidUtf8(data.constData(), data.size()))
+    {
+        fail(1007, "Invalid UTF-8 in text message");
+        return;
+    }
+
+    if (messageOpcode == Opcode::Text)
+        emit textMessageReceived(QString::fromUtf8(data));
+    else
+        emit binaryMessageReceived(data);
+}
+
+bool HttpWebSocket::inflateMessage(QByteArray &data)
+{
+    if (!inflateInitialized)
+        return false;
+
+    // RFC7692 section 7.2.2 states that the empty block removed by the sender must be appended back
+    data.append("\x00\x00\xFF\xFF", 4);
+
+    const int chunkSize = std::min(std::max((int)qNextPowerOfTwo(data.size() * 2), 1024), 128 * 1024);
+    QByteArray ret;
+
+    inflateStream.avail_in = (unsigned int)data.size();
+    inflateStream.next_in = (unsigned char *)data.data();
+
+    do
+    {
+        const int offset = ret.size();
+        ret.resize(offset + chunkSize);
+
+        inflateStream.avail_out = (unsigned int)chunkSize;
+        inflateStream.next_out = (unsigned char *)&ret.data()[offset];
+
+        int err = inflate(&inflateStream, Z_SYNC_FLUSH);
+        ret.resize(offset + chunkSize - (int)inflateStream.avail_out);
+
+        if (err != Z_OK && err != Z_BUF_ERROR)
+            return false;
+
+        // Protect against compression bombs
+        if (ret.size() > maxMessageSize)
+            return false;
+    } while (inflateStream.avail_out == 0);
+
+    data = ret;
+    return true;
+}
+
+void HttpWebSocket::fail(quint16 code, QString reason)
+{
+    close(code, reason);
+    buffer.clear();
+    message.clear();
+}
+
+void HttpWebSocket::sendMessage(Opcode opcode, const QByteArray &payload)
+{
+    if (compressionBits > 0 && payload.size() >= compressionMinSize)
+        sendFrame(buildFrame(opcode, deflateMessage(payload, compressionBits), true));
+    else
+        sendFrame(buildFrame(opcode, payload));
+}
+
+QHostAddress HttpWebSocket::peerAddress() const
+{
+    return address;
+}
+
+int HttpWebSocket::compressionWindowBits() const
+{
+    return compressionBits;
+}
+
+qint64 HttpWebSocket::bytesToWrite() const
+{
+    return socket->bytesToWrite();
+}
+
+void HttpWebSocket::sendText(QString message)
+{
+    sendMessage(Opcode::Text, message.toUtf8());
+}
+
+void HttpWebSocket::sendBinary(QByteArray message)
+{
+    sendMessage(Opcode::Binary, message);
+}
+
+void HttpWebSocket::sendFrame(const QByteArray &frame)
+{
+    // Nothing can be sent after the close frame
+    if (closeSent)
+        return;
+
+    socket->write(frame);
+}
+
+void HttpWebSocket::ping(QByteArray payload)
+{
+    sendFrame(buildFrame(Opcode::Ping, payload.left(125)));
+}
+
+void HttpWebSocket::close(quint16 code, QString reason)
+{
+    if (closeSent)
+        return;
+
+    // Close payload is the status code followed by a UTF-8 reason, control frames are limited to 125 bytes
+    QByteArray payload;
+    payload += char((code >> 8) & 0xFF);
+    payload += char(code & 0xFF);
+    payload += reason.toUtf8().left(123);
+
+    sendFrame(buildFrame(Opcode::Close, payload));
+    closeSent = true;
+
+    // Disconnects once all of the pending data is written
+    socket->disconnectFromHost();
+}
+
+void HttpWebSocket::socketDisconnected()
+{
+    emit disconnected();
+    deleteLater();
+}
+
+HttpWebSocket::~HttpWebSocket()
+{
+    if (inflateInitialized)
+        inflateEnd(&inflateStream);
+}
+
+HttpWebSocketBroadcaster::HttpWebSocketBroadcaster(qint64 maxBacklog, QObject *parent) : QObject(parent),
+    maxBacklog(maxBacklog)
+{
+}
+
+void HttpWebSocketBroadcaster::add(HttpWebSocket *socket)
+{
+    sockets.push_back(socket);
+
+    // Sessions delete themselves once disconnected
+    connect(socket, &HttpWebSocket::disconnected, this, [this, socket]() {
+        remove(socket);
+    });
+}
+
+void HttpWebSocketBroadcaster::remove(HttpWebSocket *socket)
+{
+    auto it = std::find(sockets.begin(), sockets.end(), socket);
+    if (it != sockets.end())
+        sockets.erase(it);
+}
+
+int HttpWebSocketBroadcaster::count() const
+{
+    return (int)sockets.size();
+}
+
+void HttpWebSocketBroadcaster::sendText(QString message)
+{
+    broadcast(HttpWebSocket::Opcode::Text, message.toUtf8());
+}
+
+void HttpWebSocketBroadcaster::sendBinary(QByteArray message)
+{
+    broadcast(HttpWebSocket::Opcode::Binary, message);
+}
+
+void HttpWebSocketBroadcaster::broadcast(HttpWebSocket::Opcode opcode, const QByteArray &payload)
+{
+    // Server frames are not masked, so the same frame is written to every session
+    // The compressed frame is only built if a session negotiated compression, sessions that asked for a smaller
+    // window get the uncompressed frame instead (compressing a message is optional in permessage-deflate)
+    const QByteArray frame = HttpWebSocket::buildFrame(opcode, payload);
+    QByteArray compressedFrame;
+
+    // Copy the list since closing a session can remove it from the list
+    const std::vector<HttpWebSocket *> currentSockets = sockets;
+    for (HttpWebSocket *socket : currentSockets)
+    {
+        // Close sessions that can't keep up rather than buffering an unbounded amount of messages for them
+        if (maxBacklog > 0 && socket->bytesToWrite() + frame.size() > maxBacklog)
+        {
+            socket->close(1008, "Too slow to receive messages");
+            remove(socket);
+            continue;
+        }
+
+        if (socket->compressionWindowBits() == 15 && payload.size() >= HttpWebSocket::compressionMinSize)
+        {
+            if (compressedFrame.isEmpty())
+                compressedFrame = HttpWebSocket::buildFrame(opcode, HttpWebSocket::deflateMessage(payload), true);
+
+            socket->sendFrame(compressedFrame);
+        }
+        else
+            socket->sendFrame(frame);
+    }
+}
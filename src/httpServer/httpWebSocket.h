@@ -0,0 +1,130 @@
+#ifndef HTTP_SERVER_HTTP_WEB_SOCKET_H
+#define HTTP_SERVER_HTTP_WEB_SOCKET_H
+
+#include "const.h"
+#include "httpData.h"
+#include "httpRequest.h"
+#include "httpResponse.h"
+#include "util.h"
+
+#include <functional>
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QString>
+#include <QTcpSocket>
+#include <vector>
+
+
+// WebSocket session (RFC6455) created from an upgraded HTTP connection
+//
+// Supports the permessage-deflate extension (RFC7692). Messages sent by the server are compressed independently of
+// each other (server_no_context_takeover), so a compressed frame can be shared between clients.
+//
+// The session is deleted automatically once the socket is disconnected
+class HTTPSERVER_EXPORT HttpWebSocket : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Opcode
+    {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xA
+    };
+
+    // Messages smaller than this are not worth compressing
+    static const int compressionMinSize = 256;
+
+private:
+    QTcpSocket *socket;
+    QHostAddress address;
+    QByteArray buffer;
+    int maxMessageSize;
+
+    // Window bits used for permessage-deflate, 0 if the extension was not negotiated
+    int compressionBits;
+    z_stream inflateStream;
+    bool inflateInitialized;
+
+    // Fragmented message that is currently being received
+    bool inMessage;
+    Opcode messageOpcode;
+    bool messageCompressed;
+    QByteArray message;
+
+    bool closeSent;
+
+    bool parseFrame();
+    void handleControlFrame(Opcode opcode, QByteArray payload);
+    void handleMessage();
+    bool inflateMessage(QByteArray &data);
+    void fail(quint16 code, QString reason);
+    void sendMessage(Opcode opcode, const QByteArray &payload);
+
+    static int negotiateCompression(QString extensions, QString *responseExtensions);
+
+private slots:
+    void read();
+    void socketDisconnected();
+
+public:
+    HttpWebSocket(QTcpSocket *socket, int compressionBits, int maxMessageSize, QObject *parent = nullptr);
+    ~HttpWebSocket();
+
+    // Accepts a WebSocket opening handshake, onOpen is called with the session once the handshake response is sent
+    static void accept(HttpDataPtr data, std::function<void(HttpWebSocket *)> onOpen, bool compression = true,
+        int maxMessageSize = 16 * 1024 * 1024);
+
+    static void unmask(char *data, qint64 size, const char *mask);
+    // Checks for well-formed UTF-8 (RFC3629), overlong encodings & surrogates are rejected
+    static bool isValidUtf8(const char *data, qint64 size);
+    static QByteArray buildFrame(Opcode opcode, const QByteArray &payload, bool compressed = false);
+    static QByteArray deflateMessage(const QByteArray &payload, int windowBits = 15);
+
+    QHostAddress peerAddress() const;
+    int compressionWindowBits() const;
+    qint64 bytesToWrite() const;
+
+    void sendText(QString message);
+    void sendBinary(QByteArray message);
+    void sendFrame(const QByteArray &frame);
+    void ping(QByteArray payload = QByteArray());
+    void close(quint16 code = 1000, QString reason = "");
+
+signals:
+    void textMessageReceived(QString message);
+    void binaryMessageReceived(QByteArray message);
+    void pong(QByteArray payload);
+    void disconnected();
+};
+
+// Sends messages to a group of WebSocket sessions, each frame is built (and compressed) once for all of them
+class HTTPSERVER_EXPORT HttpWebSocketBroadcaster : public QObject
+{
+    Q_OBJECT
+
+private:
+    std::vector<HttpWebSocket *> sockets;
+    qint64 maxBacklog;
+
+    void broadcast(HttpWebSocket::Opcode opcode, const QByteArray &payload);
+
+public:
+    // Sessions with more than maxBacklog bytes waiting to be written are closed instead of sent more messages
+    HttpWebSocketBroadcaster(qint64 maxBacklog = 1024 * 1024, QObject *parent = nullptr);
+
+    void add(HttpWebSocket *socket);
+    void remove(HttpWebSocket *socket);
+    int count() const;
+
+    void sendText(QString message);
+    void sendBinary(QByteArray message);
+};
+
+#endif // HTTP_SERVER_HTTP_WEB_SOCKET_H
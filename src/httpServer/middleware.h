@@ -2,6 +2,7 @@
 #define HTTP_SERVER_MIDDLEWARE_H
 
 #include "const.h"
+#include "httpContext.h"
 #include "httpData.h"
 #include "httpRequest.h"
 #include "httpResponse.h"
@@ -9,6 +10,7 @@
 #include <memory>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QJsonObject>
 #include <QString>
 
 // Synchronous vs Asynchronous Middleware
@@ -27,6 +29,16 @@
 //              middleware3(data);
 //          });
 //
+// Middleware can also be given to HttpRequestRouter::addRoute & addPath, where it is composed with the handler once
+// when the route is added:
+//          router.addRoute("GET", "^/data/?$", {middleware::CORS, middleware::verifyJson}, handler);
+//
+// Unlike a .then chain, a route's middleware list stops as soon as a middleware sets the response status. The rest of
+// the middleware & the handler are skipped and that response is sent, e.g. CORS answering a pre-flight OPTIONS
+// request. Middleware that only adds headers must therefore not set the status, and a middleware list that relied on
+// the handler running anyway should call the middleware from the handler instead. Throwing an HttpException stops the
+// chain as well.
+//
 namespace middleware
 {
     // Synchronous Middleware
@@ -36,6 +48,20 @@ namespace middleware
     HttpPromise getObject(HttpDataPtr data);
     HttpPromise checkAuthBasic(HttpDataPtr data, QString validUsername, QString validPassword);
 
+    // Context keys for the values set by the middleware, e.g. data->get(middleware::requestObject)
+    extern const HttpContextKey<QJsonObject> requestObject;
+    extern const HttpContextKey<QJsonArray> requestArray;
+    extern const HttpContextKey<QString> authUsername;
+    extern const HttpContextKey<QString> authPassword;
+
+    // Stores the values in data->state under the same names as well, e.g. data->state["requestObject"], for handlers
+    // written against older versions. Off by default since it hashes & boxes the values for every request, handlers
+    // should move to the context keys instead:
+    //          data->state["requestObject"].toJsonObject()  ->  *data->get(middleware::requestObject)
+    //          data->state["authUsername"].toString()       ->  data->context.value(middleware::authUsername)
+    void setStoreInState(bool enabled);
+    bool isStoringInState();
+
     // Asynchronous Middleware
 }
 
@@ -8,7 +8,10 @@ HttpPromise CORS(HttpDataPtr data)
     data->response->setHeader("Access-Control-Allow-Origin", data->request->headerDefault("Origin", "*"));
     data->response->setHeader("Access-Control-Allow-Credentials", "true");
 
-    if (data->request->method() == "OPTIONS")
+    // Origin is echoed back, so caches must keep a separate response for each origin
+    data->response->addVaryHeader("Origin");
+
+    if (data->request->httpMethod() == HttpMethod::Options)
     {
         // Pre-flight request, send additional headers
         data->response->setHeader("Access-Control-Allow-Methods", "POST, GET, OPTIONS, PUT, DELETE");
@@ -3,6 +3,9 @@
 namespace middleware
 {
 
+const HttpContextKey<QString> authUsername;
+const HttpContextKey<QString> authPassword;
+
 HttpPromise checkAuthBasic(HttpDataPtr data, QString validUsername, QString validPassword)
 {
     QString auth;
@@ -20,8 +23,14 @@ HttpPromise checkAuthBasic(HttpDataPtr data, QString validUsername, QString vali
                 // Verify username and password are correct
                 if (username == validUsername && password == validPassword)
                 {
-                    data->state["authUsername"] = username;
-                    data->state["authPassword"] = password;
+                    data->set(authUsername, username);
+                    data->set(authPassword, password);
+                    if (isStoringInState())
+                    {
+                        data->state["authUsername"] = username;
+                        data->state["authPassword"] = password;
+                    }
+
                     return HttpPromise::resolve(data);
                 }
             }
@@ -3,6 +3,8 @@
 namespace middleware
 {
 
+const HttpContextKey<QJsonArray> requestArray;
+
 HttpPromise getArray(HttpDataPtr data)
 {
     QJsonDocument jsonDocument = data->request->parseJsonBody();
@@ -10,7 +12,10 @@ HttpPromise getArray(HttpDataPtr data)
         throw HttpException(HttpStatus::BadRequest, "Invalid JSON");
 
     QJsonArray requestJson = jsonDocument.array();
-    data->state["requestArray"] = requestJson;
+    data->set(requestArray, requestJson);
+    if (isStoringInState())
+        data->state["requestArray"] = requestJson;
+
     return HttpPromise::resolve(data);
 }
 
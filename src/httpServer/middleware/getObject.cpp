@@ -3,6 +3,8 @@
 namespace middleware
 {
 
+const HttpContextKey<QJsonObject> requestObject;
+
 HttpPromise getObject(HttpDataPtr data)
 {
     QJsonDocument jsonDocument = data->request->parseJsonBody();
@@ -10,7 +12,10 @@ HttpPromise getObject(HttpDataPtr data)
         throw HttpException(HttpStatus::BadRequest, "Invalid JSON");
 
     QJsonObject requestJson = jsonDocument.object();
-    data->state["requestObject"] = requestJson;
+    data->set(requestObject, requestJson);
+    if (isStoringInState())
+        data->state["requestObject"] = requestJson;
+
     return HttpPromise::resolve(data);
 }
 
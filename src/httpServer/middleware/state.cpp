@@ -0,0 +1,23 @@
+#include "../middleware.h"
+
+#include <atomic>
+
+namespace middleware
+{
+
+namespace
+{
+    std::atomic<bool> storeInState(false);
+}
+
+void setStoreInState(bool enabled)
+{
+    storeInState = enabled;
+}
+
+bool isStoringInState()
+{
+    return storeInState;
+}
+
+}
@@ -1,5 +1,8 @@
 #include "util.h"
 
+#include <utility>
+#include <vector>
+
 QString getHttpStatusStr(HttpStatus status)
 {
     auto it = httpStatusStrs.find(static_cast<int>(status));
@@ -9,6 +12,166 @@ QString getHttpStatusStr(HttpStatus status)
     return it->second;
 }
 
+namespace
+{
+    const std::pair<HttpMethod, QString> builtinMethods[] {
+        {HttpMethod::Get, "GET"},
+        {HttpMethod::Head, "HEAD"},
+        {HttpMethod::Post, "POST"},
+        {HttpMethod::Put, "PUT"},
+        {HttpMethod::Delete, "DELETE"},
+        {HttpMethod::Options, "OPTIONS"},
+        {HttpMethod::Patch, "PATCH"}
+    };
+
+    // Name of each registered custom method, the index is the bit offset from HttpMethod::FirstCustom
+    std::vector<QByteArray> customMethods;
+
+    HttpMethod customMethod(size_t index)
+    {
+        return static_cast<HttpMethod>(static_cast<uint>(HttpMethod::FirstCustom) << index);
+    }
+}
+
+HttpMethod parseHttpMethod(const QByteArray &name)
+{
+    // Checking the length first leaves at most two comparisons for the built-in methods
+    switch (name.size())
+    {
+        case 3:
+            if (name == "GET") return HttpMethod::Get;
+            if (name == "PUT") return HttpMethod::Put;
+            break;
+
+        case 4:
+            if (name == "POST") return HttpMethod::Post;
+            if (name == "HEAD") return HttpMethod::Head;
+            break;
+
+        case 5:
+            if (name == "PATCH") return HttpMethod::Patch;
+            break;
+
+        case 6:
+            if (name == "DELETE") return HttpMethod::Delete;
+            break;
+
+        case 7:
+            if (name == "OPTIONS") return HttpMethod::Options;
+            break;
+    }
+
+    for (size_t i = 0; i < customMethods.size(); ++i)
+    {
+        if (customMethods[i] == name)
+            return customMethod(i);
+    }
+
+    return HttpMethod::None;
+}
+
+HttpMethod parseHttpMethod(const QString &name)
+{
+    return parseHttpMethod(name.toLatin1());
+}
+
+QString getHttpMethodStr(HttpMethod method)
+{
+    for (const auto &builtin : builtinMethods)
+    {
+        if (builtin.first == method)
+            return builtin.second;
+    }
+
+    for (size_t i = 0; i < customMethods.size(); ++i)
+    {
+        if (customMethod(i) == method)
+            return QString::fromLatin1(customMethods[i]);
+    }
+
+    return "";
+}
+
+QString getHttpMethodsStr(HttpMethods methods)
+{
+    QString str;
+    for (uint bit = 1; bit != 0; bit <<= 1)
+    {
+        const HttpMethod method = static_cast<HttpMethod>(bit);
+        if (!methods.testFlag(method))
+            continue;
+
+        const QString name = getHttpMethodStr(method);
+        if (name.isEmpty())
+            continue;
+
+        if (!str.isEmpty())
+            str += ", ";
+
+        str += name;
+    }
+
+    return str;
+}
+
+HttpMethods knownHttpMethods()
+{
+    HttpMethods methods;
+    for (const auto &builtin : builtinMethods)
+        methods |= builtin.first;
+
+    for (size_t i = 0; i < customMethods.size(); ++i)
+        methods |= customMethod(i);
+
+    return methods;
+}
+
+HttpMethod registerHttpMethod(const QString &name)
+{
+    const HttpMethod existing = parseHttpMethod(name);
+    if (existing != HttpMethod::None)
+        return existing;
+
+    if (customMethod(customMethods.size()) == HttpMethod::None)
+        return HttpMethod::None;
+
+    customMethods.push_back(name.toLatin1());
+    return customMethod(customMethods.size() - 1);
+}
+
+float acceptEncodingQuality(const QString &acceptEncoding, const QString &encoding)
+{
+    // Quality of the wildcard coding (*), applies to any coding that is not explicitly listed
+    float wildcardQuality = 0.0f;
+
+    for (const QString &part : acceptEncoding.split(','))
+    {
+        // Each coding can be followed by parameters, the only one we care about is the quality value (q=)
+        QStringList params = part.split(';');
+        QString coding = params[0].trimmed();
+        if (coding.isEmpty())
+            continue;
+
+        float quality = 1.0f;
+        for (int i = 1; i < params.size(); ++i)
+        {
+            QString param = params[i].trimmed();
+            if (param.startsWith("q=", Qt::CaseInsensitive))
+                quality = param.mid(2).toFloat();
+        }
+
+        // RFC7230 section 4.2.3 states that x-gzip should be treated as gzip
+        if (coding.compare(encoding, Qt::CaseInsensitive) == 0 ||
+            (encoding.compare("gzip", Qt::CaseInsensitive) == 0 && coding.compare("x-gzip", Qt::CaseInsensitive) == 0))
+            return quality;
+
+        if (coding == "*")
+            wildcardQuality = quality;
+    }
+
+    return wildcardQuality;
+}
+
 QByteArray gzipCompress(QByteArray &data, int compressionLevel)
 {
     QByteArray ret;
@@ -108,3 +271,70 @@ QByteArray gzipUncompress(QByteArray &data)
     inflateEnd(&stream);
     return ret;
 }
+
+GzipCompressor::GzipCompressor(int compressionLevel) : finished(false)
+{
+    if (compressionLevel < -1 || compressionLevel > 9)
+        compressionLevel = -1;
+
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+
+    // Use default memory level (8)
+    // Use default window bits (15) but add 16 to make output gzip instead of zlib format
+    valid = deflateInit2(&stream, compressionLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+GzipCompressor::~GzipCompressor()
+{
+    if (valid)
+        deflateEnd(&stream);
+}
+
+bool GzipCompressor::isValid() const
+{
+    return valid;
+}
+
+bool GzipCompressor::isFinished() const
+{
+    return finished;
+}
+
+bool GzipCompressor::compress(const char *data, int size, QByteArray &out, int flush)
+{
+    if (!valid || finished)
+        return false;
+
+    // Output is usually smaller than the input, use the input size as a starting point but clamp between 1024 bytes
+    // and 128kB
+    const int chunkSize = std::min(std::max((int)qNextPowerOfTwo(size), 1024), 128 * 1024);
+
+    // Point stream to input data
+    stream.avail_in = (unsigned int)size;
+    stream.next_in = (unsigned char *)data;
+
+    // Keep deflating until zlib has room left over in the output, meaning all of the input has been consumed
+    int err;
+    do
+    {
+        const int offset = out.size();
+        out.resize(offset + chunkSize);
+
+        stream.avail_out = (unsigned int)chunkSize;
+        stream.next_out = (unsigned char *)&out.data()[offset];
+
+        err = deflate(&stream, flush);
+        out.resize(offset + chunkSize - (int)stream.avail_out);
+
+        if (err == Z_STREAM_ERROR)
+        {
+            valid = false;
+            return false;
+        }
+    } while (stream.avail_out == 0);
+
+    finished = err == Z_STREAM_END;
+    return true;
+}
@@ -4,7 +4,10 @@
 #include <algorithm>
 #include <functional>
 #include <map>
+#include <QByteArray>
+#include <QFlags>
 #include <QString>
+#include <QStringList>
 #include <QHash>
 #include <QtCore/qglobal.h>
 #include <QtMath>
@@ -94,6 +97,27 @@ enum class HttpStatus
     NetworkConnectTimeoutError = 599,
 };
 
+// Request methods are flags so that the methods a route accepts are a single mask
+// Custom methods (e.g. WebDAV's PROPFIND) are assigned one of the remaining bits by registerHttpMethod
+enum class HttpMethod : uint
+{
+    None = 0,
+
+    Get = 1 << 0,
+    Head = 1 << 1,
+    Post = 1 << 2,
+    Put = 1 << 3,
+    Delete = 1 << 4,
+    Options = 1 << 5,
+    Patch = 1 << 6,
+
+    FirstCustom = 1 << 8,
+    LastCustom = 1u << 31
+};
+
+Q_DECLARE_FLAGS(HttpMethods, HttpMethod)
+Q_DECLARE_OPERATORS_FOR_FLAGS(HttpMethods)
+
 /* Status Codes */
 
 static const std::map<int, QString> httpStatusStrs {
@@ -234,7 +258,46 @@ namespace std
 
 HTTPSERVER_EXPORT QString getHttpStatusStr(HttpStatus status);
 
+// Method names are case-sensitive, returns HttpMethod::None for unknown methods
+HTTPSERVER_EXPORT HttpMethod parseHttpMethod(const QByteArray &name);
+HTTPSERVER_EXPORT HttpMethod parseHttpMethod(const QString &name);
+HTTPSERVER_EXPORT QString getHttpMethodStr(HttpMethod method);
+// Comma-separated list of methods as used by the Allow header, e.g. "GET, HEAD"
+HTTPSERVER_EXPORT QString getHttpMethodsStr(HttpMethods methods);
+// Built-in methods along with all registered custom methods
+HTTPSERVER_EXPORT HttpMethods knownHttpMethods();
+
+// Registers a custom method so requests using it are accepted & can be routed, returns the flag for the method
+// Returns HttpMethod::None if all custom flags are used up
+// Note: Not thread-safe, register custom methods before starting the server
+HTTPSERVER_EXPORT HttpMethod registerHttpMethod(const QString &name);
+HTTPSERVER_EXPORT float acceptEncodingQuality(const QString &acceptEncoding, const QString &encoding);
+
 QByteArray gzipCompress(QByteArray &data, int compressionLevel = Z_DEFAULT_COMPRESSION);
 QByteArray gzipUncompress(QByteArray &data);
 
+// Compresses data into GZIP format incrementally, allowing the output to be sent before all of the data is available
+class HTTPSERVER_EXPORT GzipCompressor
+{
+private:
+    z_stream stream;
+    bool valid;
+    bool finished;
+
+public:
+    GzipCompressor(int compressionLevel = Z_DEFAULT_COMPRESSION);
+    ~GzipCompressor();
+
+    GzipCompressor(const GzipCompressor &) = delete;
+    GzipCompressor &operator=(const GzipCompressor &) = delete;
+
+    bool isValid() const;
+    bool isFinished() const;
+
+    // Appends the compressed output to out
+    // Flush is passed to zlib, use Z_SYNC_FLUSH to make all of the data so far decompressable by the client and
+    // Z_FINISH for the last piece of data to write the GZIP trailer
+    bool compress(const char *data, int size, QByteArray &out, int flush = Z_NO_FLUSH);
+};
+
 #endif // HTTP_SERVER_UTIL_H
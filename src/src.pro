@@ -26,30 +26,58 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+        httpServer/httpArena.cpp \
         httpServer/httpConnection.cpp \
+        httpServer/httpContext.cpp \
         httpServer/httpData.cpp \
+        httpServer/httpDataRate.cpp \
+        httpServer/httpEventBroadcaster.cpp \
+        httpServer/httpJsonWriter.cpp \
+        httpServer/httpMemoryBudget.cpp \
+        httpServer/httpMimeType.cpp \
         httpServer/httpRequest.cpp \
         httpServer/httpRequestRouter.cpp \
         httpServer/httpResponse.cpp \
+        httpServer/httpResponseCache.cpp \
+        httpServer/httpResult.cpp \
         httpServer/httpServer.cpp \
+        httpServer/httpTask.cpp \
+        httpServer/httpTemplate.cpp \
+        httpServer/httpThreadPool.cpp \
+        httpServer/httpWebSocket.cpp \
         httpServer/middleware/CORS.cpp \
         httpServer/middleware/auth.cpp \
         httpServer/middleware/getArray.cpp \
         httpServer/middleware/getObject.cpp \
+        httpServer/middleware/state.cpp \
         httpServer/middleware/verifyJson.cpp \
         httpServer/util.cpp
 
 HEADERS += \
         httpServer/const.h \
+        httpServer/httpArena.h \
         httpServer/httpConnection.h \
+        httpServer/httpContext.h \
         httpServer/httpCookie.h \
         httpServer/httpData.h \
+        httpServer/httpDataRate.h \
+        httpServer/httpEventBroadcaster.h \
+        httpServer/httpJsonWriter.h \
+        httpServer/httpMemoryBudget.h \
+        httpServer/httpMimeType.h \
+        httpServer/httpObjectPool.h \
         httpServer/httpRequest.h \
         httpServer/httpRequestHandler.h \
         httpServer/httpRequestRouter.h \
         httpServer/httpResponse.h \
+        httpServer/httpResponseCache.h \
+        httpServer/httpResult.h \
         httpServer/httpServer.h \
         httpServer/httpServerConfig.h \
+        httpServer/httpTask.h \
+        httpServer/httpTemplate.h \
+        httpServer/httpThreadPool.h \
+        httpServer/httpWebSocket.h \
         httpServer/middleware.h \
         httpServer/util.h
 
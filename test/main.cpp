@@ -13,6 +13,8 @@ int main(int argc, char *argv[])
     config.responseTimeout = 5;
     config.verbosity = HttpServerConfig::Verbose::All;
     config.maxMultipartSize = 512 * 1024 * 1024;
+    config.autoCompression = true;
+    config.responseCacheSize = 4 * 1024 * 1024;
     config.errorDocumentMap[HttpStatus::NotFound] = "data/404_2.html";
     config.errorDocumentMap[HttpStatus::InternalServerError] = "data/404_2.html";
     config.errorDocumentMap[HttpStatus::BadGateway] = "data/404_2.html";
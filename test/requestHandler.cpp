@@ -2,20 +2,36 @@
 
 RequestHandler::RequestHandler()
 {
-    router.addRoute("GET", "^/users/(\\w*)/?$", this, &RequestHandler::handleGetUsername);
-    router.addRoute({"GET", "POST"}, "^/gzipTest/?$", this, &RequestHandler::handleGzipTest);
+    router.addPath("GET", "/users/:username", {middleware::CORS}, this, &RequestHandler::handleGetUsername);
+    router.addRoute(HttpMethod::Get | HttpMethod::Post, "^/gzipTest/?$", this, &RequestHandler::handleGzipTest);
     router.addRoute({"GET", "POST"}, "^/formTest/?$", this, &RequestHandler::handleFormTest);
     router.addRoute("GET", "^/fileTest/(\\d*)/?$", this, &RequestHandler::handleFileTest);
     router.addRoute("GET", "^/errorTest/(\\d*)/?$", this, &RequestHandler::handleErrorTest);
     router.addRoute("GET", "^/asyncTest/(\\d*)/?$", this, &RequestHandler::handleAsyncTest);
+    router.addRoute("GET", "^/chunkedTest/(\\d*)/?$", this, &RequestHandler::handleChunkedTest);
+    router.addRoute("GET", "^/jsonTest/(\\d*)/?$", this, &RequestHandler::handleJsonTest);
+    router.addRoute("GET", "^/eventTest/?$", this, &RequestHandler::handleEventTest);
+    router.addRoute("GET", "^/webSocketTest/?$", this, &RequestHandler::handleWebSocketTest);
+
+    // Broadcast the current time to all event subscribers every second
+    QTimer *eventTimer = new QTimer(this);
+    connect(eventTimer, &QTimer::timeout, [this]() {
+        broadcaster.broadcast(QDateTime::currentDateTime().toString(Qt::ISODate).toUtf8(), "time");
+    });
+    eventTimer->start(1000);
 }
 
 HttpPromise RequestHandler::handle(HttpDataPtr data)
+{
+    return dispatch(data).toPromise();
+}
+
+HttpResult RequestHandler::dispatch(HttpDataPtr data)
 {
     bool foundRoute;
-    HttpPromise promise = router.route(data, &foundRoute);
+    HttpResult result = router.dispatch(data, &foundRoute);
     if (foundRoute)
-        return promise;
+        return result;
 
     if (data->request->mimeType().compare("application/json", Qt::CaseInsensitive) != 0)
         throw HttpException(HttpStatus::BadRequest, "Request body content type must be application/json");
@@ -29,19 +45,19 @@ HttpPromise RequestHandler::handle(HttpDataPtr data)
     object["another test"] = "OK";
 
     data->response->setStatus(HttpStatus::Ok, QJsonDocument(object));
-    return HttpPromise::resolve(data);
+    return data;
 }
 
-HttpPromise RequestHandler::handleGetUsername(HttpDataPtr data)
+HttpResult RequestHandler::handleGetUsername(HttpDataPtr data)
 {
-    auto match = data->state["match"].value<QRegularExpressionMatch>();
-    QString username = match.captured(1);
+    QString username = data->param("username");
     QJsonObject object;
 
     object["username"] = username;
 
     data->response->setStatus(HttpStatus::Ok, QJsonDocument(object));
-    return HttpPromise::resolve(data);
+    data->response->setCacheTtl(10 * 1000);
+    return data;
 }
 
 HttpPromise RequestHandler::handleGzipTest(HttpDataPtr data)
@@ -91,8 +107,7 @@ HttpPromise RequestHandler::handleFormTest(HttpDataPtr data)
 
 HttpPromise RequestHandler::handleFileTest(HttpDataPtr data)
 {
-    auto match = data->state["match"].value<QRegularExpressionMatch>();
-    int id = match.captured(1).toInt();
+    int id = data->param(0).toInt();
 
     switch (id)
     {
@@ -154,8 +169,7 @@ HttpPromise RequestHandler::handleFileTest(HttpDataPtr data)
 
 HttpPromise RequestHandler::handleErrorTest(HttpDataPtr data)
 {
-    auto match = data->state["match"].value<QRegularExpressionMatch>();
-    int statusCode = match.captured(1).toInt();
+    int statusCode = data->param(0).toInt();
     HttpStatus status = (HttpStatus)statusCode;
     data->response->setError(status, "There was an error here. Details go here");
     return HttpPromise::resolve(data);
@@ -163,8 +177,7 @@ HttpPromise RequestHandler::handleErrorTest(HttpDataPtr data)
 
 HttpPromise RequestHandler::handleAsyncTest(HttpDataPtr data)
 {
-    auto match = data->state["match"].value<QRegularExpressionMatch>();
-    int delay = match.captured(1).toInt();
+    int delay = data->param(0).toInt();
     return HttpPromise::resolve(data).delay(delay * 1000).then([](HttpDataPtr data) {
         qInfo() << "Timeout reached";
         data->checkFinished();
@@ -173,3 +186,58 @@ HttpPromise RequestHandler::handleAsyncTest(HttpDataPtr data)
         return data;
     });
 }
+
+HttpPromise RequestHandler::handleChunkedTest(HttpDataPtr data)
+{
+    int count = data->param(0).toInt();
+
+    // Headers are sent right away, then one chunk is sent every 100ms
+    data->response->beginChunked(HttpStatus::Ok, "text/plain; charset=utf-8");
+
+    HttpPromise promise = HttpPromise::resolve(data);
+    for (int i = 0; i < count; ++i)
+    {
+        promise = promise.delay(100).then([i](HttpDataPtr data) {
+            data->response->appendChunk(QString("Chunk %1\n").arg(i).toUtf8());
+            return data;
+        });
+    }
+
+    return promise.then([](HttpDataPtr data) {
+        data->response->endChunked();
+        return data;
+    });
+}
+
+HttpPromise RequestHandler::handleJsonTest(HttpDataPtr data)
+{
+    int count = data->param(0).toInt();
+
+    // Each record is written as a line of NDJSON and sent in chunks as the output grows
+    HttpJsonWriter json(data->response, HttpStatus::Ok, HttpJsonWriter::Mode::Lines);
+    for (int i = 0; i < count && json.isOpen(); ++i)
+        json.beginObject().field("id", i).field("name", QString("Record %1").arg(i)).endObject();
+
+    json.finish();
+    return HttpPromise::resolve(data);
+}
+
+HttpPromise RequestHandler::handleEventTest(HttpDataPtr data)
+{
+    broadcaster.subscribe(data);
+    HttpEventBroadcaster::send(data, "Subscribed", "status");
+    return HttpPromise::resolve(data);
+}
+
+HttpPromise RequestHandler::handleWebSocketTest(HttpDataPtr data)
+{
+    // Every message received is sent to all connected clients
+    HttpWebSocket::accept(data, [this](HttpWebSocket *socket) {
+        webSocketBroadcaster.add(socket);
+        connect(socket, &HttpWebSocket::textMessageReceived, this, [this](QString message) {
+            webSocketBroadcaster.sendText(message);
+        });
+    });
+
+    return HttpPromise::resolve(data);
+}
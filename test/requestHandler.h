@@ -5,8 +5,12 @@
 #include <QTimer>
 
 #include "httpServer/httpData.h"
+#include "httpServer/httpEventBroadcaster.h"
+#include "httpServer/httpJsonWriter.h"
 #include "httpServer/httpRequestHandler.h"
 #include "httpServer/httpRequestRouter.h"
+#include "httpServer/httpWebSocket.h"
+#include "httpServer/middleware.h"
 
 
 using QtPromise::QPromise;
@@ -15,18 +19,25 @@ class RequestHandler : public HttpRequestHandler
 {
 private:
     HttpRequestRouter router;
+    HttpEventBroadcaster broadcaster;
+    HttpWebSocketBroadcaster webSocketBroadcaster;
 
 public:
     RequestHandler();
 
-    HttpPromise handle(HttpDataPtr data);
+    HttpPromise handle(HttpDataPtr data) override;
+    HttpResult dispatch(HttpDataPtr data) override;
 
-    HttpPromise handleGetUsername(HttpDataPtr data);
+    HttpResult handleGetUsername(HttpDataPtr data);
     HttpPromise handleGzipTest(HttpDataPtr data);
     HttpPromise handleFormTest(HttpDataPtr data);
     HttpPromise handleFileTest(HttpDataPtr data);
     HttpPromise handleErrorTest(HttpDataPtr data);
     HttpPromise handleAsyncTest(HttpDataPtr data);
+    HttpPromise handleChunkedTest(HttpDataPtr data);
+    HttpPromise handleJsonTest(HttpDataPtr data);
+    HttpPromise handleEventTest(HttpDataPtr data);
+    HttpPromise handleWebSocketTest(HttpDataPtr data);
 };
 
 #endif // REQUESTHANDLER_H
@@ -0,0 +1,6 @@
+TARGET = tst_httpArena
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpArena.cpp
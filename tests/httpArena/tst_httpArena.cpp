@@ -0,0 +1,313 @@
+#include "httpServer/httpArena.h"
+#include "httpServer/httpRequest.h"
+#include "httpServer/httpResponse.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <QString>
+#include <QtTest>
+#include <unordered_map>
+
+
+namespace
+{
+    // Heap allocations made by the test executable, counted by replacing the global operator new
+    std::atomic<long> heapAllocations(0);
+}
+
+void *operator new(size_t size)
+{
+    ++heapAllocations;
+    if (void *p = malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+
+class TestHttpArena : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void alignment();
+    void blocks();
+    void largeAllocations();
+    void resetReusesFirstBlock();
+    void arenaMap();
+    void resetMap();
+    void heapAllocator();
+    void pooledArenas();
+    void arenaPerRequest();
+    void allocationCount();
+
+    void benchmarkArenaMap();
+    void benchmarkHeapMap();
+};
+
+static bool isAligned(void *p, size_t alignment)
+{
+    return (uintptr_t)p % alignment == 0;
+}
+
+// Headers of a typical request, added to a map that is thrown away once the request is done
+static const QString headerNames[] = {"Host", "User-Agent", "Accept", "Accept-Language", "Accept-Encoding",
+    "Connection", "Cookie", "Referer", "Cache-Control", "Content-Type", "Content-Length", "Origin"};
+
+template <typename F>
+static long countAllocations(F function)
+{
+    const long before = heapAllocations;
+    function();
+    return heapAllocations - before;
+}
+
+void TestHttpArena::alignment()
+{
+    HttpArena arena;
+    void *a = arena.allocate(1, 1);
+    void *b = arena.allocate(8, 8);
+    void *c = arena.allocate(3, 1);
+    void *d = arena.allocate(16, 64);
+    void *e = arena.allocate(4);
+
+    QVERIFY(isAligned(b, 8));
+    QVERIFY(isAligned(d, 64));
+    QVERIFY(isAligned(e, alignof(std::max_align_t)));
+
+    // Allocations come from the same block one after another
+    QVERIFY((char *)b > (char *)a);
+    QVERIFY((char *)c >= (char *)b + 8);
+    QVERIFY((char *)d >= (char *)c + 3);
+    QCOMPARE(arena.blockCount(), 1);
+}
+
+void TestHttpArena::blocks()
+{
+    HttpArena arena(64);
+    QCOMPARE(arena.blockCount(), 0);
+
+    char *first = (char *)arena.allocate(32, 1);
+    char *second = (char *)arena.allocate(32, 1);
+    QCOMPARE(arena.blockCount(), 1);
+    QCOMPARE(second, first + 32);
+
+    // Block is full, a new one is started
+    arena.allocate(1, 1);
+    QCOMPARE(arena.blockCount(), 2);
+
+    // Allocations never overlap, write each one fully to let sanitizers catch overruns
+    for (int i = 0; i < 100; ++i)
+        memset(arena.allocate(24, 8), i, 24);
+
+    QVERIFY(arena.blockCount() > 2);
+}
+
+void TestHttpArena::largeAllocations()
+{
+    HttpArena arena(64);
+    arena.allocate(8);
+
+    char *large = (char *)arena.allocate(1000);
+    memset(large, 0xAB, 1000);
+    QVERIFY(isAligned(large, alignof(std::max_align_t)));
+    QCOMPARE(arena.blockCount(), 2);
+}
+
+void TestHttpArena::resetReusesFirstBlock()
+{
+    HttpArena arena(64);
+    void *first = arena.allocate(16);
+    arena.allocate(60);
+    arena.allocate(500);
+    QCOMPARE(arena.blockCount(), 3);
+
+    arena.reset();
+    QCOMPARE(arena.blockCount(), 1);
+    QCOMPARE(arena.allocate(16), first);
+
+    // Resetting an arena that never allocated does nothing
+    HttpArena empty;
+    empty.reset();
+    QCOMPARE(empty.blockCount(), 0);
+}
+
+void TestHttpArena::arenaMap()
+{
+    HttpArena arena(256);
+    HttpArenaMap<QString, QString> map(0, std::hash<QString>(), std::equal_to<QString>(), &arena);
+
+    for (int i = 0; i < 200; ++i)
+        map.emplace(QString("key%1").arg(i), QString("value%1").arg(i));
+
+    QCOMPARE(map.size(), size_t(200));
+    for (int i = 0; i < 200; ++i)
+        QCOMPARE(map.at(QString("key%1").arg(i)), QString("value%1").arg(i));
+
+    // Nodes & buckets are allocated from the arena
+    QVERIFY(arena.blockCount() > 1);
+
+    map.erase("key0");
+    QCOMPARE(map.count("key0"), size_t(0));
+    QCOMPARE(map.count("key1"), size_t(1));
+}
+
+void TestHttpArena::resetMap()
+{
+    HttpArena first;
+    HttpArena second;
+    HttpArenaMap<QString, int> map(0, std::hash<QString>(), std::equal_to<QString>(), &first);
+    map["a"] = 1;
+
+    // Map is switched to the second arena before the first one is reset, so nothing references freed memory
+    resetArenaMap(map, &second);
+    first.reset();
+    QVERIFY(map.empty());
+    QCOMPARE(map.get_allocator().arena, &second);
+
+    map["b"] = 2;
+    QCOMPARE(map.at("b"), 2);
+    QCOMPARE(second.blockCount(), 1);
+}
+
+void TestHttpArena::heapAllocator()
+{
+    HttpArenaMap<QString, int> map;
+    QCOMPARE(map.get_allocator().arena, (HttpArena *)nullptr);
+
+    for (int i = 0; i < 100; ++i)
+        map[QString::number(i)] = i;
+
+    map.clear();
+    QVERIFY(map.empty());
+}
+
+void TestHttpArena::pooledArenas()
+{
+    HttpArena *first = nullptr;
+    {
+        std::shared_ptr<HttpArena> arena = HttpArena::create(64, 4);
+        first = arena.get();
+        arena->allocate(48);
+        arena->allocate(48);
+        QCOMPARE(arena->blockCount(), 2);
+
+        // Arenas in use are never handed out twice
+        QVERIFY(HttpArena::create(64, 4).get() != first);
+    }
+
+    // Reset once released and reused by the next request on the thread
+    std::shared_ptr<HttpArena> reused = HttpArena::create(64, 4);
+    QCOMPARE(reused.get(), first);
+    QCOMPARE(reused->blockCount(), 1);
+
+    // Arenas with another block size are not reused, 0 allocates from the heap
+    reused.reset();
+    QVERIFY(HttpArena::create(128, 4).get() != first);
+    QVERIFY(!HttpArena::create(0, 4));
+}
+
+void TestHttpArena::arenaPerRequest()
+{
+    HttpServerConfig config;
+
+    // A request still in use, e.g. waiting on an asynchronous handler, does not hold on to the memory of later requests
+    std::shared_ptr<HttpArena> firstArena = HttpArena::create(config.requestArenaBlockSize, config.objectPoolSize);
+    HttpArena *first = firstArena.get();
+    HttpRequest *request = HttpRequest::create(&config, firstArena);
+    HttpResponse *response = HttpResponse::create(&config, firstArena);
+    firstArena.reset();
+
+    for (int i = 0; i < 10; ++i)
+    {
+        std::shared_ptr<HttpArena> arena = HttpArena::create(config.requestArenaBlockSize, config.objectPoolSize);
+        QVERIFY(arena.get() != first);
+        arena->allocate(3 * 1024);
+        arena->allocate(3 * 1024);
+        QCOMPARE(arena->blockCount(), 2);
+    }
+
+    // Returned to the pool once both the request & response are done with it
+    HttpRequest::release(request);
+    QVERIFY(HttpArena::create(config.requestArenaBlockSize, config.objectPoolSize).get() != first);
+    HttpResponse::release(response);
+    QCOMPARE(HttpArena::create(config.requestArenaBlockSize, config.objectPoolSize).get(), first);
+}
+
+void TestHttpArena::allocationCount()
+{
+    // Heap allocations for the headers of a request, the arena only allocates its first block once
+    const long heap = countAllocations([]() {
+        std::unordered_map<QString, QString> headers;
+        for (const QString &name : headerNames)
+            headers.emplace(name, name);
+    });
+
+    HttpArena arena;
+    auto addHeaders = [&arena]() {
+        {
+            HttpArenaMap<QString, QString> headers(0, std::hash<QString>(), std::equal_to<QString>(), &arena);
+            for (const QString &name : headerNames)
+                headers.emplace(name, name);
+        }
+
+        arena.reset();
+    };
+
+    const long firstRequest = countAllocations(addHeaders);
+    const long laterRequests = countAllocations([&addHeaders]() {
+        for (int i = 0; i < 100; ++i)
+            addHeaders();
+    });
+
+    qDebug().noquote() << QString("Heap allocations per request: %1 without an arena, %2 with one (%3 for the first "
+        "request)").arg(heap).arg(laterRequests / 100.0).arg(firstRequest);
+
+    // One node per header plus the bucket array
+    QVERIFY(heap > (long)(sizeof(headerNames) / sizeof(headerNames[0])));
+    QVERIFY(firstRequest >= 1);
+    QCOMPARE(laterRequests, 0l);
+}
+
+void TestHttpArena::benchmarkArenaMap()
+{
+    HttpArena arena;
+    QBENCHMARK
+    {
+        {
+            HttpArenaMap<QString, QString> headers(0, std::hash<QString>(), std::equal_to<QString>(), &arena);
+            for (const QString &name : headerNames)
+                headers.emplace(name, name);
+        }
+
+        arena.reset();
+    }
+
+    QCOMPARE(arena.blockCount(), 1);
+}
+
+void TestHttpArena::benchmarkHeapMap()
+{
+    QBENCHMARK
+    {
+        std::unordered_map<QString, QString> headers;
+        for (const QString &name : headerNames)
+            headers.emplace(name, name);
+    }
+}
+
+QTEST_GUILESS_MAIN(TestHttpArena)
+#include "tst_httpArena.moc"
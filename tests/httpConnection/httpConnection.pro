@@ -0,0 +1,6 @@
+TARGET = tst_httpConnection
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpConnection.cpp
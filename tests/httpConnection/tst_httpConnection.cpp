@@ -0,0 +1,763 @@
+#include "httpServer/httpMemoryBudget.h"
+#include "httpServer/httpServer.h"
+#include "httpTestClient.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QSignalSpy>
+#include <QTimer>
+#include <QtTest>
+#include <stdexcept>
+#include <vector>
+
+
+class TestHttpConnection : public QObject
+{
+    Q_OBJECT
+
+private:
+    TestRequestHandler handler;
+    std::unique_ptr<HttpServer> server;
+    // IDs of the /echo requests in the order they were handled
+    QStringList handled;
+    // Responses of /wait requests, sent once called
+    std::vector<std::function<void()>> waiting;
+    // Chunked responses kept open by /stream
+    std::vector<HttpDataPtr> streams;
+    int bigCalls = 0;
+    // Whether /resolved was finished before the event loop ran again
+    bool resolvedFinished = false;
+    // Socket handed over by an accepted /upgrade
+    std::unique_ptr<QTcpSocket> upgraded;
+
+    // Sends the responses of the /wait requests handled so far
+    void finishWaiting();
+
+    // Local server listening on any free port, closed by cleanup
+    bool startServer(HttpServerConfig config);
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void synchronousErrors_data();
+    void synchronousErrors();
+    void fulfilledPromiseSentRightAway();
+    void synchronousUpgrade();
+    void synchronousUpgradeDeclined();
+
+    void pipelinedRequestsAcrossReads_data();
+    void pipelinedRequestsAcrossReads();
+    void pipeliningDoesNotStarveOthers();
+    void maxPipelinedRequests();
+    void maxPendingResponseBytes();
+
+    void chunkedEndedWithHandler();
+    void chunkedKeptOpen();
+
+    void memoryBudgetAvailable();
+    void overBudgetRequestsRejected();
+    void pausedBodyResumes();
+    void pendingResponseMemory();
+
+    void slowRequestTimesOut();
+    void slowReaderAborted();
+    void pausedBodyTimesOut();
+
+    void benchmarkPipeliningLatency_data();
+    void benchmarkPipeliningLatency();
+};
+
+void TestHttpConnection::initTestCase()
+{
+    handler.router.addPath("GET", "/echo/:id", [this](HttpDataPtr data) -> HttpResult {
+        handled.append(data->param("id"));
+        data->response->setStatus(HttpStatus::Ok, data->param("id").toUtf8(), "text/plain");
+        return data;
+    });
+
+    handler.router.addPath("GET", "/wait/:id", [this](HttpDataPtr data) -> HttpResult {
+        return HttpPromise([this, data](const QtPromise::QPromiseResolve<HttpDataPtr> &resolve,
+            const QtPromise::QPromiseReject<HttpDataPtr> &) {
+            waiting.push_back([data, resolve]() {
+                data->response->setStatus(HttpStatus::Ok, data->param("id").toUtf8(), "text/plain");
+                resolve(data);
+            });
+        });
+    });
+
+    handler.router.addPath("GET", "/throw/:type", [](HttpDataPtr data) -> HttpResult {
+        if (data->param("type") == "http")
+            throw HttpException(HttpStatus::UnprocessableEntity, "Invalid");
+
+        throw std::runtime_error("Failed");
+    });
+
+    handler.router.addPath("GET", "/resolved", [this](HttpDataPtr data) -> HttpResult {
+        data->response->setStatus(HttpStatus::Ok, QByteArray("resolved"), "text/plain");
+
+        // Queued before anything the promise machinery would queue
+        QMetaObject::invokeMethod(this, [this, data]() { resolvedFinished = data->finished; }, Qt::QueuedConnection);
+        return HttpPromise::resolve(data);
+    });
+
+    handler.router.addPath("GET", "/upgrade/:accept", [this](HttpDataPtr data) -> HttpResult {
+        if (data->param("accept") != "yes")
+        {
+            data->response->setStatus(HttpStatus::Ok, QByteArray("declined"), "text/plain");
+            return data;
+        }
+
+        data->response->setStatus(HttpStatus::SwitchingProtocols);
+        data->response->setHeader("Upgrade", "echo");
+        data->response->setHeader("Connection", "Upgrade");
+        data->response->setUpgrade([this](QTcpSocket *socket) {
+            upgraded.reset(socket);
+
+            // Echoes everything, including what was sent right after the request
+            auto echo = [socket]() { socket->write(socket->readAll()); };
+            connect(socket, &QTcpSocket::readyRead, socket, echo);
+            echo();
+        });
+        return data;
+    });
+
+    handler.router.addPath("GET", "/big", [this](HttpDataPtr data) -> HttpResult {
+        ++bigCalls;
+        data->response->setStatus(HttpStatus::Ok, QByteArray(256 * 1024, 'x'), "text/plain");
+        return data;
+    });
+
+    handler.router.addPath("GET", "/huge", [](HttpDataPtr data) -> HttpResult {
+        data->response->setStatus(HttpStatus::Ok, QByteArray(32 * 1024 * 1024, 'x'), "text/plain");
+        return data;
+    });
+
+    handler.router.addPath("GET", "/bigWait", [this](HttpDataPtr data) -> HttpResult {
+        data->response->setStatus(HttpStatus::Ok, QByteArray(256 * 1024, 'x'), "text/plain");
+        return HttpPromise([this, data](const QtPromise::QPromiseResolve<HttpDataPtr> &resolve,
+            const QtPromise::QPromiseReject<HttpDataPtr> &) {
+            waiting.push_back([data, resolve]() { resolve(data); });
+        });
+    });
+
+    handler.router.addPath("GET", "/chunked/:id", [](HttpDataPtr data) -> HttpResult {
+        data->response->beginChunked(HttpStatus::Ok, "text/plain");
+        data->response->appendChunk(data->param("id").toUtf8());
+        return data;
+    });
+
+    handler.router.addPath("GET", "/chunkedWait/:id", [this](HttpDataPtr data) -> HttpResult {
+        data->response->beginChunked(HttpStatus::Ok, "text/plain");
+        data->response->appendChunk(data->param("id").toUtf8());
+        return HttpPromise([this, data](const QtPromise::QPromiseResolve<HttpDataPtr> &resolve,
+            const QtPromise::QPromiseReject<HttpDataPtr> &) {
+            waiting.push_back([data, resolve]() { resolve(data); });
+        });
+    });
+
+    handler.router.addPath("GET", "/stream", [this](HttpDataPtr data) -> HttpResult {
+        data->response->beginChunked(HttpStatus::Ok, "text/plain");
+        data->response->keepChunkedOpen();
+        data->response->appendChunk("open");
+        streams.push_back(data);
+        return data;
+    });
+
+    handler.router.addPath("POST", "/upload", [](HttpDataPtr data) -> HttpResult {
+        data->response->setStatus(HttpStatus::Ok, QByteArray::number(data->request->body().size()), "text/plain");
+        return data;
+    });
+}
+
+void TestHttpConnection::init()
+{
+    handled.clear();
+    bigCalls = 0;
+    resolvedFinished = false;
+}
+
+void TestHttpConnection::cleanup()
+{
+    streams.clear();
+    upgraded.reset();
+    server.reset();
+    waiting.clear();
+}
+
+void TestHttpConnection::finishWaiting()
+{
+    std::vector<std::function<void()>> callbacks;
+    callbacks.swap(waiting);
+    for (const std::function<void()> &callback : callbacks)
+        callback();
+}
+
+bool TestHttpConnection::startServer(HttpServerConfig config)
+{
+    config.host = QHostAddress::LocalHost;
+    config.port = 0;
+
+    server.reset(new HttpServer(config, &handler));
+    return server->listen();
+}
+
+void TestHttpConnection::synchronousErrors_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<int>("status");
+
+    QTest::newRow("HttpException") << "/throw/http" << 422;
+    QTest::newRow("std::exception") << "/throw/std" << 500;
+    QTest::newRow("not found") << "/missing" << 404;
+}
+
+void TestHttpConnection::synchronousErrors()
+{
+    QFETCH(QString, path);
+    QFETCH(int, status);
+
+    QVERIFY(startServer(HttpServerConfig()));
+
+    // Exceptions thrown by a synchronous handler are answered without ending the connection
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.get(path);
+    client.get("/echo/next");
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.status, status);
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("next"));
+}
+
+void TestHttpConnection::fulfilledPromiseSentRightAway()
+{
+    QVERIFY(startServer(HttpServerConfig()));
+
+    // A promise that is already fulfilled counts as ready, the response is finished without waiting on the promise
+    // chain to run in a later event loop iteration
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.get("/resolved");
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("resolved"));
+    QVERIFY(resolvedFinished);
+}
+
+void TestHttpConnection::synchronousUpgrade()
+{
+    QVERIFY(startServer(HttpServerConfig()));
+
+    // Data sent right after the request belongs to the new protocol, it must not be read as another request
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.send("GET /upgrade/yes HTTP/1.1\r\nHost: localhost\r\nConnection: Upgrade\r\nUpgrade: echo\r\n\r\n"
+        "hello");
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.status, 101);
+
+    QByteArray echoed;
+    QVERIFY(client.readRaw(&echoed, 5));
+    QCOMPARE(echoed, QByteArray("hello"));
+
+    client.send("again");
+    QVERIFY(client.readRaw(&echoed, 5));
+    QCOMPARE(echoed, QByteArray("again"));
+}
+
+void TestHttpConnection::synchronousUpgradeDeclined()
+{
+    QVERIFY(startServer(HttpServerConfig()));
+
+    // Reading continues with the next request once the declining response is sent
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.send("GET /upgrade/no HTTP/1.1\r\nHost: localhost\r\nConnection: Upgrade\r\nUpgrade: echo\r\n\r\n");
+    client.get("/echo/next");
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("declined"));
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("next"));
+    QVERIFY(!upgraded);
+}
+
+void TestHttpConnection::pipelinedRequestsAcrossReads_data()
+{
+    QTest::addColumn<int>("maxRequestsPerRead");
+    QTest::addColumn<int>("maxBytesPerRead");
+
+    QTest::newRow("requests") << 2 << 0;
+    QTest::newRow("bytes") << 0 << 100;
+    QTest::newRow("unlimited") << 0 << 0;
+}
+
+void TestHttpConnection::pipelinedRequestsAcrossReads()
+{
+    QFETCH(int, maxRequestsPerRead);
+    QFETCH(int, maxBytesPerRead);
+
+    HttpServerConfig config;
+    config.maxRequestsPerRead = maxRequestsPerRead;
+    config.maxBytesPerRead = maxBytesPerRead;
+    QVERIFY(startServer(config));
+
+    // Requests left in the socket buffer once the limit is reached do not emit readyRead again, they must still be read
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    for (int i = 0; i < 20; ++i)
+        client.get(QString("/echo/%1").arg(i));
+
+    for (int i = 0; i < 20; ++i)
+    {
+        HttpTestResponse response;
+        QVERIFY(client.readResponse(&response));
+        QCOMPARE(response.status, 200);
+        QCOMPARE(response.body, QByteArray::number(i));
+    }
+}
+
+void TestHttpConnection::pipeliningDoesNotStarveOthers()
+{
+    HttpServerConfig config;
+    config.maxRequestsPerRead = 16;
+    QVERIFY(startServer(config));
+
+    HttpTestClient busy;
+    HttpTestClient other;
+    QVERIFY(busy.connectTo(server->serverPort()));
+    QVERIFY(other.connectTo(server->serverPort()));
+
+    for (int i = 0; i < 200; ++i)
+        busy.get(QString("/echo/busy%1").arg(i));
+    other.get("/echo/other");
+    busy.socket.flush();
+    other.socket.flush();
+
+    HttpTestResponse response;
+    QVERIFY(other.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("other"));
+    QTRY_COMPARE(handled.size(), 201);
+
+    // Without a limit, all 200 pipelined requests would be handled before the other connection gets a turn
+    const int position = handled.indexOf("other");
+    QVERIFY2(position < 100, qPrintable(QString("Handled at position %1").arg(position)));
+}
+
+void TestHttpConnection::maxPipelinedRequests()
+{
+    HttpServerConfig config;
+    config.maxPipelinedRequests = 4;
+    QVERIFY(startServer(config));
+
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    for (int i = 0; i < 10; ++i)
+        client.get(QString("/wait/%1").arg(i));
+
+    // Reading stops once 4 requests are waiting on a response
+    QTRY_COMPARE((int)waiting.size(), 4);
+    QTest::qWait(100);
+    QCOMPARE((int)waiting.size(), 4);
+
+    int received = 0;
+    while (received < 10)
+    {
+        QTRY_VERIFY(!waiting.empty());
+        QVERIFY((int)waiting.size() <= 4);
+        finishWaiting();
+
+        HttpTestResponse response;
+        while (client.readResponse(&response, 200))
+        {
+            QCOMPARE(response.body, QByteArray::number(received));
+            ++received;
+        }
+    }
+}
+
+void TestHttpConnection::maxPendingResponseBytes()
+{
+    HttpServerConfig config;
+    config.maxPendingResponseBytes = 64 * 1024;
+    config.maxPipelinedRequests = 0;
+    QVERIFY(startServer(config));
+
+    // Client stops reading, so the responses pile up in the socket buffers
+    // Note: Enough responses to fill the kernel buffers of a loopback connection several times over
+    const int count = 128;
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.socket.setReadBufferSize(1024);
+    for (int i = 0; i < count; ++i)
+        client.get("/big");
+
+    QTest::qWait(500);
+    const int callsWhilePaused = bigCalls;
+    QVERIFY2(callsWhilePaused < count, "Server kept reading requests while the client was not reading responses");
+
+    // Resumes once the client reads the responses
+    client.socket.setReadBufferSize(0);
+    for (int i = 0; i < count; ++i)
+    {
+        HttpTestResponse response;
+        QVERIFY(client.readResponse(&response));
+        QCOMPARE(response.body.size(), 256 * 1024);
+    }
+
+    QCOMPARE(bigCalls, count);
+}
+
+void TestHttpConnection::chunkedEndedWithHandler()
+{
+    QVERIFY(startServer(HttpServerConfig()));
+
+    // Chunked responses the handlers did not end are ended once they are done, so the responses behind them are sent
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.get("/chunked/a");
+    client.get("/chunkedWait/b");
+    client.get("/echo/c");
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("a"));
+
+    QTRY_COMPARE((int)waiting.size(), 1);
+    QVERIFY(!client.readResponse(&response, 200));
+    finishWaiting();
+
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("b"));
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("c"));
+}
+
+void TestHttpConnection::chunkedKeptOpen()
+{
+    QVERIFY(startServer(HttpServerConfig()));
+
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.get("/stream");
+    client.get("/echo/1");
+
+    HttpTestResponse response;
+    QTRY_COMPARE((int)streams.size(), 1);
+    QVERIFY(!client.readResponse(&response, 200));
+
+    streams.front()->response->appendChunk(" stream");
+    streams.front()->response->endChunked();
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("open stream"));
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body, QByteArray("1"));
+}
+
+void TestHttpConnection::memoryBudgetAvailable()
+{
+    HttpMemoryBudget budget(100);
+    QSignalSpy spy(&budget, &HttpMemoryBudget::available);
+
+    budget.add(60);
+    QVERIFY(!budget.isExceeded());
+    budget.add(40);
+    QVERIFY(budget.isExceeded());
+    QCOMPARE(budget.usage(), 100ll);
+
+    // Only emitted when the usage drops back under the limit, not for every release
+    budget.add(-10);
+    QVERIFY(!budget.isExceeded());
+    budget.add(-10);
+    QCOMPARE(spy.count(), 1);
+
+    budget.add(-80);
+    QCOMPARE(budget.usage(), 0ll);
+    QCOMPARE(spy.count(), 1);
+}
+
+void TestHttpConnection::overBudgetRequestsRejected()
+{
+    HttpServerConfig config;
+    config.memoryBudget = 16 * 1024;
+    config.maxRequestSize = 1024 * 1024;
+    QVERIFY(startServer(config));
+
+    // Body held by the first connection uses up the budget
+    HttpTestClient upload;
+    QVERIFY(upload.connectTo(server->serverPort()));
+    upload.send("POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 524288\r\n\r\n" +
+        QByteArray(32 * 1024, 'a'));
+    QTRY_VERIFY(server->memoryUsage() > config.memoryBudget);
+
+    HttpTestClient rejected;
+    QVERIFY(rejected.connectTo(server->serverPort()));
+    rejected.get("/echo/1");
+
+    HttpTestResponse response;
+    QVERIFY(rejected.readResponse(&response));
+    QCOMPARE(response.status, 503);
+    QCOMPARE(response.header("Retry-After"), QString("1"));
+    QVERIFY(handled.isEmpty());
+
+    // Memory is released along with the connection, requests are accepted again
+    upload.socket.abort();
+    QTRY_VERIFY(server->memoryUsage() < config.memoryBudget);
+
+    HttpTestClient accepted;
+    QVERIFY(accepted.connectTo(server->serverPort()));
+    accepted.get("/echo/2");
+    QVERIFY(accepted.readResponse(&response));
+    QCOMPARE(response.status, 200);
+    QCOMPARE(response.body, QByteArray("2"));
+}
+
+void TestHttpConnection::pausedBodyResumes()
+{
+    HttpServerConfig config;
+    config.memoryBudget = 16 * 1024;
+    config.maxRequestSize = 1024 * 1024;
+    QVERIFY(startServer(config));
+
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.send("POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 2048\r\n\r\n" +
+        QByteArray(1024, 'a'));
+    QTRY_VERIFY(server->memoryUsage() > 0);
+
+    HttpTestClient other;
+    QVERIFY(other.connectTo(server->serverPort()));
+    other.send("POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 524288\r\n\r\n" +
+        QByteArray(32 * 1024, 'b'));
+    QTRY_VERIFY(server->memoryUsage() > config.memoryBudget);
+
+    // Rest of the body is not read while over the budget
+    client.send(QByteArray(1024, 'a'));
+    QTest::qWait(200);
+    QCOMPARE(client.socket.bytesAvailable(), 0ll);
+
+    // Reading resumes once the other connection frees its memory
+    other.socket.abort();
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.status, 200);
+    QCOMPARE(response.body, QByteArray("2048"));
+}
+
+void TestHttpConnection::pendingResponseMemory()
+{
+    HttpServerConfig config;
+    config.memoryBudget = 1024 * 1024;
+    QVERIFY(startServer(config));
+
+    // Body set by a handler that has not finished yet counts towards the budget
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.get("/bigWait");
+    QTRY_VERIFY(server->memoryUsage() >= 256 * 1024);
+
+    finishWaiting();
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.body.size(), 256 * 1024);
+
+    // Released once the response is sent
+    QTRY_VERIFY(server->memoryUsage() < 1024);
+}
+
+void TestHttpConnection::slowRequestTimesOut()
+{
+    // Request timeout is far off, only the minimum rate can end the request in time
+    HttpServerConfig config;
+    config.minRequestDataRate = 1024;
+    config.dataRateGracePeriod = 1;
+    config.dataRateWindow = 1;
+    config.requestTimeout = 60;
+    QVERIFY(startServer(config));
+
+    // Headers trickle in a byte at a time, like a slowloris client
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.send("GET /echo/1 HTTP/1.1\r\nHost: localhost\r\nX-Slow: ");
+
+    QTimer trickle;
+    connect(&trickle, &QTimer::timeout, [&client]() { client.send("a"); });
+    trickle.start(100);
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response, 10000));
+    QCOMPARE(response.status, 408);
+    QVERIFY(handled.isEmpty());
+    trickle.stop();
+    QVERIFY(client.waitForDisconnected());
+}
+
+void TestHttpConnection::slowReaderAborted()
+{
+    // Budget is only used to observe the memory held for the connection, it is never exceeded
+    HttpServerConfig config;
+    config.minResponseDataRate = 1024 * 1024;
+    config.dataRateGracePeriod = 1;
+    config.dataRateWindow = 1;
+    config.memoryBudget = 1024ll * 1024 * 1024;
+    QVERIFY(startServer(config));
+
+    // Response is far larger than the socket buffers and the client stops reading once 64 KB are buffered
+    HttpTestClient client;
+    client.socket.setReadBufferSize(64 * 1024);
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.get("/huge");
+    QTRY_VERIFY(server->memoryUsage() > 0);
+
+    // Connection is aborted, which releases the response instead of holding it for the client forever
+    QTRY_VERIFY_WITH_TIMEOUT(server->memoryUsage() == 0, 10000);
+    QVERIFY(client.waitForDisconnected());
+}
+
+void TestHttpConnection::pausedBodyTimesOut()
+{
+    // With a minimum request rate there is no request timeout while a body is arriving, a body paused by the memory
+    // budget must still time out since the rate is not measured while paused
+    HttpServerConfig config;
+    config.memoryBudget = 16 * 1024;
+    config.maxRequestSize = 1024 * 1024;
+    config.minRequestDataRate = 1;
+    config.requestTimeout = 1;
+    QVERIFY(startServer(config));
+
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.send("POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 524288\r\n\r\n" +
+        QByteArray(32 * 1024, 'a'));
+    QTRY_VERIFY(server->memoryUsage() > config.memoryBudget);
+
+    // Read while over the budget, which pauses the connection
+    client.send(QByteArray(1024, 'b'));
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response, 5000));
+    QCOMPARE(response.status, 408);
+    QVERIFY(client.waitForDisconnected());
+}
+
+// Removes the complete responses with the given body from the received data, returns how many were removed
+static int takeResponses(QByteArray *received, const QByteArray &body)
+{
+    const QByteArray end = "\r\n\r\n" + body;
+    int count = 0;
+    int from = 0;
+    int index;
+    while ((index = received->indexOf(end, from)) != -1)
+    {
+        ++count;
+        from = index + end.size();
+    }
+
+    received->remove(0, from);
+    return count;
+}
+
+void TestHttpConnection::benchmarkPipeliningLatency_data()
+{
+    QTest::addColumn<int>("maxRequestsPerRead");
+
+    QTest::newRow("16 requests per read") << 16;
+    QTest::newRow("no limit") << 0;
+}
+
+void TestHttpConnection::benchmarkPipeliningLatency()
+{
+    QFETCH(int, maxRequestsPerRead);
+
+    HttpServerConfig config;
+    config.maxRequestsPerRead = maxRequestsPerRead;
+    config.maxPipelinedRequests = 0;
+    config.maxPendingResponseBytes = 0;
+    QVERIFY(startServer(config));
+
+    // Note: Runs its own event loop, QTRY_* only polls every 10 ms which would hide the latency being measured
+    QEventLoop loop;
+    QTimer::singleShot(60000, &loop, &QEventLoop::quit);
+
+    // Pipelining client sends its next batch as soon as the last one is answered, so it always has requests waiting
+    const int batchSize = 256;
+    QByteArray batch;
+    for (int i = 0; i < batchSize; ++i)
+        batch += "GET /echo/busy HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+    HttpTestClient busy;
+    QVERIFY(busy.connectTo(server->serverPort()));
+    QByteArray busyReceived;
+    int busyPending = batchSize;
+    connect(&busy.socket, &QTcpSocket::readyRead, [&]() {
+        busyReceived += busy.socket.readAll();
+        busyPending -= takeResponses(&busyReceived, "busy");
+        if (busyPending == 0)
+        {
+            busyPending = batchSize;
+            busy.send(batch);
+        }
+    });
+
+    // Other clients send one request at a time and measure how long each one takes to be answered
+    const int clientCount = 4;
+    const int sampleCount = 1000;
+    std::vector<double> latencies;
+    std::vector<QElapsedTimer> timers(clientCount);
+    std::vector<QByteArray> received(clientCount);
+    std::vector<std::unique_ptr<HttpTestClient>> clients;
+    for (int i = 0; i < clientCount; ++i)
+    {
+        clients.emplace_back(new HttpTestClient());
+        HttpTestClient *client = clients.back().get();
+        QVERIFY(client->connectTo(server->serverPort()));
+        connect(&client->socket, &QTcpSocket::readyRead, [&, i, client]() {
+            received[i] += client->socket.readAll();
+            if (takeResponses(&received[i], "other") == 0)
+                return;
+
+            latencies.push_back(timers[i].nsecsElapsed() / 1000000.0);
+            if ((int)latencies.size() >= sampleCount)
+            {
+                loop.quit();
+                return;
+            }
+
+            timers[i].start();
+            client->get("/echo/other");
+        });
+    }
+
+    busy.send(batch);
+    for (int i = 0; i < clientCount; ++i)
+    {
+        timers[i].start();
+        clients[i]->get("/echo/other");
+    }
+
+    loop.exec();
+    QVERIFY2((int)latencies.size() >= sampleCount, qPrintable(QString("Only %1 responses").arg(latencies.size())));
+
+    std::sort(latencies.begin(), latencies.end());
+    const double p50 = latencies[latencies.size() / 2];
+    const double p99 = latencies[latencies.size() * 99 / 100];
+    qInfo().noquote() << QString("p50 %1 ms, p99 %2 ms").arg(p50, 0, 'f', 3).arg(p99, 0, 'f', 3);
+
+    // Reported as the result of the benchmark
+    QTest::setBenchmarkResult(p99, QTest::WalltimeMilliseconds);
+}
+
+QTEST_GUILESS_MAIN(TestHttpConnection)
+#include "tst_httpConnection.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_httpDataRate
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpDataRate.cpp
@@ -0,0 +1,104 @@
+#include "httpServer/httpDataRate.h"
+
+#include <QtTest>
+
+
+// Note: The rate is measured against the real clock, waits are kept just long enough to cross a second or the grace
+// period
+class TestHttpDataRate : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void inactive();
+    void rateSinceStart();
+    void windowForgetsOldData();
+    void gracePeriod();
+    void disabledMinimum();
+    void restartClearsData();
+};
+
+void TestHttpDataRate::inactive()
+{
+    HttpDataRate rate(5);
+    QVERIFY(!rate.isActive());
+
+    // Nothing is measured until started
+    rate.add(1000);
+    QCOMPARE(rate.rate(), 0ll);
+    QVERIFY(!rate.isBelow(1000, 0));
+}
+
+void TestHttpDataRate::rateSinceStart()
+{
+    HttpDataRate rate(5);
+    rate.start();
+    QVERIFY(rate.isActive());
+
+    // Averaged over the time since starting while that is shorter than the window
+    rate.add(1000);
+    QTest::qWait(500);
+    const qint64 bytesPerSecond = rate.rate();
+    QVERIFY2(bytesPerSecond > 500 && bytesPerSecond <= 2000, qPrintable(QString::number(bytesPerSecond)));
+}
+
+void TestHttpDataRate::windowForgetsOldData()
+{
+    HttpDataRate rate(1);
+    rate.start();
+    rate.add(1024 * 1024);
+    QVERIFY(rate.rate() > 0);
+
+    // Bytes from seconds that have left the window no longer count
+    QTest::qWait(2100);
+    QCOMPARE(rate.rate(), 0ll);
+    QVERIFY(rate.isBelow(1, 1));
+
+    rate.add(1024 * 1024);
+    QVERIFY(!rate.isBelow(1, 1));
+}
+
+void TestHttpDataRate::gracePeriod()
+{
+    HttpDataRate rate(5);
+    rate.start();
+
+    // Nothing was sent, but the rate is not judged until the grace period is over
+    QVERIFY(!rate.isBelow(1000, 1));
+    QTest::qWait(1100);
+    QVERIFY(rate.isBelow(1000, 1));
+
+    // Fast enough once data arrives
+    rate.add(10 * 1024);
+    QVERIFY(!rate.isBelow(1000, 1));
+}
+
+void TestHttpDataRate::disabledMinimum()
+{
+    HttpDataRate rate(5);
+    rate.start();
+    QVERIFY(!rate.isBelow(0, 0));
+    QVERIFY(rate.isBelow(1, 0));
+
+    rate.stop();
+    QVERIFY(!rate.isActive());
+    QVERIFY(!rate.isBelow(1, 0));
+}
+
+void TestHttpDataRate::restartClearsData()
+{
+    HttpDataRate rate(5);
+    rate.start();
+    rate.add(1000);
+
+    // Starting again while measuring keeps the data
+    rate.start();
+    QVERIFY(rate.rate() > 0);
+
+    rate.stop();
+    rate.start();
+    QCOMPARE(rate.rate(), 0ll);
+}
+
+QTEST_GUILESS_MAIN(TestHttpDataRate)
+#include "tst_httpDataRate.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_httpJsonWriter
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpJsonWriter.cpp
@@ -0,0 +1,275 @@
+#include "httpServer/httpJsonWriter.h"
+#include "httpServer/httpServer.h"
+#include "httpTestClient.h"
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <QJsonDocument>
+#include <QtTest>
+
+
+class TestHttpJsonWriter : public QObject
+{
+    Q_OBJECT
+
+private:
+    HttpServerConfig config;
+    TestRequestHandler handler;
+    HttpServer *server = nullptr;
+
+    QByteArray document(std::function<void(HttpJsonWriter &)> write);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void escaping();
+    void unicode();
+    void surrogates();
+    void latin1AndUtf8Strings();
+    void numbers();
+    void fields();
+    void nesting();
+    void documentHeaders();
+    void flushOnlyBetweenValues();
+    void clientGone();
+    void linesFraming();
+    void arrayFraming();
+};
+
+void TestHttpJsonWriter::initTestCase()
+{
+    handler.router.addPath("GET", "/lines", [](HttpDataPtr data) -> HttpResult {
+        HttpJsonWriter json(data->response, HttpStatus::Ok, HttpJsonWriter::Mode::Lines);
+        for (int i = 0; i < 3; ++i)
+            json.beginObject().field("id", i).endObject();
+
+        return data;
+    });
+
+    // Flushes after every value so the array is split across several chunks
+    handler.router.addPath("GET", "/array", [](HttpDataPtr data) -> HttpResult {
+        HttpJsonWriter json(data->response, HttpStatus::Ok, HttpJsonWriter::Mode::Array, 1);
+        for (int i = 0; i < 3; ++i)
+            json.beginObject().field("id", i).endObject();
+
+        return data;
+    });
+
+    HttpServerConfig serverConfig;
+    serverConfig.host = QHostAddress::LocalHost;
+    serverConfig.port = 0;
+
+    server = new HttpServer(serverConfig, &handler);
+    QVERIFY(server->listen());
+}
+
+void TestHttpJsonWriter::cleanupTestCase()
+{
+    delete server;
+}
+
+QByteArray TestHttpJsonWriter::document(std::function<void(HttpJsonWriter &)> write)
+{
+    HttpResponse response(&config);
+    {
+        HttpJsonWriter json(&response);
+        write(json);
+    }
+
+    return response.body();
+}
+
+void TestHttpJsonWriter::escaping()
+{
+    const QByteArray body = document([](HttpJsonWriter &json) {
+        json.value(QString("a\"b\\c/\b\f\n\r\t\x01\x1F"));
+    });
+
+    QCOMPARE(body, QByteArray("\"a\\\"b\\\\c/\\b\\f\\n\\r\\t\\u0001\\u001f\""));
+}
+
+void TestHttpJsonWriter::unicode()
+{
+    const QString text = QString::fromUtf8("caf\xC3\xA9 \xE2\x82\xAC");
+    const QByteArray body = document([&](HttpJsonWriter &json) {
+        json.value(text);
+    });
+
+    QCOMPARE(body, QByteArray("\"caf\xC3\xA9 \xE2\x82\xAC\""));
+    QCOMPARE(QJsonDocument::fromJson("[" + body + "]").array().at(0).toString(), text);
+}
+
+void TestHttpJsonWriter::surrogates()
+{
+    // U+1F600 is encoded as a single 4-byte sequence, not as two 3-byte surrogates
+    const uint emoji = 0x1F600;
+    const QByteArray pair = document([&](HttpJsonWriter &json) {
+        json.value(QString::fromUcs4(&emoji, 1));
+    });
+    QCOMPARE(pair, QByteArray("\"\xF0\x9F\x98\x80\""));
+
+    // Unpaired surrogates are not valid UTF-8, they are replaced with U+FFFD
+    const QByteArray unpaired = document([](HttpJsonWriter &json) {
+        json.beginArray()
+            .value(QString(QChar(0xD800)) + "x")
+            .value(QString("x") + QChar(0xDC00))
+            .endArray();
+    });
+    QCOMPARE(unpaired, QByteArray("[\"\xEF\xBF\xBDx\",\"x\xEF\xBF\xBD\"]"));
+}
+
+void TestHttpJsonWriter::latin1AndUtf8Strings()
+{
+    const QByteArray body = document([](HttpJsonWriter &json) {
+        json.beginArray()
+            .value(QLatin1String("plain"))
+            .value(QLatin1String("caf\xE9 \"quoted\""))
+            .value("utf-8 caf\xC3\xA9")
+            .endArray();
+    });
+
+    QCOMPARE(body, QByteArray("[\"plain\",\"caf\xC3\xA9 \\\"quoted\\\"\",\"utf-8 caf\xC3\xA9\"]"));
+}
+
+void TestHttpJsonWriter::numbers()
+{
+    const QByteArray body = document([](HttpJsonWriter &json) {
+        json.beginArray()
+            .value(-5)
+            .value(5u)
+            .value(-7L)
+            .value(7UL)
+            .value(std::numeric_limits<qint64>::min())
+            .value(std::numeric_limits<quint64>::max())
+            .value(size_t(42))
+            .value(short(3))
+            .value(0.1f)
+            .value(0.1)
+            .value(2.5)
+            .value(std::nan(""))
+            .value(std::numeric_limits<float>::infinity())
+            .value(true)
+            .value(nullptr)
+            .endArray();
+    });
+
+    QCOMPARE(body, QByteArray("[-5,5,-7,7,-9223372036854775808,18446744073709551615,42,3,0.1,0.1,2.5,null,null,"
+        "true,null]"));
+}
+
+void TestHttpJsonWriter::fields()
+{
+    const quint64 id = 12345678901234ull;
+    const unsigned long count = 2;
+    const unsigned int index = 7;
+    const float ratio = 0.5f;
+
+    const QByteArray body = document([&](HttpJsonWriter &json) {
+        json.beginObject()
+            .field("id", id)
+            .field("count", count)
+            .field("index", index)
+            .field("ratio", ratio)
+            .field("name", QString("user"))
+            .endObject();
+    });
+
+    QCOMPARE(body, QByteArray("{\"id\":12345678901234,\"count\":2,\"index\":7,\"ratio\":0.5,\"name\":\"user\"}"));
+}
+
+void TestHttpJsonWriter::nesting()
+{
+    const QByteArray body = document([](HttpJsonWriter &json) {
+        json.beginObject()
+            .key("list").beginArray().value(1).beginObject().endObject().beginArray().endArray().endArray()
+            .field("name", "x")
+            .key("object").value(QJsonObject{{"a", 1}})
+            .key("open").beginArray().value(2);
+        // Left open, closed by the destructor
+    });
+
+    QCOMPARE(body, QByteArray("{\"list\":[1,{},[]],\"name\":\"x\",\"object\":{\"a\":1},\"open\":[2]}"));
+    QVERIFY(!QJsonDocument::fromJson(body).isNull());
+}
+
+void TestHttpJsonWriter::documentHeaders()
+{
+    HttpResponse response(&config);
+    HttpJsonWriter json(&response, HttpStatus::Created);
+    json.value(1);
+    json.finish();
+
+    QString contentType;
+    QVERIFY(response.header("Content-Type", &contentType));
+    QCOMPARE(contentType, QString("application/json"));
+    QCOMPARE(response.status(), HttpStatus::Created);
+    QVERIFY(!response.isChunked());
+}
+
+void TestHttpJsonWriter::flushOnlyBetweenValues()
+{
+    HttpResponse response(&config);
+    HttpJsonWriter json(&response, HttpStatus::Ok, HttpJsonWriter::Mode::Lines, 32);
+    QVERIFY(response.isChunked());
+
+    // {"a":1}\n is less than the flush size
+    json.beginObject().field("a", 1).endObject();
+    QCOMPARE(response.queuedChunkBytes(), 0);
+
+    // Over the flush size, but the value is not complete yet
+    json.beginObject().field("text", QString(40, 'x'));
+    QCOMPARE(response.queuedChunkBytes(), 0);
+
+    // {"text":"xxx...x"}\n
+    json.endObject();
+    QCOMPARE(response.queuedChunkBytes(), 8 + 52);
+
+    json.finish();
+    QCOMPARE(response.queuedChunkBytes(), 8 + 52);
+}
+
+void TestHttpJsonWriter::clientGone()
+{
+    HttpResponse response(&config);
+    HttpJsonWriter json(&response, HttpStatus::Ok, HttpJsonWriter::Mode::Lines, 1);
+    json.value(1);
+    QVERIFY(json.isOpen());
+
+    // Connection is done with the response once the client disconnects
+    response.detach();
+    json.value(2);
+    QVERIFY(!json.isOpen());
+    QVERIFY(!json.flush());
+}
+
+void TestHttpJsonWriter::linesFraming()
+{
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.get("/lines");
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.status, 200);
+    QCOMPARE(response.header("Content-Type"), QString("application/x-ndjson"));
+    QCOMPARE(response.header("Transfer-Encoding"), QString("chunked"));
+    QCOMPARE(response.body, QByteArray("{\"id\":0}\n{\"id\":1}\n{\"id\":2}\n"));
+}
+
+void TestHttpJsonWriter::arrayFraming()
+{
+    HttpTestClient client;
+    QVERIFY(client.connectTo(server->serverPort()));
+    client.get("/array");
+
+    HttpTestResponse response;
+    QVERIFY(client.readResponse(&response));
+    QCOMPARE(response.status, 200);
+    QCOMPARE(response.header("Content-Type"), QString("application/json"));
+    QCOMPARE(response.body, QByteArray("[{\"id\":0},{\"id\":1},{\"id\":2}]"));
+}
+
+QTEST_GUILESS_MAIN(TestHttpJsonWriter)
+#include "tst_httpJsonWriter.moc"
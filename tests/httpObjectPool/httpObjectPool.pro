@@ -0,0 +1,6 @@
+TARGET = tst_httpObjectPool
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpObjectPool.cpp
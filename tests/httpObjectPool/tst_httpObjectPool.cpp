@@ -0,0 +1,142 @@
+#include "../httpTestClient.h"
+#include "httpServer/httpCookie.h"
+#include "httpServer/httpObjectPool.h"
+
+#include <memory>
+#include <QtTest>
+
+
+class TestHttpObjectPool : public QObject
+{
+    Q_OBJECT
+
+private:
+    HttpTestRequests requests;
+
+private slots:
+    void initTestCase();
+
+    void takeAndPut();
+    void requestReset();
+    void responseReset();
+    void releaseAfterConfigDeleted();
+};
+
+void TestHttpObjectPool::initTestCase()
+{
+    QVERIFY(requests.open());
+}
+
+void TestHttpObjectPool::takeAndPut()
+{
+    int a = 1;
+    int b = 2;
+    QCOMPARE(HttpObjectPool<int>::take(), nullptr);
+    QVERIFY(HttpObjectPool<int>::put(&a, 2));
+    QVERIFY(HttpObjectPool<int>::put(&b, 2));
+    QVERIFY(!HttpObjectPool<int>::put(&a, 2));
+
+    // Last in, first out so the most recently used object is handed out again
+    QCOMPARE(HttpObjectPool<int>::take(), &b);
+    QCOMPARE(HttpObjectPool<int>::take(), &a);
+    QCOMPARE(HttpObjectPool<int>::take(), nullptr);
+}
+
+void TestHttpObjectPool::requestReset()
+{
+    const QByteArray body("name=value&other=1");
+    HttpDataPtr data = requests.create("POST /form?query=1 HTTP/1.1\r\nHost: localhost\r\n"
+        "Cookie: session=abc\r\nX-Custom: 1\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+        "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+    QVERIFY(data);
+    QCOMPARE(data->request->state(), HttpRequest::State::Complete);
+    QCOMPARE(data->request->formFields().size(), (size_t)2);
+    QCOMPARE(data->request->cookie("session"), QString("abc"));
+
+    HttpRequest *request = data->request;
+    data.reset();
+
+    // The released request is handed out again without anything left from its previous use
+    HttpRequest *reused = HttpRequest::create(&requests.config);
+    QCOMPARE(reused, request);
+    QCOMPARE(reused->state(), HttpRequest::State::ReadRequestLine);
+    QVERIFY(reused->method().isEmpty());
+    QVERIFY(reused->uriStr().isEmpty());
+    QVERIFY(!reused->hasParameter("query"));
+    QVERIFY(!reused->hasFragment());
+    QVERIFY(reused->body().isEmpty());
+    QVERIFY(reused->cookie("session").isEmpty());
+    QVERIFY(reused->formFields().empty());
+    QVERIFY(reused->formFiles().empty());
+    QVERIFY(reused->mimeType().isEmpty());
+    QCOMPARE(reused->bufferedBytes(), 0);
+
+    QString value;
+    QVERIFY(!reused->header("X-Custom", &value));
+    QVERIFY(!reused->header("Content-Length", &value));
+
+    HttpRequest::release(reused);
+}
+
+void TestHttpObjectPool::responseReset()
+{
+    HttpResponse *response = HttpResponse::create(&requests.config);
+    HttpCookie cookie("session", "abc");
+    response->setCookie(cookie);
+    response->setHeader("X-Custom", "1");
+    response->setCacheTtl(1000);
+    response->setUpgrade([](QTcpSocket *) {});
+    response->setNotifier([]() {});
+    response->beginChunked(HttpStatus::Ok, "text/plain");
+    response->keepChunkedOpen();
+    QVERIFY(response->appendChunk("chunk"));
+    HttpResponse::release(response);
+
+    HttpResponse *reused = HttpResponse::create(&requests.config);
+    QCOMPARE(reused, response);
+    QCOMPARE(reused->status(), HttpStatus::None);
+    QVERIFY(reused->body().isEmpty());
+    QVERIFY(!reused->isChunked());
+    QVERIFY(!reused->isChunkedKeptOpen());
+    QVERIFY(!reused->isSending());
+    QVERIFY(!reused->upgradeHandler());
+    QCOMPARE(reused->queuedBytes(), 0);
+    QCOMPARE(reused->queuedChunkBytes(), 0);
+
+    QString value;
+    QVERIFY(!reused->header("X-Custom", &value));
+    QVERIFY(!reused->header("Transfer-Encoding", &value));
+    HttpCookie reusedCookie;
+    QVERIFY(!reused->cookie("session", &reusedCookie));
+
+    reused->setStatus(HttpStatus::Ok, QByteArray("body"));
+    QCOMPARE(reused->body(), QByteArray("body"));
+    HttpResponse::release(reused);
+}
+
+void TestHttpObjectPool::releaseAfterConfigDeleted()
+{
+    // Requests & responses can outlive the server, e.g. when a handler still holds the data, releasing them must not
+    // read the config they were created with
+    std::unique_ptr<HttpServerConfig> config(new HttpServerConfig());
+    config->objectPoolSize = 64;
+    HttpRequest *request = HttpRequest::create(config.get());
+    HttpResponse *response = HttpResponse::create(config.get());
+    HttpDataPtr data = std::make_shared<HttpData>(request, response);
+
+    // The pool size is taken when the object is created, so changing it afterwards has no effect
+    config->objectPoolSize = 0;
+    config.reset();
+    data.reset();
+
+    HttpServerConfig other;
+    HttpRequest *reusedRequest = HttpRequest::create(&other);
+    HttpResponse *reusedResponse = HttpResponse::create(&other);
+    QCOMPARE(reusedRequest, request);
+    QCOMPARE(reusedResponse, response);
+    HttpRequest::release(reusedRequest);
+    HttpResponse::release(reusedResponse);
+}
+
+QTEST_GUILESS_MAIN(TestHttpObjectPool)
+#include "tst_httpObjectPool.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_httpRequestRouter
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpRequestRouter.cpp
@@ -0,0 +1,482 @@
+#include "httpServer/httpRequestRouter.h"
+#include "httpTestClient.h"
+
+#include <QtTest>
+
+
+class TestHttpRequestRouter : public QObject
+{
+    Q_OBJECT
+
+private:
+    HttpTestRequests requests;
+    HttpRequestRouter router;
+    // Names of the middleware & handlers run by chain, in order
+    QStringList calls;
+
+    enum class Step
+    {
+        Data,
+        Fulfilled,
+        Pending
+    };
+
+    // Middleware that records its name and finishes with data, an already fulfilled promise or a pending promise.
+    // Sets the response status if one is given
+    HttpFunc step(const QString &name, Step result, HttpStatus status = HttpStatus::None);
+
+    // Handler that responds with the name of the route followed by its parameters
+    static HttpFunc respond(const QByteArray &name);
+
+    // Returns the response of the matching route, empty if no route matched
+    QByteArray route(const QByteArray &method, const QString &path, HttpDataPtr *result = nullptr);
+
+private slots:
+    void initTestCase();
+
+    void staticPaths();
+    void parameters();
+    void typedParameters();
+    void parameterBacktracking();
+    void wildcards();
+    void pathsBeforeRegex();
+    void regexRoutes_data();
+    void regexRoutes();
+    void regexRouteOrder();
+    void matchInState();
+    void methods();
+    void methodNotAllowed();
+    void customMethods();
+    void chainOrder_data();
+    void chainOrder();
+    void chainShortCircuit_data();
+    void chainShortCircuit();
+    void chainExceptions();
+    void routeMiddleware();
+
+    void benchmarkPathRoutes();
+    void benchmarkRegexRoutes();
+};
+
+HttpFunc TestHttpRequestRouter::respond(const QByteArray &name)
+{
+    return [name](HttpDataPtr data) -> HttpResult {
+        QByteArray body = name;
+        for (int i = 0; i < data->params.size(); ++i)
+            body += " " + data->param(i).toUtf8();
+
+        data->response->setStatus(HttpStatus::Ok, body, "text/plain");
+        return data;
+    };
+}
+
+HttpFunc TestHttpRequestRouter::step(const QString &name, Step result, HttpStatus status)
+{
+    return [this, name, result, status](HttpDataPtr data) -> HttpResult {
+        calls.append(name);
+        if (status != HttpStatus::None)
+            data->response->setStatus(status, name.toUtf8(), "text/plain");
+
+        switch (result)
+        {
+            case Step::Data:
+                return data;
+            case Step::Fulfilled:
+                return HttpPromise::resolve(data);
+            case Step::Pending:
+            default:
+                return HttpPromise::resolve(data).delay(1);
+        }
+    };
+}
+
+QByteArray TestHttpRequestRouter::route(const QByteArray &method, const QString &path, HttpDataPtr *result)
+{
+    HttpDataPtr data = requests.create(method, path);
+    if (!data)
+    {
+        qWarning() << "Request was not parsed" << method << path;
+        return QByteArray();
+    }
+
+    if (result)
+        *result = data;
+
+    bool foundRoute = false;
+    router.dispatch(data, &foundRoute);
+    if (!foundRoute || data->response->status() != HttpStatus::Ok)
+        return QByteArray();
+
+    return data->response->body();
+}
+
+void TestHttpRequestRouter::initTestCase()
+{
+    QVERIFY(requests.open());
+
+    router.addPath("GET", "/", respond("root"));
+    router.addPath("GET", "/users", respond("users"));
+    router.addPath("GET", "/user", respond("user"));
+    router.addPath("GET", "/users/me", respond("me"));
+    router.addPath("GET", "/users/:name", respond("userByName"));
+    router.addPath("GET", "/users/:id<int>", respond("userById"));
+    router.addPath("GET", "/users/:id<int>/posts/:post", respond("post"));
+    router.addPath("GET", "/users/:name/profile", respond("profile"));
+    router.addPath("GET", "/files/readme", respond("readme"));
+    router.addPath("GET", "/files/*path", respond("files"));
+    router.addPath("GET", "/a:b/c*", respond("literal"));
+
+    router.addPath({"GET", "POST"}, "/items", respond("items"));
+    router.addPath(HttpMethod::Delete, "/items", respond("deleteItem"));
+
+    router.addPath("GET", "/api/v1/path", respond("path"));
+    router.addRoute("GET", "^/api/v1/(\\w+)/?$", respond("v1"));
+    router.addRoute("GET", "^/api/v1/special$", respond("special"));
+    router.addRoute("GET", "^/api/v2/(\\w+)$", respond("v2"));
+    router.addRoute("GET", "^/a\\.b$", respond("escaped"));
+    router.addRoute("GET", "^/opt?ional$", respond("optional"));
+    router.addRoute("GET", "^/left$|/right$", respond("alternation"));
+    router.addRoute("GET", "(\\d+)\\.json$", respond("json"));
+    router.addRoute("POST", "^/submit$", respond("submit"));
+}
+
+void TestHttpRequestRouter::staticPaths()
+{
+    QCOMPARE(route("GET", "/"), QByteArray("root"));
+    QCOMPARE(route("GET", "/users"), QByteArray("users"));
+    QCOMPARE(route("GET", "/user"), QByteArray("user"));
+    QCOMPARE(route("GET", "/users/me"), QByteArray("me"));
+
+    // Trailing slash is optional
+    QCOMPARE(route("GET", "/users/"), QByteArray("users"));
+    QCOMPARE(route("GET", "/usersx"), QByteArray());
+    QCOMPARE(route("GET", "/use"), QByteArray());
+
+    // : and * are only parameters at the start of a segment
+    QCOMPARE(route("GET", "/a:b/c*"), QByteArray("literal"));
+    QCOMPARE(route("GET", "/a:x/c*"), QByteArray());
+}
+
+void TestHttpRequestRouter::parameters()
+{
+    HttpDataPtr data;
+    QCOMPARE(route("GET", "/users/bob", &data), QByteArray("userByName bob"));
+    QCOMPARE(data->param("name"), QString("bob"));
+    QCOMPARE(data->param("id"), QString());
+    QVERIFY(data->param(1).isNull());
+
+    QCOMPARE(route("GET", "/users/42/posts/hello", &data), QByteArray("post 42 hello"));
+    QCOMPARE(data->param("id"), QString("42"));
+    QCOMPARE(data->param("post"), QString("hello"));
+    QVERIFY(!data->params.match().isValid());
+
+    // Parameters cannot be empty & do not span segments
+    QCOMPARE(route("GET", "/users//posts/hello"), QByteArray());
+    QCOMPARE(route("GET", "/users/a/b"), QByteArray());
+}
+
+void TestHttpRequestRouter::typedParameters()
+{
+    QCOMPARE(route("GET", "/users/42"), QByteArray("userById 42"));
+    QCOMPARE(route("GET", "/users/-3"), QByteArray("userById -3"));
+    QCOMPARE(route("GET", "/users/4x2"), QByteArray("userByName 4x2"));
+    QCOMPARE(route("GET", "/users/-"), QByteArray("userByName -"));
+    QCOMPARE(route("GET", "/users/99999999999999999999"), QByteArray("userByName 99999999999999999999"));
+
+    // Static text is preferred over parameters
+    QCOMPARE(route("GET", "/users/me"), QByteArray("me"));
+
+    HttpDataPtr data;
+    bool ok = false;
+    QCOMPARE(route("GET", "/users/-3/posts/hello", &data), QByteArray("post -3 hello"));
+    QCOMPARE(data->paramInt("id", &ok), -3ll);
+    QVERIFY(ok);
+    QCOMPARE(data->paramInt(0), -3ll);
+    QCOMPARE(data->paramInt("post", &ok), 0ll);
+    QVERIFY(!ok);
+    QCOMPARE(data->paramInt("missing", &ok), 0ll);
+    QVERIFY(!ok);
+
+    // Capture groups of regex routes
+    QCOMPARE(route("GET", "/reports/12.json", &data), QByteArray("json 12"));
+    QCOMPARE(data->paramInt(0, &ok), 12ll);
+    QVERIFY(ok);
+    QCOMPARE(data->paramInt(1, &ok), 0ll);
+    QVERIFY(!ok);
+    QCOMPARE(data->paramInt(-1, &ok), 0ll);
+    QVERIFY(!ok);
+}
+
+void TestHttpRequestRouter::parameterBacktracking()
+{
+    // Int parameter matches first but has no /profile route, the string parameter does
+    QCOMPARE(route("GET", "/users/42/profile"), QByteArray("profile 42"));
+    QCOMPARE(route("GET", "/users/bob/profile"), QByteArray("profile bob"));
+    QCOMPARE(route("GET", "/users/bob/posts/hello"), QByteArray());
+}
+
+void TestHttpRequestRouter::wildcards()
+{
+    HttpDataPtr data;
+    QCOMPARE(route("GET", "/files/a/b/c.txt", &data), QByteArray("files a/b/c.txt"));
+    QCOMPARE(data->param("path"), QString("a/b/c.txt"));
+
+    QCOMPARE(route("GET", "/files/"), QByteArray("files "));
+    QCOMPARE(route("GET", "/files/readme"), QByteArray("readme"));
+    QCOMPARE(route("GET", "/files/readme.md"), QByteArray("files readme.md"));
+}
+
+void TestHttpRequestRouter::pathsBeforeRegex()
+{
+    QCOMPARE(route("GET", "/api/v1/path"), QByteArray("path"));
+    QCOMPARE(route("GET", "/api/v1/other"), QByteArray("v1 other"));
+}
+
+void TestHttpRequestRouter::regexRoutes_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QByteArray>("expected");
+
+    QTest::newRow("capture") << "/api/v1/users" << QByteArray("v1 users");
+    QTest::newRow("optional slash") << "/api/v1/users/" << QByteArray("v1 users");
+    QTest::newRow("sibling prefix") << "/api/v2/users" << QByteArray("v2 users");
+    QTest::newRow("no route") << "/api/v3/users" << QByteArray();
+    QTest::newRow("escaped dot") << "/a.b" << QByteArray("escaped");
+    QTest::newRow("escaped dot is literal") << "/axb" << QByteArray();
+    QTest::newRow("optional character") << "/opional" << QByteArray("optional");
+    QTest::newRow("optional character present") << "/optional" << QByteArray("optional");
+    QTest::newRow("first alternative") << "/left" << QByteArray("alternation");
+    QTest::newRow("unanchored alternative") << "/some/right" << QByteArray("alternation");
+    QTest::newRow("unanchored") << "/reports/12.json" << QByteArray("json 12");
+}
+
+void TestHttpRequestRouter::regexRoutes()
+{
+    QFETCH(QString, path);
+    QFETCH(QByteArray, expected);
+
+    HttpDataPtr data;
+    QCOMPARE(route("GET", path, &data), expected);
+    if (!expected.isEmpty())
+        QVERIFY(data->params.match().hasMatch());
+}
+
+void TestHttpRequestRouter::regexRouteOrder()
+{
+    // Both routes match, the one added first wins even though the other has a longer literal prefix
+    QCOMPARE(route("GET", "/api/v1/special"), QByteArray("v1 special"));
+}
+
+void TestHttpRequestRouter::matchInState()
+{
+    // Off by default, handlers that do not use the match pay nothing for it
+    HttpDataPtr data;
+    QCOMPARE(route("GET", "/api/v2/users", &data), QByteArray("v2 users"));
+    QVERIFY(data->state.empty());
+
+    router.setStoreMatchInState(true);
+    QCOMPARE(route("GET", "/api/v2/users", &data), QByteArray("v2 users"));
+    QCOMPARE(data->state["matches"].toStringList(), QStringList({"/api/v2/users", "users"}));
+    QCOMPARE(data->state["match"].value<QRegularExpressionMatch>().captured(1), QString("users"));
+    router.setStoreMatchInState(false);
+}
+
+void TestHttpRequestRouter::methods()
+{
+    QCOMPARE(route("GET", "/items"), QByteArray("items"));
+    QCOMPARE(route("POST", "/items"), QByteArray("items"));
+    QCOMPARE(route("DELETE", "/items"), QByteArray("deleteItem"));
+    QCOMPARE(route("POST", "/submit"), QByteArray("submit"));
+}
+
+void TestHttpRequestRouter::methodNotAllowed()
+{
+    HttpDataPtr data;
+    QCOMPARE(route("PUT", "/items", &data), QByteArray());
+    QCOMPARE(data->response->status(), HttpStatus::MethodNotAllowed);
+
+    QString allow;
+    QVERIFY(data->response->header("Allow", &allow));
+    QCOMPARE(allow, QString("GET, POST, DELETE"));
+
+    QCOMPARE(route("GET", "/submit", &data), QByteArray());
+    QCOMPARE(data->response->status(), HttpStatus::MethodNotAllowed);
+    QVERIFY(data->response->header("Allow", &allow));
+    QCOMPARE(allow, QString("POST"));
+
+    // Paths without any route are left to the request handler
+    bool foundRoute = true;
+    data = requests.create("PUT", "/missing");
+    QVERIFY(data);
+    router.dispatch(data, &foundRoute);
+    QVERIFY(!foundRoute);
+    QVERIFY(!data->response->isValid());
+}
+
+void TestHttpRequestRouter::customMethods()
+{
+    const HttpMethod propfind = registerHttpMethod("PROPFIND");
+    QVERIFY(propfind != HttpMethod::None);
+    QCOMPARE(registerHttpMethod("PROPFIND"), propfind);
+
+    router.addPath("PROPFIND", "/dav/*path", respond("propfind"));
+
+    HttpDataPtr data;
+    QCOMPARE(route("PROPFIND", "/dav/folder", &data), QByteArray("propfind folder"));
+    QCOMPARE(data->request->httpMethod(), propfind);
+
+    QCOMPARE(route("GET", "/dav/folder", &data), QByteArray());
+    QString allow;
+    QVERIFY(data->response->header("Allow", &allow));
+    QCOMPARE(allow, QString("PROPFIND"));
+}
+
+void TestHttpRequestRouter::chainOrder_data()
+{
+    QTest::addColumn<int>("first");
+    QTest::addColumn<int>("second");
+    QTest::addColumn<bool>("ready");
+
+    // Only a pending promise makes the chain wait, anything else runs the next step right away
+    QTest::newRow("data") << int(Step::Data) << int(Step::Data) << true;
+    QTest::newRow("fulfilled promises") << int(Step::Fulfilled) << int(Step::Fulfilled) << true;
+    QTest::newRow("mixed") << int(Step::Data) << int(Step::Fulfilled) << true;
+    QTest::newRow("pending first") << int(Step::Pending) << int(Step::Data) << false;
+    QTest::newRow("pending second") << int(Step::Fulfilled) << int(Step::Pending) << false;
+}
+
+void TestHttpRequestRouter::chainOrder()
+{
+    QFETCH(int, first);
+    QFETCH(int, second);
+    QFETCH(bool, ready);
+
+    calls.clear();
+    HttpFunc chained = HttpRequestRouter::chain({step("first", Step(first)), step("second", Step(second))},
+        step("handler", Step::Data, HttpStatus::Ok));
+
+    HttpDataPtr data = requests.create("GET", "/");
+    QVERIFY(data);
+
+    HttpResult result = chained(data);
+    QCOMPARE(result.isReady(), ready);
+    if (!ready)
+        result.toPromise().wait();
+
+    QCOMPARE(calls, QStringList({"first", "second", "handler"}));
+    QCOMPARE(data->response->body(), QByteArray("handler"));
+}
+
+void TestHttpRequestRouter::chainShortCircuit_data()
+{
+    QTest::addColumn<int>("result");
+
+    QTest::newRow("data") << int(Step::Data);
+    QTest::newRow("fulfilled promise") << int(Step::Fulfilled);
+    QTest::newRow("pending promise") << int(Step::Pending);
+}
+
+void TestHttpRequestRouter::chainShortCircuit()
+{
+    QFETCH(int, result);
+
+    // Middleware that sets the response skips the rest of the chain, whichever way it finishes
+    calls.clear();
+    HttpFunc chained = HttpRequestRouter::chain({step("first", Step::Data),
+        step("respond", Step(result), HttpStatus::NoContent), step("third", Step::Data)},
+        step("handler", Step::Data, HttpStatus::Ok));
+
+    HttpDataPtr data = requests.create("GET", "/");
+    QVERIFY(data);
+    chained(data).toPromise().wait();
+
+    QCOMPARE(calls, QStringList({"first", "respond"}));
+    QCOMPARE(data->response->status(), HttpStatus::NoContent);
+}
+
+void TestHttpRequestRouter::chainExceptions()
+{
+    calls.clear();
+    HttpFunc failing = [this](HttpDataPtr) -> HttpResult {
+        calls.append("failing");
+        throw HttpException(HttpStatus::Forbidden);
+    };
+
+    // Synchronous middleware throws to the caller like a handler would
+    HttpDataPtr data = requests.create("GET", "/");
+    QVERIFY(data);
+    HttpFunc chained = HttpRequestRouter::chain({failing}, step("handler", Step::Data, HttpStatus::Ok));
+    QVERIFY_EXCEPTION_THROWN(chained(data), HttpException);
+
+    // After a pending step, the exception rejects the promise
+    HttpStatus status = HttpStatus::None;
+    chained = HttpRequestRouter::chain({step("pending", Step::Pending), failing},
+        step("handler", Step::Data, HttpStatus::Ok));
+    chained(data).toPromise().fail([&](const HttpException &error) {
+        status = error.status;
+        return nullptr;
+    }).wait();
+
+    QCOMPARE(status, HttpStatus::Forbidden);
+    QCOMPARE(calls, QStringList({"failing", "pending", "failing"}));
+}
+
+void TestHttpRequestRouter::routeMiddleware()
+{
+    calls.clear();
+    router.addPath("GET", "/chained/:id", {step("first", Step::Data), step("second", Step::Fulfilled)},
+        respond("chained"));
+
+    QCOMPARE(route("GET", "/chained/7"), QByteArray("chained 7"));
+    QCOMPARE(calls, QStringList({"first", "second"}));
+
+    // Middleware runs for regex routes too, and can answer the request itself
+    calls.clear();
+    router.addRoute("GET", "^/guarded$", {step("guard", Step::Data, HttpStatus::Ok)}, respond("guarded"));
+    QCOMPARE(route("GET", "/guarded"), QByteArray("guard"));
+    QCOMPARE(calls, QStringList({"guard"}));
+}
+
+void TestHttpRequestRouter::benchmarkPathRoutes()
+{
+    HttpRequestRouter benchmarkRouter;
+    HttpFunc handler = [](HttpDataPtr data) -> HttpResult { return data; };
+    for (int i = 0; i < 500; ++i)
+        benchmarkRouter.addPath("GET", QString("/resource%1/:id<int>/items/:item").arg(i), handler);
+
+    HttpDataPtr data = requests.create("GET", "/resource499/42/items/abc");
+    QVERIFY(data);
+
+    bool foundRoute = false;
+    QBENCHMARK
+    {
+        data->params.clear();
+        benchmarkRouter.dispatch(data, &foundRoute);
+    }
+
+    QVERIFY(foundRoute);
+    QCOMPARE(data->param("item"), QString("abc"));
+}
+
+void TestHttpRequestRouter::benchmarkRegexRoutes()
+{
+    HttpRequestRouter benchmarkRouter;
+    HttpFunc handler = [](HttpDataPtr data) -> HttpResult { return data; };
+    for (int i = 0; i < 500; ++i)
+        benchmarkRouter.addRoute("GET", QString("^/resource%1/(\\d+)/items/(\\w+)$").arg(i), handler);
+
+    HttpDataPtr data = requests.create("GET", "/resource499/42/items/abc");
+    QVERIFY(data);
+
+    bool foundRoute = false;
+    QBENCHMARK
+    {
+        benchmarkRouter.dispatch(data, &foundRoute);
+    }
+
+    QVERIFY(foundRoute);
+    QCOMPARE(data->param(1), QString("abc"));
+}
+
+QTEST_GUILESS_MAIN(TestHttpRequestRouter)
+#include "tst_httpRequestRouter.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_httpResponse
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpResponse.cpp
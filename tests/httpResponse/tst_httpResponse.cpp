@@ -0,0 +1,91 @@
+#include "httpServer/httpResponse.h"
+
+#include <QBuffer>
+#include <QtTest>
+
+
+class TestHttpResponse : public QObject
+{
+    Q_OBJECT
+
+private:
+    HttpServerConfig config;
+
+    static QString contentType(const HttpResponse &response);
+
+private slots:
+    void sendDeviceDetectsType_data();
+    void sendDeviceDetectsType();
+    void queuedBytes_data();
+    void queuedBytes();
+};
+
+QString TestHttpResponse::contentType(const HttpResponse &response)
+{
+    QString value;
+    response.header("Content-Type", &value);
+    return value;
+}
+
+void TestHttpResponse::sendDeviceDetectsType_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<int>("len");
+    QTest::addColumn<QString>("mimeType");
+
+    const QByteArray png("\x89PNG\r\n\x1a\n", 8);
+    QTest::newRow("text") << QByteArray("Hello world") << -1 << "text/plain";
+    QTest::newRow("html") << QByteArray("<!DOCTYPE html><html></html>") << -1 << "text/html";
+    QTest::newRow("png") << png + QByteArray(32, '\0') << -1 << "image/png";
+    // Only the part that is sent is looked at, not what is left on the device
+    QTest::newRow("png with length") << png + QByteArray("trailing text") << 8 << "image/png";
+    QTest::newRow("empty") << QByteArray() << -1 << "application/x-zerosize";
+}
+
+void TestHttpResponse::sendDeviceDetectsType()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(int, len);
+    QFETCH(QString, mimeType);
+
+    QBuffer device(&data);
+    QVERIFY(device.open(QIODevice::ReadOnly));
+
+    HttpResponse response(&config);
+    response.sendFile(&device, "", "", len);
+    QCOMPARE(contentType(response), mimeType);
+    QCOMPARE(response.body(), len == -1 ? data : data.left(len));
+}
+
+void TestHttpResponse::queuedBytes_data()
+{
+    QTest::addColumn<bool>("compress");
+
+    QTest::newRow("plain") << false;
+    QTest::newRow("compressed while sending") << true;
+}
+
+void TestHttpResponse::queuedBytes()
+{
+    QFETCH(bool, compress);
+
+    HttpServerConfig streamingConfig;
+    streamingConfig.streamingCompressionMinSize = 1024;
+    const QByteArray body(100 * 1024, 'a');
+
+    HttpResponse response(&streamingConfig);
+    response.setStatus(HttpStatus::Ok, body, "text/plain");
+    if (compress)
+        response.compressBody();
+
+    // Nothing is queued until the response is being sent
+    QCOMPARE(response.queuedBytes(), 0);
+
+    // The entire body counts as queued, even the part that has not been compressed into the buffer yet
+    response.prepareToSend();
+    QVERIFY(response.queuedBytes() > body.size());
+    QVERIFY(response.queuedBytes() < body.size() + 1024);
+}
+
+QTEST_GUILESS_MAIN(TestHttpResponse)
+#include "tst_httpResponse.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_httpResponseCache
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpResponseCache.cpp
@@ -0,0 +1,195 @@
+#include "httpServer/httpServer.h"
+#include "httpServer/middleware.h"
+#include "httpTestClient.h"
+
+#include <QtTest>
+
+
+class TestHttpResponseCache : public QObject
+{
+    Q_OBJECT
+
+private:
+    TestRequestHandler handler;
+    HttpServer *server = nullptr;
+    HttpTestClient *client = nullptr;
+    // Number of requests that reached a handler instead of being served from the cache
+    int handlerCalls = 0;
+
+    HttpTestResponse get(const QString &path, const QByteArray &headers = QByteArray());
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+    void cachedResponse();
+    void queryIsPartOfKey();
+    void varyHeaders();
+    void corsOrigins();
+    void expiration();
+    void connectionClose();
+    void uncachedRoute();
+};
+
+void TestHttpResponseCache::initTestCase()
+{
+    handler.router.addPath("GET", "/counter/:name", [this](HttpDataPtr data) -> HttpResult {
+        ++handlerCalls;
+        data->response->setStatus(HttpStatus::Ok, QString("%1 %2").arg(data->param("name"))
+            .arg(data->request->uri().query()).toUtf8(), "text/plain");
+        data->response->setCacheTtl(60 * 1000);
+        return data;
+    });
+
+    handler.router.addPath("GET", "/vary", [this](HttpDataPtr data) -> HttpResult {
+        ++handlerCalls;
+        data->response->setStatus(HttpStatus::Ok, data->request->headerDefault("Accept-Language", "").toUtf8(),
+            "text/plain");
+        data->response->setHeader("Vary", "Accept-Language");
+        data->response->setCacheTtl(60 * 1000);
+        return data;
+    });
+
+    handler.router.addPath("GET", "/cors", {middleware::CORS}, [this](HttpDataPtr data) -> HttpResult {
+        ++handlerCalls;
+        data->response->setStatus(HttpStatus::Ok, QByteArray("cors"), "text/plain");
+        data->response->setCacheTtl(60 * 1000);
+        return data;
+    });
+
+    handler.router.addPath("GET", "/short", [this](HttpDataPtr data) -> HttpResult {
+        ++handlerCalls;
+        data->response->setStatus(HttpStatus::Ok, QByteArray("short"), "text/plain");
+        data->response->setCacheTtl(100);
+        return data;
+    });
+
+    handler.router.addPath("GET", "/uncached", [this](HttpDataPtr data) -> HttpResult {
+        ++handlerCalls;
+        data->response->setStatus(HttpStatus::Ok, QByteArray("uncached"), "text/plain");
+        return data;
+    });
+
+    HttpServerConfig config;
+    config.host = QHostAddress::LocalHost;
+    config.port = 0;
+    config.responseCacheSize = 1024 * 1024;
+
+    server = new HttpServer(config, &handler);
+    QVERIFY(server->listen());
+}
+
+void TestHttpResponseCache::cleanupTestCase()
+{
+    delete server;
+}
+
+void TestHttpResponseCache::init()
+{
+    handlerCalls = 0;
+    client = new HttpTestClient();
+    QVERIFY(client->connectTo(server->serverPort()));
+}
+
+void TestHttpResponseCache::cleanup()
+{
+    delete client;
+    client = nullptr;
+}
+
+HttpTestResponse TestHttpResponseCache::get(const QString &path, const QByteArray &headers)
+{
+    HttpTestResponse response;
+    client->get(path, headers);
+    if (!client->readResponse(&response))
+        qWarning() << "No response for" << path;
+
+    return response;
+}
+
+void TestHttpResponseCache::cachedResponse()
+{
+    const HttpTestResponse first = get("/counter/cached");
+    QCOMPARE(first.status, 200);
+    QCOMPARE(first.body, QByteArray("cached "));
+
+    const HttpTestResponse second = get("/counter/cached");
+    QCOMPARE(second.status, 200);
+    QCOMPARE(second.body, first.body);
+    QCOMPARE(handlerCalls, 1);
+}
+
+void TestHttpResponseCache::queryIsPartOfKey()
+{
+    QCOMPARE(get("/counter/query?page=1").body, QByteArray("query page=1"));
+    QCOMPARE(get("/counter/query?page=2").body, QByteArray("query page=2"));
+    QCOMPARE(get("/counter/query").body, QByteArray("query "));
+    QCOMPARE(handlerCalls, 3);
+
+    // Each query is cached on its own
+    QCOMPARE(get("/counter/query?page=1").body, QByteArray("query page=1"));
+    QCOMPARE(get("/counter/query?page=2").body, QByteArray("query page=2"));
+    QCOMPARE(handlerCalls, 3);
+}
+
+void TestHttpResponseCache::varyHeaders()
+{
+    QCOMPARE(get("/vary", "Accept-Language: en\r\n").body, QByteArray("en"));
+    QCOMPARE(get("/vary", "Accept-Language: fr\r\n").body, QByteArray("fr"));
+    QCOMPARE(handlerCalls, 2);
+
+    QCOMPARE(get("/vary", "Accept-Language: en\r\n").body, QByteArray("en"));
+    QCOMPARE(get("/vary", "Accept-Language: fr\r\n").body, QByteArray("fr"));
+    QCOMPARE(handlerCalls, 2);
+}
+
+void TestHttpResponseCache::corsOrigins()
+{
+    const HttpTestResponse first = get("/cors", "Origin: https://a.example\r\n");
+    QCOMPARE(first.header("Access-Control-Allow-Origin"), QString("https://a.example"));
+    QVERIFY(first.header("Vary").contains("Origin"));
+
+    // Another origin must not get the response cached for the first one
+    const HttpTestResponse second = get("/cors", "Origin: https://b.example\r\n");
+    QCOMPARE(second.header("Access-Control-Allow-Origin"), QString("https://b.example"));
+    QCOMPARE(handlerCalls, 2);
+
+    const HttpTestResponse third = get("/cors", "Origin: https://a.example\r\n");
+    QCOMPARE(third.header("Access-Control-Allow-Origin"), QString("https://a.example"));
+    QCOMPARE(handlerCalls, 2);
+}
+
+void TestHttpResponseCache::expiration()
+{
+    get("/short");
+    get("/short");
+    QCOMPARE(handlerCalls, 1);
+
+    QTest::qWait(200);
+    get("/short");
+    QCOMPARE(handlerCalls, 2);
+}
+
+void TestHttpResponseCache::connectionClose()
+{
+    get("/counter/close");
+    QCOMPARE(handlerCalls, 1);
+
+    // Cached responses keep the connection alive, so requests asking to close it go through the handler
+    const HttpTestResponse response = get("/counter/close", "Connection: close\r\n");
+    QCOMPARE(response.status, 200);
+    QCOMPARE(handlerCalls, 2);
+    QVERIFY(client->waitForDisconnected());
+}
+
+void TestHttpResponseCache::uncachedRoute()
+{
+    get("/uncached");
+    get("/uncached");
+    QCOMPARE(handlerCalls, 2);
+}
+
+QTEST_GUILESS_MAIN(TestHttpResponseCache)
+#include "tst_httpResponseCache.moc"
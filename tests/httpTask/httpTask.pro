@@ -0,0 +1,11 @@
+TARGET = tst_httpTask
+
+include(../tests.pri)
+
+# Coroutine handlers need C++20, the library itself is still built as C++11
+CONFIG -= c++11
+CONFIG += c++2a
+gcc:!clang: QMAKE_CXXFLAGS += -fcoroutines
+
+SOURCES += \
+        tst_httpTask.cpp
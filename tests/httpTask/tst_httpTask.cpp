@@ -0,0 +1,201 @@
+#include "httpServer/httpServer.h"
+#include "httpServer/httpTask.h"
+#include "httpTestClient.h"
+
+#include <memory>
+#include <QtTest>
+#include <stdexcept>
+
+#ifndef HTTP_SERVER_COROUTINES
+#error "tst_httpTask must be compiled as C++20 with coroutine support"
+#endif
+
+
+class TestHttpTask : public QObject
+{
+    Q_OBJECT
+
+private:
+    TestRequestHandler handler;
+    std::unique_ptr<HttpServer> server;
+    HttpTestRequests requests;
+
+    // Sends a GET request for path to the server, returns false if no response was received
+    bool get(const QString &path, HttpTestResponse *response);
+
+    static HttpTask finishWithoutSuspending(HttpDataPtr data);
+    static HttpTask awaitPromise(HttpDataPtr data);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void framePool();
+    void readyWithoutSuspending();
+    void pendingWhileAwaiting();
+    void synchronousRoute();
+    void awaitingRoute();
+    void awaitDelayAndPool();
+    void exceptions_data();
+    void exceptions();
+};
+
+HttpTask TestHttpTask::finishWithoutSuspending(HttpDataPtr data)
+{
+    data->response->setStatus(HttpStatus::Ok, QByteArray("sync"), "text/plain");
+    co_return data;
+}
+
+HttpTask TestHttpTask::awaitPromise(HttpDataPtr data)
+{
+    QString value = co_await QtPromise::resolve(QString("awaited")).delay(1);
+    data->response->setStatus(HttpStatus::Ok, value.toUtf8(), "text/plain");
+    co_return data;
+}
+
+void TestHttpTask::initTestCase()
+{
+    QVERIFY(requests.open());
+
+    handler.router.addPath("GET", "/sync", &TestHttpTask::finishWithoutSuspending);
+    handler.router.addPath("GET", "/await", &TestHttpTask::awaitPromise);
+
+    handler.router.addPath("GET", "/delay", [](HttpDataPtr data) -> HttpTask {
+        co_await HttpDelay(10);
+        const int sum = co_await httpRunInPool([]() { return 1 + 2; });
+        data->response->setStatus(HttpStatus::Ok, QByteArray::number(sum), "text/plain");
+        co_return data;
+    });
+
+    handler.router.addPath("GET", "/throw/sync", [](HttpDataPtr data) -> HttpTask {
+        throw HttpException(HttpStatus::UnprocessableEntity);
+        co_return data;
+    });
+
+    handler.router.addPath("GET", "/throw/await", [](HttpDataPtr data) -> HttpTask {
+        co_await HttpDelay(1);
+        throw HttpException(HttpStatus::UnprocessableEntity);
+        co_return data;
+    });
+
+    handler.router.addPath("GET", "/throw/promise", [](HttpDataPtr data) -> HttpTask {
+        co_await QtPromise::QPromise<void>::reject(std::runtime_error("rejected")).delay(1);
+        co_return data;
+    });
+
+    HttpServerConfig config;
+    config.host = QHostAddress::LocalHost;
+    config.port = 0;
+    server.reset(new HttpServer(config, &handler));
+    QVERIFY(server->listen());
+}
+
+void TestHttpTask::cleanupTestCase()
+{
+    server.reset();
+}
+
+bool TestHttpTask::get(const QString &path, HttpTestResponse *response)
+{
+    HttpTestClient client;
+    if (!client.connectTo(server->serverPort()))
+        return false;
+
+    client.get(path);
+    return client.readResponse(response);
+}
+
+void TestHttpTask::framePool()
+{
+    // Frames of a similar size are handed out again once freed
+    void *frame = httpAllocateFrame(300);
+    httpDeallocateFrame(frame, 300);
+    void *reused = httpAllocateFrame(400);
+    QCOMPARE(reused, frame);
+    httpDeallocateFrame(reused, 400);
+
+    // Frames too large for the pool come from the heap
+    void *large = httpAllocateFrame(64 * 1024);
+    QVERIFY(large);
+    httpDeallocateFrame(large, 64 * 1024);
+}
+
+void TestHttpTask::readyWithoutSuspending()
+{
+    HttpDataPtr data = requests.create("GET", "/sync");
+    QVERIFY(data);
+
+    HttpTask task = finishWithoutSuspending(data);
+    QVERIFY(task.isReady());
+
+    // The result holds the data right away, no promise is created
+    HttpResult result = std::move(task);
+    QVERIFY(result.isReady());
+    QCOMPARE(data->response->body(), QByteArray("sync"));
+}
+
+void TestHttpTask::pendingWhileAwaiting()
+{
+    HttpDataPtr data = requests.create("GET", "/await");
+    QVERIFY(data);
+
+    HttpTask task = awaitPromise(data);
+    QVERIFY(!task.isReady());
+
+    HttpResult result = std::move(task);
+    QVERIFY(!result.isReady());
+
+    bool resolved = false;
+    result.toPromise().then([&](HttpDataPtr resolvedData) {
+        resolved = resolvedData == data;
+    });
+    QTRY_VERIFY(resolved);
+    QCOMPARE(data->response->body(), QByteArray("awaited"));
+}
+
+void TestHttpTask::synchronousRoute()
+{
+    HttpTestResponse response;
+    QVERIFY(get("/sync", &response));
+    QCOMPARE(response.status, 200);
+    QCOMPARE(response.body, QByteArray("sync"));
+}
+
+void TestHttpTask::awaitingRoute()
+{
+    HttpTestResponse response;
+    QVERIFY(get("/await", &response));
+    QCOMPARE(response.status, 200);
+    QCOMPARE(response.body, QByteArray("awaited"));
+}
+
+void TestHttpTask::awaitDelayAndPool()
+{
+    HttpTestResponse response;
+    QVERIFY(get("/delay", &response));
+    QCOMPARE(response.status, 200);
+    QCOMPARE(response.body, QByteArray("3"));
+}
+
+void TestHttpTask::exceptions_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<int>("status");
+
+    QTest::newRow("before suspending") << "/throw/sync" << 422;
+    QTest::newRow("after suspending") << "/throw/await" << 422;
+    QTest::newRow("rejected promise") << "/throw/promise" << 500;
+}
+
+void TestHttpTask::exceptions()
+{
+    QFETCH(QString, path);
+    QFETCH(int, status);
+
+    HttpTestResponse response;
+    QVERIFY(get(path, &response));
+    QCOMPARE(response.status, status);
+}
+
+QTEST_GUILESS_MAIN(TestHttpTask)
+#include "tst_httpTask.moc"
@@ -0,0 +1,209 @@
+#ifndef HTTP_SERVER_TEST_HTTP_TEST_CLIENT_H
+#define HTTP_SERVER_TEST_HTTP_TEST_CLIENT_H
+
+#include "httpServer/httpData.h"
+#include "httpServer/httpRequest.h"
+#include "httpServer/httpRequestHandler.h"
+#include "httpServer/httpRequestRouter.h"
+#include "httpServer/httpResponse.h"
+
+#include <memory>
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtTest>
+
+
+// Request handler for the tests, requests are dispatched to the router and 404 is sent if no route matches
+class TestRequestHandler : public HttpRequestHandler
+{
+public:
+    HttpRequestRouter router;
+
+    HttpPromise handle(HttpDataPtr data) override
+    {
+        return dispatch(data).toPromise();
+    }
+
+    HttpResult dispatch(HttpDataPtr data) override
+    {
+        bool foundRoute;
+        HttpResult result = router.dispatch(data, &foundRoute);
+        if (!foundRoute)
+            throw HttpException(HttpStatus::NotFound);
+
+        return result;
+    }
+};
+
+struct HttpTestResponse
+{
+    int status = 0;
+    // Header names are lowercase
+    QMap<QString, QString> headers;
+    QByteArray body;
+
+    QString header(const QString &name) const
+    {
+        return headers.value(name.toLower());
+    }
+};
+
+// Minimal HTTP/1.1 client, reads responses with a Content-Length or a chunked body
+class HttpTestClient
+{
+private:
+    QByteArray received;
+
+    // Removes one complete response from the received data, returns false if it is not complete yet
+    bool takeResponse(HttpTestResponse *response)
+    {
+        const int headerEnd = received.indexOf("\r\n\r\n");
+        if (headerEnd == -1)
+            return false;
+
+        HttpTestResponse result;
+        const QList<QByteArray> lines = received.left(headerEnd).split('\n');
+        result.status = lines[0].split(' ').value(1).toInt();
+        for (int i = 1; i < lines.size(); ++i)
+        {
+            const int colon = lines[i].indexOf(':');
+            if (colon != -1)
+            {
+                result.headers.insertMulti(QString::fromLatin1(lines[i].left(colon)).trimmed().toLower(),
+                    QString::fromLatin1(lines[i].mid(colon + 1)).trimmed());
+            }
+        }
+
+        int index = headerEnd + 4;
+        if (result.header("Transfer-Encoding").contains("chunked", Qt::CaseInsensitive))
+        {
+            while (true)
+            {
+                const int lineEnd = received.indexOf("\r\n", index);
+                if (lineEnd == -1)
+                    return false;
+
+                const int size = received.mid(index, lineEnd - index).toInt(nullptr, 16);
+                if (received.size() < lineEnd + 2 + size + 2)
+                    return false;
+
+                result.body += received.mid(lineEnd + 2, size);
+                index = lineEnd + 2 + size + 2;
+                if (size == 0)
+                    break;
+            }
+        }
+        else
+        {
+            const int length = result.header("Content-Length").toInt();
+            if (received.size() < index + length)
+                return false;
+
+            result.body = received.mid(index, length);
+            index += length;
+        }
+
+        received.remove(0, index);
+        *response = result;
+        return true;
+    }
+
+public:
+    QTcpSocket socket;
+
+    bool connectTo(quint16 port)
+    {
+        socket.connectToHost(QHostAddress::LocalHost, port);
+        return socket.waitForConnected(5000);
+    }
+
+    void send(const QByteArray &data)
+    {
+        socket.write(data);
+    }
+
+    void get(const QString &path, const QByteArray &headers = QByteArray())
+    {
+        send("GET " + path.toUtf8() + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n");
+    }
+
+    bool readResponse(HttpTestResponse *response, int timeout = 5000)
+    {
+        return QTest::qWaitFor([&]() {
+            received += socket.readAll();
+            return takeResponse(response);
+        }, timeout);
+    }
+
+    // Reads size bytes following the responses, e.g. data of the protocol a connection was upgraded to
+    bool readRaw(QByteArray *data, int size, int timeout = 5000)
+    {
+        if (!QTest::qWaitFor([&]() {
+                received += socket.readAll();
+                return received.size() >= size;
+            }, timeout))
+            return false;
+
+        *data = received.left(size);
+        received.remove(0, size);
+        return true;
+    }
+
+    bool waitForDisconnected(int timeout = 5000)
+    {
+        return QTest::qWaitFor([&]() {
+            received += socket.readAll();
+            return socket.state() == QAbstractSocket::UnconnectedState;
+        }, timeout);
+    }
+};
+
+// Parses requests sent over a local socket pair into HttpData, used to test routers & middleware without a server
+class HttpTestRequests
+{
+private:
+    QTcpServer listener;
+    QTcpSocket client;
+    QTcpSocket *peer = nullptr;
+
+public:
+    HttpServerConfig config;
+
+    bool open()
+    {
+        if (!listener.listen(QHostAddress::LocalHost))
+            return false;
+
+        client.connectToHost(QHostAddress::LocalHost, listener.serverPort());
+        if (!client.waitForConnected(5000) || !listener.waitForNewConnection(5000))
+            return false;
+
+        peer = listener.nextPendingConnection();
+        return peer != nullptr;
+    }
+
+    // Returns nullptr if the request was not received in time
+    HttpDataPtr create(const QByteArray &request)
+    {
+        HttpRequest *httpRequest = HttpRequest::create(&config);
+        HttpResponse *httpResponse = HttpResponse::create(&config);
+        HttpDataPtr data = std::make_shared<HttpData>(httpRequest, httpResponse);
+
+        client.write(request);
+        client.flush();
+        if (!QTest::qWaitFor([&]() { return httpRequest->parseRequest(peer, httpResponse); }, 5000))
+            return nullptr;
+
+        return data;
+    }
+
+    HttpDataPtr create(const QByteArray &method, const QString &path, const QByteArray &headers = QByteArray())
+    {
+        return create(method + " " + path.toUtf8() + " HTTP/1.1\r\nHost: localhost\r\n" + headers + "\r\n");
+    }
+};
+
+#endif // HTTP_SERVER_TEST_HTTP_TEST_CLIENT_H
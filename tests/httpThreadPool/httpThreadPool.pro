@@ -0,0 +1,6 @@
+TARGET = tst_httpThreadPool
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpThreadPool.cpp
@@ -0,0 +1,291 @@
+#include "httpServer/httpThreadPool.h"
+#include "httpTestClient.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <QThread>
+#include <QtTest>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+class TestHttpThreadPool : public QObject
+{
+    Q_OBJECT
+
+private:
+    HttpTestRequests requests;
+
+    // Starts a job on each thread of the pool that blocks until release is set
+    static void blockThreads(HttpThreadPool &pool, int threads, std::atomic<bool> &release);
+
+private slots:
+    void initTestCase();
+
+    void runsJobs();
+    void jobsAcrossPools();
+    void throwingJobs();
+    void cancelQueuedJobs();
+    void completionThread();
+    void completionOrder();
+    void runOnPool();
+    void runOnPoolError();
+    void runOnPoolCancelled();
+    void runOnPoolWithoutPool();
+};
+
+void TestHttpThreadPool::initTestCase()
+{
+    QVERIFY(requests.open());
+}
+
+void TestHttpThreadPool::blockThreads(HttpThreadPool &pool, int threads, std::atomic<bool> &release)
+{
+    std::atomic<int> started(0);
+    for (int i = 0; i < threads; ++i)
+    {
+        pool.start([&]() {
+            ++started;
+            while (!release)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+    }
+
+    QTRY_COMPARE(started.load(), threads);
+}
+
+void TestHttpThreadPool::runsJobs()
+{
+    HttpServerConfig config;
+    config.poolThreadCount = 4;
+    HttpThreadPool pool(&config);
+
+    std::atomic<int> count(0);
+    for (int i = 0; i < 1000; ++i)
+        pool.start([&]() { ++count; });
+
+    QTRY_COMPARE(count.load(), 1000);
+
+    const HttpThreadPoolStats stats = pool.stats();
+    QCOMPARE(stats.threads, 4);
+    QTRY_COMPARE(pool.stats().completed, 1000ll);
+    QCOMPARE(pool.stats().queued, 0);
+}
+
+void TestHttpThreadPool::jobsAcrossPools()
+{
+    HttpServerConfig config;
+    config.poolThreadCount = 4;
+    HttpServerConfig singleConfig;
+    singleConfig.poolThreadCount = 1;
+
+    HttpThreadPool single(&singleConfig);
+    HttpThreadPool pool(&config);
+
+    // Jobs submitted from a thread of another pool are not put on the queue with the same index
+    std::atomic<int> outer(0);
+    std::atomic<int> inner(0);
+    for (int i = 0; i < 100; ++i)
+    {
+        pool.start([&]() {
+            single.start([&]() { ++inner; });
+            pool.start([&]() { ++inner; });
+            ++outer;
+        });
+    }
+
+    QTRY_COMPARE(outer.load(), 100);
+    QTRY_COMPARE(inner.load(), 200);
+    QCOMPARE(single.stats().threads, 1);
+}
+
+void TestHttpThreadPool::throwingJobs()
+{
+    HttpServerConfig config;
+    config.poolThreadCount = 1;
+    HttpThreadPool pool(&config);
+
+    // Exceptions of any type are caught, the thread keeps running jobs
+    std::atomic<int> count(0);
+    pool.start([]() { throw std::runtime_error("error"); });
+    pool.start([]() { throw 42; });
+    pool.start([&]() { ++count; });
+
+    QTRY_COMPARE(count.load(), 1);
+    QTRY_COMPARE(pool.stats().completed, 3ll);
+}
+
+void TestHttpThreadPool::cancelQueuedJobs()
+{
+    HttpServerConfig config;
+    config.poolThreadCount = 2;
+
+    std::atomic<bool> release(false);
+    std::atomic<int> ran(0);
+    std::atomic<int> cancelled(0);
+    std::thread releaser;
+    {
+        HttpThreadPool pool(&config);
+        blockThreads(pool, 2, release);
+
+        for (int i = 0; i < 10; ++i)
+            pool.start([&]() { ++ran; }, [&]() { ++cancelled; });
+
+        // Destructor waits for the running jobs, let them finish shortly after it started
+        releaser = std::thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            release = true;
+        });
+    }
+    releaser.join();
+
+    QCOMPARE(ran.load(), 0);
+    QCOMPARE(cancelled.load(), 10);
+}
+
+void TestHttpThreadPool::completionThread()
+{
+    HttpServerConfig config;
+    HttpThreadPool pool(&config);
+    HttpCompletionQueue *queue = HttpCompletionQueue::current();
+    QCOMPARE(HttpCompletionQueue::current(), queue);
+
+    QThread *poolThread = nullptr;
+    QThread *completionThread = nullptr;
+    pool.start([&]() {
+        poolThread = QThread::currentThread();
+        queue->post([&]() { completionThread = QThread::currentThread(); });
+    });
+
+    QTRY_VERIFY(completionThread);
+    QCOMPARE(completionThread, QThread::currentThread());
+    QVERIFY(poolThread != QThread::currentThread());
+}
+
+void TestHttpThreadPool::completionOrder()
+{
+    HttpCompletionQueue *queue = HttpCompletionQueue::current();
+    const int producers = 4;
+    const int count = 5000;
+
+    // Callbacks of each producer run in the order they were posted, each exactly once
+    std::vector<int> next(producers, 0);
+    bool ordered = true;
+    int received = 0;
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < count; ++i)
+            {
+                queue->post([&, p, i]() {
+                    ordered = ordered && next[p] == i;
+                    next[p] = i + 1;
+                    ++received;
+                });
+            }
+        });
+    }
+
+    for (std::thread &thread : threads)
+        thread.join();
+
+    QTRY_COMPARE(received, producers * count);
+    QVERIFY(ordered);
+}
+
+void TestHttpThreadPool::runOnPool()
+{
+    HttpServerConfig config;
+    HttpThreadPool pool(&config);
+
+    HttpDataPtr data = requests.create("GET", "/");
+    QVERIFY(data);
+    data->pool = &pool;
+
+    std::atomic<int> value(0);
+    QThread *resolvedThread = nullptr;
+    data->runOnPool([&]() { value = 42; }).then([&](HttpDataPtr result) {
+        QCOMPARE(result, data);
+        resolvedThread = QThread::currentThread();
+    });
+
+    QTRY_VERIFY(resolvedThread);
+    QCOMPARE(resolvedThread, QThread::currentThread());
+    QCOMPARE(value.load(), 42);
+}
+
+void TestHttpThreadPool::runOnPoolError()
+{
+    HttpServerConfig config;
+    HttpThreadPool pool(&config);
+
+    HttpDataPtr data = requests.create("GET", "/");
+    QVERIFY(data);
+    data->pool = &pool;
+
+    HttpStatus status = HttpStatus::None;
+    data->runOnPool([]() { throw HttpException(HttpStatus::UnprocessableEntity); }).then([](HttpDataPtr) {
+        QFAIL("Promise resolved");
+    }).fail([&](const HttpException &error) {
+        status = error.status;
+    });
+
+    QTRY_COMPARE(status, HttpStatus::UnprocessableEntity);
+}
+
+void TestHttpThreadPool::runOnPoolCancelled()
+{
+    HttpServerConfig config;
+    config.poolThreadCount = 1;
+
+    HttpDataPtr data = requests.create("GET", "/");
+    QVERIFY(data);
+
+    std::atomic<bool> release(false);
+    std::atomic<bool> ran(false);
+    HttpStatus status = HttpStatus::None;
+    std::thread releaser;
+    {
+        HttpThreadPool pool(&config);
+        data->pool = &pool;
+        blockThreads(pool, 1, release);
+
+        data->runOnPool([&]() { ran = true; }).then([](HttpDataPtr) {
+            QFAIL("Promise resolved");
+        }).fail([&](const HttpException &error) {
+            status = error.status;
+        });
+
+        releaser = std::thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            release = true;
+        });
+    }
+    releaser.join();
+    data->pool = nullptr;
+
+    // Rejected through the completion queue, so not before the event loop runs
+    QCOMPARE(status, HttpStatus::None);
+    QTRY_COMPARE(status, HttpStatus::ServiceUnavailable);
+    QVERIFY(!ran);
+}
+
+void TestHttpThreadPool::runOnPoolWithoutPool()
+{
+    HttpDataPtr data = requests.create("GET", "/");
+    QVERIFY(data);
+    QVERIFY(!data->pool);
+
+    // Runs right away on the current thread
+    QThread *thread = nullptr;
+    auto promise = data->runOnPool([&]() { thread = QThread::currentThread(); });
+    QCOMPARE(thread, QThread::currentThread());
+    QVERIFY(promise.isFulfilled());
+}
+
+QTEST_GUILESS_MAIN(TestHttpThreadPool)
+#include "tst_httpThreadPool.moc"
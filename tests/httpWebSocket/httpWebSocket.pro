@@ -0,0 +1,6 @@
+TARGET = tst_httpWebSocket
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_httpWebSocket.cpp
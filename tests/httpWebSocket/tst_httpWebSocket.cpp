@@ -0,0 +1,436 @@
+#include "httpServer/httpWebSocket.h"
+
+#include <QPointer>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtTest>
+#include <zlib.h>
+
+
+class TestHttpWebSocket : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTcpServer server;
+    QTcpSocket *client = nullptr;
+    QPointer<HttpWebSocket> webSocket;
+    // Data received by the client that has not been parsed into frames yet
+    QByteArray received;
+
+    void open(int compressionBits = 0, int maxMessageSize = 1024);
+    bool waitForFrame(int *firstByte, QByteArray *payload);
+    bool waitForClose(quint16 *code);
+
+    static QByteArray clientFrame(int firstByte, const QByteArray &payload);
+    static QByteArray clientFrameHeader(int firstByte, quint64 length);
+    static QByteArray rawInflate(const QByteArray &data);
+
+private slots:
+    void cleanup();
+
+    void isValidUtf8_data();
+    void isValidUtf8();
+    void unmask();
+    void buildFrame_data();
+    void buildFrame();
+
+    void textMessage();
+    void fragmentedMessage();
+    void splitUtf8Character();
+    void invalidUtf8TextMessage();
+    void invalidUtf8CloseReason();
+    void messageTooLarge();
+    void continuationLengthOverflow();
+    void hugeContinuationLength();
+    void unmaskedFrame();
+    void oversizedControlFrame();
+    void compressedMessage();
+    void sendCompressedText();
+};
+
+void TestHttpWebSocket::open(int compressionBits, int maxMessageSize)
+{
+    if (!server.isListening())
+        QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    client = new QTcpSocket(this);
+    client->connectToHost(server.serverAddress(), server.serverPort());
+    QVERIFY(server.waitForNewConnection(5000));
+    QVERIFY(client->waitForConnected(5000));
+
+    QTcpSocket *serverSocket = server.nextPendingConnection();
+    QVERIFY(serverSocket);
+    webSocket = new HttpWebSocket(serverSocket, compressionBits, maxMessageSize);
+    received.clear();
+}
+
+void TestHttpWebSocket::cleanup()
+{
+    delete webSocket;
+    delete client;
+    client = nullptr;
+}
+
+bool TestHttpWebSocket::waitForFrame(int *firstByte, QByteArray *payload)
+{
+    // Server frames are never masked
+    qint64 headerSize = 0;
+    quint64 length = 0;
+    auto parseHeader = [&]() {
+        if (received.size() < 2)
+            return false;
+
+        length = quint8(received[1]) & 0x7F;
+        headerSize = 2;
+        if (length == 126)
+            headerSize = 4;
+        else if (length == 127)
+            headerSize = 10;
+
+        if (received.size() < headerSize)
+            return false;
+
+        if (headerSize > 2)
+        {
+            length = 0;
+            for (int i = 2; i < headerSize; ++i)
+                length = (length << 8) | quint8(received[i]);
+        }
+
+        return (quint64)received.size() >= headerSize + length;
+    };
+
+    const bool complete = QTest::qWaitFor([&]() {
+        received += client->readAll();
+        return parseHeader();
+    }, 5000);
+
+    if (!complete)
+        return false;
+
+    *firstByte = quint8(received[0]);
+    *payload = received.mid(headerSize, (int)length);
+    received.remove(0, int(headerSize + length));
+    return true;
+}
+
+bool TestHttpWebSocket::waitForClose(quint16 *code)
+{
+    int firstByte;
+    QByteArray payload;
+    while (waitForFrame(&firstByte, &payload))
+    {
+        if ((firstByte & 0x0F) != 0x8)
+            continue;
+
+        if (payload.size() < 2)
+            return false;
+
+        *code = quint16((quint8(payload[0]) << 8) | quint8(payload[1]));
+        return true;
+    }
+
+    return false;
+}
+
+QByteArray TestHttpWebSocket::clientFrameHeader(int firstByte, quint64 length)
+{
+    QByteArray header;
+    header += char(firstByte);
+    header += char(0x80 | 127);
+    for (int shift = 56; shift >= 0; shift -= 8)
+        header += char((length >> shift) & 0xFF);
+
+    header += QByteArray("\x12\x34\x56\x78", 4);
+    return header;
+}
+
+QByteArray TestHttpWebSocket::clientFrame(int firstByte, const QByteArray &payload)
+{
+    static const char mask[] = {'\x12', '\x34', '\x56', '\x78'};
+
+    QByteArray frame;
+    frame += char(firstByte);
+    if (payload.size() < 126)
+        frame += char(0x80 | payload.size());
+    else if (payload.size() <= 0xFFFF)
+    {
+        frame += char(0x80 | 126);
+        frame += char((payload.size() >> 8) & 0xFF);
+        frame += char(payload.size() & 0xFF);
+    }
+    else
+    {
+        frame += char(0x80 | 127);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            frame += char((quint64(payload.size()) >> shift) & 0xFF);
+    }
+
+    frame += QByteArray(mask, 4);
+    for (int i = 0; i < payload.size(); ++i)
+        frame += char(payload[i] ^ mask[i % 4]);
+
+    return frame;
+}
+
+QByteArray TestHttpWebSocket::rawInflate(const QByteArray &data)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, -15) != Z_OK)
+        return QByteArray();
+
+    QByteArray input = data + QByteArray("\x00\x00\xFF\xFF", 4);
+    QByteArray output(64 * 1024, '\0');
+    stream.next_in = (unsigned char *)input.data();
+    stream.avail_in = (unsigned int)input.size();
+    stream.next_out = (unsigned char *)output.data();
+    stream.avail_out = (unsigned int)output.size();
+    inflate(&stream, Z_SYNC_FLUSH);
+    output.resize(output.size() - (int)stream.avail_out);
+    inflateEnd(&stream);
+    return output;
+}
+
+void TestHttpWebSocket::isValidUtf8_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<bool>("valid");
+
+    QTest::newRow("empty") << QByteArray() << true;
+    QTest::newRow("ascii") << QByteArray("hello world, this is longer than eight bytes") << true;
+    QTest::newRow("two bytes") << QByteArray("caf\xC3\xA9") << true;
+    QTest::newRow("three bytes") << QByteArray("\xE2\x82\xAC 100") << true;
+    QTest::newRow("four bytes") << QByteArray("\xF0\x9F\x98\x80") << true;
+    QTest::newRow("max code point") << QByteArray("\xF4\x8F\xBF\xBF") << true;
+    QTest::newRow("after ascii run") << QByteArray("abcdefghijk\xC3\xA9") << true;
+    QTest::newRow("overlong two bytes") << QByteArray("\xC0\xAF") << false;
+    QTest::newRow("overlong three bytes") << QByteArray("\xE0\x80\xAF") << false;
+    QTest::newRow("overlong four bytes") << QByteArray("\xF0\x80\x80\xAF") << false;
+    QTest::newRow("surrogate") << QByteArray("\xED\xA0\x80") << false;
+    QTest::newRow("above max code point") << QByteArray("\xF4\x90\x80\x80") << false;
+    QTest::newRow("invalid lead byte") << QByteArray("\xF5\x80\x80\x80") << false;
+    QTest::newRow("stray continuation") << QByteArray("abc\x80") << false;
+    QTest::newRow("truncated") << QByteArray("\xF0\x9F\x98") << false;
+    QTest::newRow("bad continuation") << QByteArray("\xE2\x28\xA1") << false;
+    QTest::newRow("invalid after ascii run") << QByteArray("abcdefghijk\xFF") << false;
+}
+
+void TestHttpWebSocket::isValidUtf8()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(bool, valid);
+
+    QCOMPARE(HttpWebSocket::isValidUtf8(data.constData(), data.size()), valid);
+}
+
+void TestHttpWebSocket::unmask()
+{
+    const char mask[] = {'\xA1', '\x02', '\x7F', '\xF0'};
+
+    // Covers the SIMD, 8-byte & single byte paths
+    for (int size = 0; size < 70; ++size)
+    {
+        QByteArray data;
+        for (int i = 0; i < size; ++i)
+            data += char(i * 7);
+
+        QByteArray expected = data;
+        for (int i = 0; i < size; ++i)
+            expected[i] = char(expected[i] ^ mask[i % 4]);
+
+        HttpWebSocket::unmask(data.data(), data.size(), mask);
+        QCOMPARE(data, expected);
+    }
+}
+
+void TestHttpWebSocket::buildFrame_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<QByteArray>("header");
+
+    QTest::newRow("7-bit length") << 125 << QByteArray("\x82\x7D");
+    QTest::newRow("16-bit length") << 126 << QByteArray("\x82\x7E\x00\x7E", 4);
+    QTest::newRow("64-bit length") << 65536 << QByteArray("\x82\x7F\x00\x00\x00\x00\x00\x01\x00\x00", 10);
+}
+
+void TestHttpWebSocket::buildFrame()
+{
+    QFETCH(int, size);
+    QFETCH(QByteArray, header);
+
+    const QByteArray payload(size, 'x');
+    const QByteArray frame = HttpWebSocket::buildFrame(HttpWebSocket::Opcode::Binary, payload);
+    QCOMPARE(frame.left(header.size()), header);
+    QCOMPARE(frame.mid(header.size()), payload);
+}
+
+void TestHttpWebSocket::textMessage()
+{
+    open();
+    QSignalSpy spy(webSocket.data(), &HttpWebSocket::textMessageReceived);
+
+    client->write(clientFrame(0x81, "hello"));
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), QString("hello"));
+
+    // Server frames are sent unmasked in a single frame
+    webSocket->sendText("hi");
+    int firstByte;
+    QByteArray payload;
+    QVERIFY(waitForFrame(&firstByte, &payload));
+    QCOMPARE(firstByte, 0x81);
+    QCOMPARE(payload, QByteArray("hi"));
+}
+
+void TestHttpWebSocket::fragmentedMessage()
+{
+    open();
+    QSignalSpy spy(webSocket.data(), &HttpWebSocket::textMessageReceived);
+
+    // Control frames can be interleaved with the fragments of a message
+    client->write(clientFrame(0x01, "hel"));
+    client->write(clientFrame(0x89, "ping"));
+    client->write(clientFrame(0x80, "lo"));
+
+    int firstByte;
+    QByteArray payload;
+    QVERIFY(waitForFrame(&firstByte, &payload));
+    QCOMPARE(firstByte, 0x8A);
+    QCOMPARE(payload, QByteArray("ping"));
+
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), QString("hello"));
+}
+
+void TestHttpWebSocket::splitUtf8Character()
+{
+    open();
+    QSignalSpy spy(webSocket.data(), &HttpWebSocket::textMessageReceived);
+
+    // Only the whole message has to be valid UTF-8, a character can be split across frames
+    client->write(clientFrame(0x01, "\xE2\x82"));
+    client->write(clientFrame(0x80, "\xAC"));
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), QString::fromUtf8("\xE2\x82\xAC"));
+}
+
+void TestHttpWebSocket::invalidUtf8TextMessage()
+{
+    open();
+    QSignalSpy spy(webSocket.data(), &HttpWebSocket::textMessageReceived);
+
+    client->write(clientFrame(0x81, "\xC0\xAF"));
+
+    quint16 code;
+    QVERIFY(waitForClose(&code));
+    QCOMPARE(code, quint16(1007));
+    QCOMPARE(spy.count(), 0);
+}
+
+void TestHttpWebSocket::invalidUtf8CloseReason()
+{
+    open();
+
+    client->write(clientFrame(0x88, QByteArray("\x03\xE8\xED\xA0\x80", 5)));
+
+    quint16 code;
+    QVERIFY(waitForClose(&code));
+    QCOMPARE(code, quint16(1007));
+}
+
+void TestHttpWebSocket::messageTooLarge()
+{
+    open(0, 1024);
+    QSignalSpy spy(webSocket.data(), &HttpWebSocket::binaryMessageReceived);
+
+    // Each fragment fits, but the message as a whole does not
+    client->write(clientFrame(0x02, QByteArray(600, 'a')));
+    client->write(clientFrame(0x80, QByteArray(600, 'b')));
+
+    quint16 code;
+    QVERIFY(waitForClose(&code));
+    QCOMPARE(code, quint16(1009));
+    QCOMPARE(spy.count(), 0);
+}
+
+void TestHttpWebSocket::continuationLengthOverflow()
+{
+    open();
+    QSignalSpy spy(webSocket.data(), &HttpWebSocket::textMessageReceived);
+
+    // Length with the most significant bit set would wrap around when added to the size of the message so far
+    client->write(clientFrame(0x01, "ab"));
+    client->write(clientFrameHeader(0x80, 0xFFFFFFFFFFFFFFFFull) + "cd");
+
+    quint16 code;
+    QVERIFY(waitForClose(&code));
+    QCOMPARE(code, quint16(1002));
+    QCOMPARE(spy.count(), 0);
+}
+
+void TestHttpWebSocket::hugeContinuationLength()
+{
+    open();
+
+    client->write(clientFrame(0x01, "ab"));
+    client->write(clientFrameHeader(0x80, 0x7FFFFFFFFFFFFFFFull) + "cd");
+
+    quint16 code;
+    QVERIFY(waitForClose(&code));
+    QCOMPARE(code, quint16(1009));
+}
+
+void TestHttpWebSocket::unmaskedFrame()
+{
+    open();
+
+    client->write(QByteArray("\x81\x02hi", 4));
+
+    quint16 code;
+    QVERIFY(waitForClose(&code));
+    QCOMPARE(code, quint16(1002));
+}
+
+void TestHttpWebSocket::oversizedControlFrame()
+{
+    open();
+
+    // Rejected from the header alone, the payload is never sent
+    client->write(clientFrameHeader(0x89, 126));
+
+    quint16 code;
+    QVERIFY(waitForClose(&code));
+    QCOMPARE(code, quint16(1002));
+}
+
+void TestHttpWebSocket::compressedMessage()
+{
+    open(15);
+    QSignalSpy spy(webSocket.data(), &HttpWebSocket::textMessageReceived);
+
+    const QByteArray text = QByteArray("compressed message ").repeated(20);
+    client->write(clientFrame(0xC1, HttpWebSocket::deflateMessage(text)));
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), QString::fromUtf8(text));
+}
+
+void TestHttpWebSocket::sendCompressedText()
+{
+    open(15);
+
+    const QString text = QString("compressed message ").repeated(20);
+    webSocket->sendText(text);
+
+    // RSV1 marks the message as compressed
+    int firstByte;
+    QByteArray payload;
+    QVERIFY(waitForFrame(&firstByte, &payload));
+    QCOMPARE(firstByte, 0xC1);
+    QVERIFY(payload.size() < text.size());
+    QCOMPARE(rawInflate(payload), text.toUtf8());
+}
+
+QTEST_GUILESS_MAIN(TestHttpWebSocket)
+#include "tst_httpWebSocket.moc"
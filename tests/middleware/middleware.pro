@@ -0,0 +1,6 @@
+TARGET = tst_middleware
+
+include(../tests.pri)
+
+SOURCES += \
+        tst_middleware.cpp
@@ -0,0 +1,188 @@
+#include "httpServer/middleware.h"
+#include "httpTestClient.h"
+
+#include <memory>
+#include <QtTest>
+
+
+class TestMiddleware : public QObject
+{
+    Q_OBJECT
+
+private:
+    HttpTestRequests requests;
+
+    HttpDataPtr post(const QByteArray &body, const QByteArray &headers = QByteArray());
+
+private slots:
+    void initTestCase();
+
+    void getObject();
+    void getArray();
+    void invalidJson();
+    void checkAuthBasic();
+    void checkAuthBasicDenied_data();
+    void checkAuthBasicDenied();
+    void storeInState();
+    void contextSlots();
+    void contextValuesReleased();
+};
+
+void TestMiddleware::initTestCase()
+{
+    QVERIFY(requests.open());
+}
+
+HttpDataPtr TestMiddleware::post(const QByteArray &body, const QByteArray &headers)
+{
+    return requests.create("POST /data HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\n"
+        "Content-Length: " + QByteArray::number(body.size()) + "\r\n" + headers + "\r\n" + body);
+}
+
+void TestMiddleware::getObject()
+{
+    HttpDataPtr data = post("{\"name\": \"value\"}");
+    QVERIFY(data);
+    middleware::getObject(data);
+
+    const QJsonObject expected{{"name", "value"}};
+    QVERIFY(data->get(middleware::requestObject));
+    QCOMPARE(*data->get(middleware::requestObject), expected);
+    QVERIFY(data->state.empty());
+}
+
+void TestMiddleware::getArray()
+{
+    HttpDataPtr data = post("[1, 2, 3]");
+    QVERIFY(data);
+    middleware::getArray(data);
+
+    const QJsonArray expected{1, 2, 3};
+    QVERIFY(data->get(middleware::requestArray));
+    QCOMPARE(*data->get(middleware::requestArray), expected);
+    QVERIFY(data->state.empty());
+}
+
+void TestMiddleware::invalidJson()
+{
+    HttpDataPtr data = post("{\"name\": ");
+    QVERIFY(data);
+    QVERIFY_EXCEPTION_THROWN(middleware::getObject(data), HttpException);
+    QVERIFY_EXCEPTION_THROWN(middleware::getArray(data), HttpException);
+    QVERIFY(!data->get(middleware::requestObject));
+    QVERIFY(data->state.find("requestObject") == data->state.end());
+}
+
+void TestMiddleware::checkAuthBasic()
+{
+    HttpDataPtr data = requests.create("GET", "/", "Authorization: Basic " + QByteArray("admin:p:ss").toBase64() +
+        "\r\n");
+    QVERIFY(data);
+    middleware::checkAuthBasic(data, "admin", "p:ss");
+
+    QCOMPARE(data->context.value(middleware::authUsername), QString("admin"));
+    QCOMPARE(data->context.value(middleware::authPassword), QString("p:ss"));
+    QVERIFY(data->state.empty());
+}
+
+void TestMiddleware::checkAuthBasicDenied_data()
+{
+    QTest::addColumn<QByteArray>("headers");
+
+    QTest::newRow("no header") << QByteArray();
+    QTest::newRow("wrong password") << "Authorization: Basic " + QByteArray("admin:wrong").toBase64() + "\r\n";
+    QTest::newRow("no colon") << "Authorization: Basic " + QByteArray("admin").toBase64() + "\r\n";
+    QTest::newRow("other scheme") << QByteArray("Authorization: Bearer token\r\n");
+}
+
+void TestMiddleware::checkAuthBasicDenied()
+{
+    QFETCH(QByteArray, headers);
+
+    HttpDataPtr data = requests.create("GET", "/", headers);
+    QVERIFY(data);
+    QVERIFY_EXCEPTION_THROWN(middleware::checkAuthBasic(data, "admin", "secret"), HttpException);
+    QVERIFY(!data->get(middleware::authUsername));
+    QVERIFY(data->state.find("authUsername") == data->state.end());
+}
+
+void TestMiddleware::storeInState()
+{
+    // Older handlers read the values from the state map
+    QVERIFY(!middleware::isStoringInState());
+    middleware::setStoreInState(true);
+
+    HttpDataPtr object = post("{\"name\": \"value\"}");
+    HttpDataPtr array = post("[1, 2, 3]");
+    HttpDataPtr auth = requests.create("GET", "/", "Authorization: Basic " + QByteArray("admin:secret").toBase64() +
+        "\r\n");
+    QVERIFY(object && array && auth);
+
+    middleware::getObject(object);
+    middleware::getArray(array);
+    middleware::checkAuthBasic(auth, "admin", "secret");
+    middleware::setStoreInState(false);
+
+    const QJsonObject expectedObject{{"name", "value"}};
+    const QJsonArray expectedArray{1, 2, 3};
+    QCOMPARE(object->state["requestObject"].toJsonObject(), expectedObject);
+    QCOMPARE(array->state["requestArray"].toJsonArray(), expectedArray);
+    QCOMPARE(auth->state["authUsername"].toString(), QString("admin"));
+    QCOMPARE(auth->state["authPassword"].toString(), QString("secret"));
+
+    // Typed slots are set either way
+    QVERIFY(object->get(middleware::requestObject));
+    QCOMPARE(auth->context.value(middleware::authUsername), QString("admin"));
+}
+
+void TestMiddleware::contextSlots()
+{
+    // More keys than there are inline slots so some values are stored in the overflow slots
+    static const HttpContextKey<int> keys[20];
+
+    HttpContext context;
+    QVERIFY(!context.get(keys[0]));
+    QVERIFY(!context.get(keys[19]));
+
+    for (int i = 0; i < 20; ++i)
+        context.set(keys[i], i * 10);
+
+    for (int i = 0; i < 20; ++i)
+    {
+        QVERIFY(context.contains(keys[i]));
+        QCOMPARE(*context.get(keys[i]), i * 10);
+    }
+
+    context.remove(keys[3]);
+    context.remove(keys[15]);
+    QVERIFY(!context.contains(keys[3]));
+    QVERIFY(!context.contains(keys[15]));
+    QCOMPARE(context.value(keys[15], -1), -1);
+    QCOMPARE(context.value(keys[16], -1), 160);
+}
+
+void TestMiddleware::contextValuesReleased()
+{
+    static const HttpContextKey<std::shared_ptr<int>> firstKey;
+    static const HttpContextKey<std::shared_ptr<int>> lastKey;
+    static const HttpContextKey<int> padding[10];
+    Q_UNUSED(padding);
+
+    std::shared_ptr<int> value = std::make_shared<int>(1);
+    {
+        HttpContext context;
+        context.set(firstKey, value);
+        context.set(lastKey, value);
+        QCOMPARE(value.use_count(), 3L);
+
+        // Replacing a value destroys the old one
+        context.set(firstKey, std::make_shared<int>(2));
+        QCOMPARE(value.use_count(), 2L);
+        QCOMPARE(**context.get(firstKey), 2);
+    }
+
+    QCOMPARE(value.use_count(), 1L);
+}
+
+QTEST_GUILESS_MAIN(TestMiddleware)
+#include "tst_middleware.moc"
@@ -0,0 +1,32 @@
+# Common settings for the unit tests, each test is a separate QtTest executable. Run them with `make check`
+
+QT += network testlib
+QT -= gui
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# Shared test helpers
+INCLUDEPATH += $$PWD
+HEADERS += $$PWD/httpTestClient.h
+
+# Link to httpServer library
+INCLUDEPATH += $$PWD/../src
+DEPENDPATH += $$PWD/../src
+
+win32 {
+    CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../../src/release/ -lhttpServer
+    CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../../src/debug/ -lhttpServer
+}
+
+unix {
+    CONFIG(release, debug|release): HTTP_SERVER_LIB_DIR = $$PWD/../src/build/release
+    CONFIG(debug, debug|release): HTTP_SERVER_LIB_DIR = $$PWD/../src/build/debug
+
+    LIBS += -L$$HTTP_SERVER_LIB_DIR -lhttpServer
+    QMAKE_RPATHDIR += $$HTTP_SERVER_LIB_DIR
+}
+
+include($$PWD/../common.pri)
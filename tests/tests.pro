@@ -0,0 +1,15 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    httpArena \
+    httpConnection \
+    httpDataRate \
+    httpJsonWriter \
+    httpObjectPool \
+    httpRequestRouter \
+    httpResponse \
+    httpResponseCache \
+    httpTask \
+    httpThreadPool \
+    httpWebSocket \
+    middleware